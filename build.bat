@@ -7,7 +7,7 @@ call "C:\Program Files (x86)\Microsoft Visual Studio\2019\Community\VC\Auxiliary
 
 set include_flags=-I..\include\
 
-set compiler_flags= /MDd /Od /W4 /WX /permissive- /std:c++17 /ZI /sdl /Zc:inline /Fe"procAnim.exe" /nologo /EHsc /diagnostics:column %include_flags%
+set compiler_flags= /MDd /Od /W4 /WX /permissive- /std:c++17 /ZI /sdl /Zc:inline /Fe"procAnim.exe" /nologo /EHsc /diagnostics:column /DCOUNT_HEAP_ALLOCATIONS %include_flags%
 
 set linker_flags=/OUT:"procAnim.exe" /PDB:"procAnim.pdb" /DEBUG:FULL /MACHINE:X64 /SUBSYSTEM:CONSOLE /NOLOGO /LIBPATH:"..\lib" "OpenGL32.lib" "glew32.lib" "SDL2.lib" "SDL2main.lib" "SDL2_image.lib" "SDL2_ttf.lib" "SDL2_mixer.lib" "assimp-vc142-mt.lib" "kernel32.lib" "user32.lib" "gdi32.lib" "winspool.lib" "comdlg32.lib" "advapi32.lib" "shell32.lib" "ole32.lib" "oleaut32.lib" "uuid.lib" "odbc32.lib" "odbccp32.lib"
 
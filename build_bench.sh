@@ -0,0 +1,15 @@
+#!/bin/sh
+# Builds the microbenchmarks (see src/BenchMain.cpp) without window, GL context
+# or audio, like build_headless.sh. Run bin/procAnimBench from inside bin, the
+# player model is loaded relative to it.
+
+cd "$(dirname "$0")"
+mkdir -p bin
+cd bin
+
+compiler_flags="-std=c++17 -O2 -DHEADLESS -DDISABLE_COUNTERS -DGLEW_NO_GLU -I../include"
+linker_flags="-lSDL2 -lassimp -lpthread"
+
+g++ $compiler_flags ../src/BenchUnity.cpp $linker_flags -o procAnimBench
+g++ $compiler_flags -DCOLLISION_FORCE_SCALAR ../src/BenchUnity.cpp \
+    $linker_flags -o procAnimBenchScalar
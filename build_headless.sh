@@ -0,0 +1,14 @@
+#!/bin/sh
+# Builds the simulation without window, GL context or audio device (see
+# src/HeadlessUnity.cpp). Only needs the SDL2 and assimp libraries, so it works
+# on a plain Linux box. Run bin/procAnimHeadless from inside bin, the assets
+# are loaded relative to it.
+
+cd "$(dirname "$0")"
+mkdir -p bin
+cd bin
+
+compiler_flags="-std=c++17 -O2 -DHEADLESS -DGLEW_NO_GLU -I../include"
+linker_flags="-lSDL2 -lassimp -lpthread"
+
+g++ $compiler_flags ../src/HeadlessUnity.cpp $linker_flags -o procAnimHeadless
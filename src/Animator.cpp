@@ -4,6 +4,11 @@
 #include "rendering/Mesh.h"
 #include "rendering/Renderer.h"
 #include "Player.h"
+#include "Level.h"
+#include "Snapshot.h"
+#include "TaskGraph.h"
+#include "Profiler.h"
+#include "Counters.h"
 
 // Moves all points in src by move and write them to dst. src and dst can point
 // to the same array.
@@ -20,6 +25,7 @@ static void move_spline_points(glm::vec2* dst,
 // bone[1] is at (or at the closest possible point to) target_pos_model_space.
 static void solve_ik(Bone* const bones[2], glm::vec2 target_pos_model_space) {
     SDL_assert(bones != nullptr);
+    Counters::add(Counter::IK_SOLVES);
 
     // This algorithm assumes that the angle between the bones in bind pose is
     // zero. Check this assumption here, just to be sure.
@@ -96,9 +102,9 @@ float Limb::length() const {
 
 void Animator::init(const Player* parent_,
                     RiggedMesh& mesh,
-                    const std::list<AABB>& colliders) {
+                    const Level& level) {
     parent        = parent_;
-    spline_editor = new SplineEditor();
+    spline_editor = std::make_unique<SplineEditor>();
     spline_editor->init(
       parent, &spline_prototypes, limbs, "../assets/player_splines.spl");
 
@@ -118,7 +124,7 @@ void Animator::init(const Player* parent_,
 
     weapon_ = mesh.find_bone("Weapon");
 
-    set_new_splines(0.0f, colliders);
+    set_new_splines(0.0f, level);
     interpolation_factor_on_spline =
       1.0f;  // Make the palyer move to the final position of the initial
              // spline instantly
@@ -127,7 +133,9 @@ void Animator::init(const Player* parent_,
 void Animator::update(float delta_time,
                       float walking_speed,
                       glm::vec2 right_stick_input,
-                      const std::list<AABB>& colliders) {
+                      const Level& level,
+                      ThreadPool* jobs) {
+    PROFILE_SCOPE("Animator::update");
     // Weapon animation
     float weapon_rotation =
       atan2f(right_stick_input.y, right_stick_input.x) - PI * 0.5f;
@@ -148,7 +156,7 @@ void Animator::update(float delta_time,
     //         last_leg_state = leg_state;
     //         leg_state = RIGHT_LEG_UP;
     //         interpolation_factor_between_splines = walking_speed;
-    //         set_new_splines(walking_speed, colliders);
+    //         set_new_splines(walking_speed, level);
 
     //     } else if (interpolation_factor_on_spline == 1.0f) {
     //         // Is walking and has reached the end of the current spline
@@ -156,12 +164,12 @@ void Animator::update(float delta_time,
     //         if (leg_state == LEFT_LEG_UP) {
     //             last_leg_state = leg_state;
     //             leg_state = RIGHT_LEG_UP;
-    //             set_new_splines(walking_speed, colliders);
+    //             set_new_splines(walking_speed, level);
 
     //         } else {
     //             last_leg_state = leg_state;
     //             leg_state = LEFT_LEG_UP;
-    //             set_new_splines(walking_speed, colliders);
+    //             set_new_splines(walking_speed, level);
     //         }
     //     }
     // } else {
@@ -170,11 +178,11 @@ void Animator::update(float delta_time,
         last_leg_state = leg_state;
         leg_state      = NEUTRAL;
 
-        set_new_splines(walking_speed, colliders);
+        set_new_splines(walking_speed, level);
 
     } else if (interpolation_factor_on_spline == 1.0f) {
         last_leg_state = NEUTRAL;
-        set_new_splines(walking_speed, colliders);
+        set_new_splines(walking_speed, level);
     }
     // }
 
@@ -192,14 +200,15 @@ void Animator::update(float delta_time,
     interpolation_factor_on_spline = std::min(
       interpolation_factor_on_spline + delta_time * interpolation_speed, 1.0f);
 
-    for (size_t n_limb = 0; n_limb < 2; ++n_limb) {
+    // Each limb only changes its own bones
+    parallel_for(jobs, 2, 1, [this](size_t n_limb) {
         auto& limb = limbs[n_limb];
 
         glm::vec2 target_pos = parent->world_to_local_space(
           limb.spline.get_point_on_spline(interpolation_factor_on_spline));
 
         solve_ik(limb.bones, target_pos);
-    }
+    });
 }
 
 glm::vec2 Animator::tip_pos(LegIndex limb_index) const {
@@ -211,22 +220,40 @@ const Bone* Animator::weapon() const noexcept {
     return weapon_;
 }
 
-void Animator::set_new_splines(float walking_speed,
-                               const std::list<AABB>& colliders) {
-
-    auto find_highest_ground_at =
-      [&colliders](glm::vec2 world_pos) -> glm::vec2 {
-        glm::vec2 result = glm::vec2(world_pos.x, 0.0f);
-        for (auto& coll : colliders) {
-            if (coll.min(0) <= world_pos.x && coll.max(0) >= world_pos.x) {
-                if (result.y == 0.0f || coll.max(1) > result.y) {
-                    result.y = coll.max(1);
-                }
-            }
+void Animator::save(AnimatorSnapshot& snapshot) const {
+    for (size_t i = 0; i < 2; ++i) {
+        const vec2* points = limbs[i].spline.points();
+        for (size_t p = 0; p < Spline::NUM_POINTS; ++p) {
+            snapshot.limb_spline_points[i][p] = points[p];
         }
-        return result;
-    };
+    }
+    snapshot.right_arm_target_position = right_arm_target_position;
+    snapshot.step_distance_world       = step_distance_world;
+    snapshot.spine_rotation_target     = spine_rotation_target;
+    snapshot.interpolation_factor_between_splines =
+      interpolation_factor_between_splines;
+    snapshot.interpolation_factor_on_spline = interpolation_factor_on_spline;
+    snapshot.leg_state                      = leg_state;
+    snapshot.last_leg_state                 = last_leg_state;
+    snapshot.idle_moving_forward            = idle_moving_forward;
+}
 
+void Animator::restore(const AnimatorSnapshot& snapshot) {
+    for (size_t i = 0; i < 2; ++i) {
+        limbs[i].spline.set_points(snapshot.limb_spline_points[i]);
+    }
+    right_arm_target_position = snapshot.right_arm_target_position;
+    step_distance_world       = snapshot.step_distance_world;
+    spine_rotation_target     = snapshot.spine_rotation_target;
+    interpolation_factor_between_splines =
+      snapshot.interpolation_factor_between_splines;
+    interpolation_factor_on_spline = snapshot.interpolation_factor_on_spline;
+    leg_state           = static_cast<LegState>(snapshot.leg_state);
+    last_leg_state      = static_cast<LegState>(snapshot.last_leg_state);
+    idle_moving_forward = snapshot.idle_moving_forward != 0;
+}
+
+void Animator::set_new_splines(float walking_speed, const Level& level) {
     auto spline_to_world_space = [this](glm::vec2 spline[Spline::NUM_POINTS]) {
         spline[P1] = parent->local_to_world_space(spline[P1]);
         spline[P2] = parent->local_to_world_space(spline[P2]);
@@ -247,24 +274,20 @@ void Animator::set_new_splines(float walking_speed,
     };
 
     if (leg_state == NEUTRAL) {
-        static bool moving_forward =
-          true;  // Indicates whether the idle spline should be traversed
-                 // forwards or backwards
-
         if (interpolation_factor_on_spline == 1.0f) {
-            moving_forward = !moving_forward;
+            idle_moving_forward = !idle_moving_forward;
         }
 
         if (last_leg_state != NEUTRAL) {
             // Character just stopped walking
-            moving_forward = false;
+            idle_moving_forward = false;
         }
 
         // Legs
-        glm::vec2 ground_left = find_highest_ground_at(
-          parent->local_to_world_space(limbs[LEFT_LEG].origin()));
-        glm::vec2 ground_right = find_highest_ground_at(
-          parent->local_to_world_space(limbs[RIGHT_LEG].origin()));
+        glm::vec2 ground_left = level.find_highest_ground_at(
+          parent->local_to_world_space(limbs[LEFT_LEG].origin()).x);
+        glm::vec2 ground_right = level.find_highest_ground_at(
+          parent->local_to_world_space(limbs[RIGHT_LEG].origin()).x);
 
         set_spline_points(limbs[LEFT_LEG].spline.get_point_on_spline(
                             interpolation_factor_on_spline),
@@ -305,7 +328,7 @@ void Animator::set_new_splines(float walking_speed,
 
         spline_points[P1] = limbs[forward_leg].spline.get_point_on_spline(
           interpolation_factor_on_spline);
-        spline_points[P1] = find_highest_ground_at(spline_points[P1]);
+        spline_points[P1] = level.find_highest_ground_at(spline_points[P1].x);
 
         spline_points[P2].x =
           parent->local_to_world_space(limbs[forward_leg].origin()).x
@@ -313,7 +336,7 @@ void Animator::set_new_splines(float walking_speed,
               * 1.5f;  // Moved by 1.5 times the step distance so the target
                        // position is half a step in front of the body _after_
                        // the body has moved one step distance
-        glm::vec2 ground    = find_highest_ground_at(spline_points[P2]);
+        glm::vec2 ground = level.find_highest_ground_at(spline_points[P2].x);
         spline_points[P2].y = ground.y;
 
         limbs[forward_leg].spline.set_points(spline_points);
@@ -1,13 +1,17 @@
 #pragma once
 #include <list>
+#include <memory>
 #include "rendering/VertexArray.h"
 #include "Spline.h"
 #include "Collider.h"
 
 class Bone;
+class ThreadPool;
 struct RiggedMesh;
 class Game;
 class Player;
+class Level;
+struct AnimatorSnapshot;
 
 // NOTE: Not all of these splines are actually relevant for the players
 // animations. For example, the legs just stick to one point on the ground in
@@ -37,20 +41,23 @@ class Animator {
     // Indices of the limbs for the limbs member variable.
     enum LegIndex { LEFT_LEG = 0, RIGHT_LEG = 1 };
 
-    void init(const Player* parent_,
-              RiggedMesh& mesh,
-              const std::list<AABB>& colliders);
+    void init(const Player* parent_, RiggedMesh& mesh, const Level& level);
+    // The limbs are solved in parallel on jobs, if there is one
     void update(float delta_time,
                 float walking_speed,
                 glm::vec2 right_stick_input,
-                const std::list<AABB>& colliders);
+                const Level& level,
+                ThreadPool* jobs = nullptr);
 
     glm::vec2 tip_pos(LegIndex limb_index) const;
     const Bone* weapon() const noexcept;
 
+    void save(AnimatorSnapshot& snapshot) const;
+    void restore(const AnimatorSnapshot& snapshot);
+
   private:
     const Player* parent;
-    SplineEditor* spline_editor;
+    std::unique_ptr<SplineEditor> spline_editor;
     Bone* weapon_;
     float max_weapon_length = 3.0f;
 
@@ -75,13 +82,16 @@ class Animator {
     } leg_state,
       last_leg_state;
 
+    // Whether the idle spline is traversed forwards or backwards
+    bool idle_moving_forward = true;
+
     float step_distance_multiplier = 100.0f;
 
     struct InterpolationSpeedMultiplier {
         float min = 0.02f, max = 0.08f;
     } interpolation_speed_multiplier;
 
-    void set_new_splines(float walking_speed, const std::list<AABB>& colliders);
+    void set_new_splines(float walking_speed, const Level& level);
 
     void interpolate_splines(glm::vec2 dst[Spline::NUM_POINTS],
                              SplineIndex spline_index) const;
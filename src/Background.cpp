@@ -2,6 +2,7 @@
 #include <glm/gtx/matrix_transform_2d.hpp>
 #include "Background.h"
 #include "rendering/Renderer.h"
+#include "Profiler.h"
 
 void Background::init(const char* texture_path) {
     Entity::init();
@@ -20,6 +21,7 @@ void Background::init(const char* texture_path) {
 }
 
 void Background::render(const Renderer& renderer, glm::vec2 camera_position) {
+    PROFILE_SCOPE("Background::render");
     renderer.textured_shader.use();
     renderer.textured_shader.set_texture(texture);
 
@@ -3,92 +3,102 @@
 #include "rendering/Renderer.h"
 #include "Util.h"
 #include "CollisionDetection.h"
+#include "CollisionVerifier.h"
+#include "World.h"
+#include "Snapshot.h"
+#include "RenderState.h"
 #include <glm/gtx/matrix_transform_2d.hpp>
 #include <imgui/imgui.h>
 #include <glm/gtc/type_ptr.hpp>
 
 const Color Ball::Trajectory::COLOR = Color::BLUE;
 
-float Ball::REBOUND                = 1.0f;
-float Ball::RADIUS                 = 50.0f;
-float Ball::ROLLING_FRICTION       = 1.5f;
-float Ball::ROLLING_ROTATION_SPEED = 1.0f;
-float Ball::GRAVITY                = 1.0f;
-
-void Ball::init(glm::vec2 position, const char* texture_path) {
+void Ball::init(glm::vec2 position,
+                const char* texture_path,
+                const BallConfig* ball_config) {
+    SDL_assert(ball_config);
+    config            = ball_config;
     starting_position = position;
 
-    Entity::init(position, glm::vec2(RADIUS));
+    Entity::init(position, glm::vec2(config->radius));
     collider_ = { glm::vec2(0.0f), 1.0f };
     texture.load_from_file(texture_path);
 
-    for (auto& vert : trajectory.vertices) {
-        vert = vec2(0.0f);
-    }
-    trajectory.vao.init(
-      trajectory.vertices.data(), trajectory.NUM_VERTICES, GL_DYNAMIC_DRAW);
+    trajectory.vao.init(nullptr, TRAJECTORY_VERTICES, GL_DYNAMIC_DRAW);
 }
 
 void Ball::update(const float delta_time,
-                  const std::list<AABB>& level,
-                  AudioManager& audio_manager,
-                  bool draw_trajectory) {
+                  const ColliderTree& level,
+                  WorldEvents& events) {
     if (freeze_duration > 0.0f) {
         freeze_duration -= delta_time;
         return;
     }
 
-    if (RADIUS != scale.x) {
+    if (config->radius != scale.x) {
         SDL_assert(scale.x == scale.y);
-        scale = glm::vec2(RADIUS);
+        scale = glm::vec2(config->radius);
     }
 
-    BallisticMoveResult move_result =
-      get_ballistic_move_result(collider_.local_to_world_space(*this),
-                                velocity,
-                                delta_time,
-                                level,
-                                REBOUND);
+    BallisticMoveResult move_result = get_ballistic_move_result(
+      collider_.local_to_world_space(*this),
+      velocity,
+      delta_time + carried_time,
+      level,
+      config->rebound,
+      static_cast<size_t>(glm::max(config->max_bounces_per_tick, 1)));
 
     position_ = move_result.new_position;
     velocity  = move_result.new_velocity;
 
+    // Catch up over the next tick. Never more than a tick though, a ball that
+    // is stuck bouncing in a corner would just get further behind.
+    carried_time = glm::min(move_result.remaining_time, delta_time);
+
     if (move_result.last_hit_diretcion != Direction::NONE
         && move_result.last_hit_diretcion != Direction::DOWN) {
-        audio_manager.play(Sound::WALL_BOUNCE);
+        events.sounds.push_back(Sound::WALL_BOUNCE);
     }
 
     if (grounded) {
-        velocity.x *= 1.0f / ROLLING_FRICTION;
+        velocity.x *= 1.0f / config->rolling_friction;
         velocity.y = 0.0f;
 
-        rotation_speed = -ROLLING_ROTATION_SPEED * velocity.x;
+        rotation_speed = -config->rolling_rotation_speed * velocity.x;
     } else {
         if (move_result.last_hit_diretcion == Direction::DOWN
-            && move_result.new_velocity.y <= GRAVITY * delta_time * 2.0f) {
+            && move_result.new_velocity.y
+                 <= config->gravity * delta_time * 2.0f) {
 
             velocity.y = 0.0f;
             grounded   = true;
 
-#if _DEBUG
+#ifdef VERIFY_COLLISION_OUTCOMES
             update_model_matrix();
             {
                 Circle global_circle = collider_.local_to_world_space(*this);
-                for (const auto& box : level) {
-                    SDL_assert(!test_circle_AABB(global_circle, box));
-                }
+                CollisionVerifier::submit(
+                  { CollisionVerifier::QueryType::RESTING,
+                    global_circle,
+                    Vector(0.0f),
+                    0.0f,
+                    0.0f,
+                    global_circle.center,
+                    0.0f,
+                    Direction::NONE },
+                  level);
             }
 #endif
         } else {
-            velocity.y -= GRAVITY;
+            velocity.y -= config->gravity;
         }
 
         if (move_result.last_hit_diretcion == Direction::UP
             || move_result.last_hit_diretcion == Direction::DOWN) {
-            rotation_speed = -ROLLING_ROTATION_SPEED * velocity.x;
+            rotation_speed = -config->rolling_rotation_speed * velocity.x;
         } else if (move_result.last_hit_diretcion == Direction::LEFT
                    || move_result.last_hit_diretcion == Direction::RIGHT) {
-            rotation_speed = -ROLLING_ROTATION_SPEED * velocity.y;
+            rotation_speed = -config->rolling_rotation_speed * velocity.y;
         }
     }
     update_model_matrix();
@@ -99,34 +109,84 @@ void Ball::update(const float delta_time,
     } else if (rotation < -2.0f * PI) {
         rotation += 2.0f * PI;
     }
+}
 
-    if (draw_trajectory && !grounded) {
-        trajectory.vertices[0] = position_;
-        vec2 new_velocity      = velocity;
-        for (size_t i = 1; i < Trajectory::NUM_VERTICES; ++i) {
-            new_velocity.y -= GRAVITY;
-            trajectory.vertices[i] = trajectory.vertices[i - 1] + new_velocity;
+void Ball::begin_tick() {
+    Entity::begin_tick();
+    last_tick_rotation = rotation;
+}
+
+void Ball::save(BallSnapshot& snapshot) const {
+    snapshot.starting_position  = starting_position;
+    snapshot.position           = position_;
+    snapshot.last_tick_position = last_tick_position_;
+    snapshot.scale              = scale;
+    snapshot.velocity           = velocity;
+    snapshot.rotation           = rotation;
+    snapshot.rotation_speed     = rotation_speed;
+    snapshot.last_tick_rotation = last_tick_rotation;
+    snapshot.grounded           = grounded;
+    snapshot.carried_time       = carried_time;
+    snapshot.freeze_duration    = freeze_duration;
+}
+
+void Ball::restore(const BallSnapshot& snapshot) {
+    starting_position   = snapshot.starting_position;
+    position_           = snapshot.position;
+    last_tick_position_ = snapshot.last_tick_position;
+    scale               = snapshot.scale;
+    velocity            = snapshot.velocity;
+    rotation            = snapshot.rotation;
+    rotation_speed      = snapshot.rotation_speed;
+    last_tick_rotation  = snapshot.last_tick_rotation;
+    grounded            = snapshot.grounded != 0;
+    carried_time        = snapshot.carried_time;
+    freeze_duration     = snapshot.freeze_duration;
+    update_model_matrix();
+}
+
+void Ball::write_render_state(BallRenderState& state, float alpha) const {
+    // Rotation wraps around at 2 PI, take the short way
+    float rotation_change = rotation - last_tick_rotation;
+    if (rotation_change > PI) {
+        rotation_change -= 2.0f * PI;
+    } else if (rotation_change < -PI) {
+        rotation_change += 2.0f * PI;
+    }
+
+    float interpolated_rotation = last_tick_rotation + rotation_change * alpha;
+    state.model =
+      glm::rotate(interpolated_model_matrix(alpha), interpolated_rotation);
+    state.grounded = grounded;
+
+    if (!grounded) {
+        state.trajectory[0] = position_;
+        vec2 new_velocity   = velocity;
+        for (size_t i = 1; i < TRAJECTORY_VERTICES; ++i) {
+            new_velocity.y -= config->gravity;
+            state.trajectory[i] = state.trajectory[i - 1] + new_velocity;
         }
-        trajectory.vao.update_vertex_data(trajectory.vertices);
     }
 }
 
-void Ball::render(const Renderer& renderer) const {
+#ifndef HEADLESS
+void Ball::render(const Renderer& renderer, const BallRenderState& state) {
     renderer.textured_shader.use();
-
-    glm::mat3 rotated_model = glm::rotate(model, rotation);
-    renderer.textured_shader.set_model(&rotated_model);
+    renderer.textured_shader.set_model(&state.model);
 
     renderer.textured_shader.set_texture(texture);
     renderer.textured_shader.DEFAULT_VAO.draw(GL_TRIANGLES);
 
-    if (renderer.draw_ball_trajectory && !grounded) {
+    if (renderer.draw_ball_trajectory && !state.grounded) {
+        trajectory.vao.update_vertex_data(state.trajectory);
+
         glm::mat3 trajectory_model = glm::mat3(1.0f);
         renderer.debug_shader.set_model(&trajectory_model);
         renderer.debug_shader.set_color(trajectory.COLOR);
         trajectory.vao.draw(GL_LINE_STRIP);
     }
 }
+#endif
 
 bool Ball::display_debug_ui() {
     using namespace ImGui;
@@ -151,7 +211,12 @@ void Ball::reset() {
     rotation       = 0.0f;
     rotation_speed = 0.0f;
     grounded       = false;
+    carried_time   = 0.0f;
     update_model_matrix();
+
+    // Don't interpolate the jump back to the start
+    last_tick_position_ = position_;
+    last_tick_rotation  = rotation;
 }
 
 void Ball::set_velocity(glm::vec2 velo) {
@@ -1,46 +1,64 @@
 #pragma once
 #include <list>
 #include "Collider.h"
+#include "ColliderTree.h"
 #include "Entity.h"
 #include "rendering/Texture.h"
-#include "Audio.h"
 
 class Renderer;
 class ConfigManager;
+struct WorldEvents;
+struct BallSnapshot;
+struct BallRenderState;
+
+// Configurable constants, every World has its own set
+struct BallConfig {
+    float rebound                = 1.0f;
+    float radius                 = 50.0f;
+    float rolling_friction       = 1.5f;
+    float gravity                = 1.0f;
+    float rolling_rotation_speed = 1.0f;
+    s32 max_bounces_per_tick     = 5;
+};
 
 class Ball : Entity {
     vec2 starting_position;
 
     vec2 velocity;
-    float rotation       = 0.0f;
-    float rotation_speed = 0.0f;
+    float rotation           = 0.0f;
+    float rotation_speed     = 0.0f;
+    float last_tick_rotation = 0.0f;
     Circle collider_;
     bool grounded = false;
 
+    // Time the last move couldn't use up because it ran out of bounces
+    float carried_time = 0.0f;
+
     Texture texture;
 
     struct Trajectory {
-        static const GLuint NUM_VERTICES = 120;
         static const Color COLOR;
         VertexArray<DebugShader::Vertex> vao;
-        std::array<DebugShader::Vertex, NUM_VERTICES> vertices;
     } trajectory;
 
-    static float REBOUND;
-    static float RADIUS;
-    static float ROLLING_FRICTION;
-    static float GRAVITY;
-    static float ROLLING_ROTATION_SPEED;
+    const BallConfig* config;
 
   public:
+    static const GLuint TRAJECTORY_VERTICES = 120;
+
     float freeze_duration = 0.0f;
 
-    void init(vec2 position, const char* texture_path);
+    void init(vec2 position,
+              const char* texture_path,
+              const BallConfig* ball_config);
     void update(const float delta_time,
-                const std::list<AABB>& level,
-                AudioManager& audio_manager,
-                bool trajectory);
-    void render(const Renderer& renderer) const;
+                const ColliderTree& level,
+                WorldEvents& events);
+    void begin_tick();
+    void save(BallSnapshot& snapshot) const;
+    void restore(const BallSnapshot& snapshot);
+    void write_render_state(BallRenderState& state, float alpha) const;
+    void render(const Renderer& renderer, const BallRenderState& state);
     bool display_debug_ui();
 
     void reset();
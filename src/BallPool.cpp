@@ -0,0 +1,213 @@
+#pragma once
+#include "BallPool.h"
+#include "World.h"
+#include "rendering/Renderer.h"
+#include "Profiler.h"
+#include <glm/gtx/matrix_transform_2d.hpp>
+
+void BallPool::init(const char* texture_path, const BallConfig* ball_config) {
+    SDL_assert(ball_config);
+    config = ball_config;
+    texture.load_from_file(texture_path);
+    clear();
+}
+
+void BallPool::spawn(vec2 position, vec2 velocity) {
+    spawn_positions.push_back(position);
+    positions.push_back(position);
+    last_tick_positions.push_back(position);
+    velocities.push_back(velocity);
+    rotations.push_back(0.0f);
+    last_tick_rotations.push_back(0.0f);
+    rotation_speeds.push_back(0.0f);
+    grounded.push_back(false);
+    carried_times.push_back(0.0f);
+    freeze_durations.push_back(0.0f);
+}
+
+void BallPool::clear() {
+    spawn_positions.clear();
+    positions.clear();
+    last_tick_positions.clear();
+    velocities.clear();
+    rotations.clear();
+    last_tick_rotations.clear();
+    rotation_speeds.clear();
+    grounded.clear();
+    carried_times.clear();
+    freeze_durations.clear();
+}
+
+size_t BallPool::size() const noexcept {
+    return positions.size();
+}
+
+void BallPool::begin_tick() {
+    last_tick_positions = positions;
+    last_tick_rotations = rotations;
+}
+
+void BallPool::update(float delta_time,
+                      const ColliderTree& level,
+                      WorldEvents& events) {
+    PROFILE_SCOPE("BallPool::update");
+    const size_t count = size();
+    moves.resize(count);
+    move_results.resize(count);
+    moving.resize(count);
+
+    // Frozen balls sit the tick out
+    size_t num_moving = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (freeze_durations[i] > 0.0f) {
+            freeze_durations[i] -= delta_time;
+            continue;
+        }
+        moves[num_moving]    = { { positions[i], config->radius },
+                                 velocities[i],
+                                 delta_time + carried_times[i],
+                                 config->rebound };
+        moving[num_moving++] = static_cast<u32>(i);
+    }
+
+    get_ballistic_move_results(
+      moves.data(),
+      num_moving,
+      level,
+      move_results.data(),
+      static_cast<size_t>(glm::max(config->max_bounces_per_tick, 1)));
+
+    // Same rules as Ball::update()
+    bool bounced = false;
+    for (size_t n = 0; n < num_moving; ++n) {
+        const BallisticMoveResult& result = move_results[n];
+        const u32 i                       = moving[n];
+
+        positions[i]     = result.new_position;
+        velocities[i]    = result.new_velocity;
+        carried_times[i] = glm::min(result.remaining_time, delta_time);
+
+        const Direction hit = result.last_hit_diretcion;
+        if (hit != Direction::NONE && hit != Direction::DOWN) {
+            bounced = true;
+        }
+
+        if (grounded[i]) {
+            velocities[i].x *= 1.0f / config->rolling_friction;
+            velocities[i].y = 0.0f;
+            rotation_speeds[i] =
+              -config->rolling_rotation_speed * velocities[i].x;
+            continue;
+        }
+
+        if (hit == Direction::DOWN
+            && result.new_velocity.y <= config->gravity * delta_time * 2.0f) {
+            velocities[i].y = 0.0f;
+            grounded[i]     = true;
+        } else {
+            velocities[i].y -= config->gravity;
+        }
+
+        if (hit == Direction::UP || hit == Direction::DOWN) {
+            rotation_speeds[i] =
+              -config->rolling_rotation_speed * velocities[i].x;
+        } else if (hit == Direction::LEFT || hit == Direction::RIGHT) {
+            rotation_speeds[i] =
+              -config->rolling_rotation_speed * velocities[i].y;
+        }
+    }
+
+    // One sound for all of them, hundreds of balls bounce every tick
+    if (bounced) { events.sounds.push_back(Sound::WALL_BOUNCE); }
+
+    for (size_t n = 0; n < num_moving; ++n) {
+        const u32 i    = moving[n];
+        float rotation = rotations[i] + rotation_speeds[i];
+        if (rotation > 2.0f * PI) {
+            rotation -= 2.0f * PI;
+        } else if (rotation < -2.0f * PI) {
+            rotation += 2.0f * PI;
+        }
+        rotations[i] = rotation;
+    }
+}
+
+void BallPool::collide(size_t a, size_t b) {
+    vec2 between   = positions[a] - positions[b];
+    float distance = glm::length(between);
+    float touching = 2.0f * config->radius;
+    if (distance >= touching || distance == 0.0f) { return; }
+
+    vec2 normal         = between / distance;
+    float closing_speed = glm::dot(velocities[a] - velocities[b], normal);
+    float penetration   = touching - distance;
+
+    // Equal masses swap the velocity along the normal. Balls that already
+    // move apart are only pushed a little, so resting ones don't stay inside
+    // each other.
+    float impulse = closing_speed < 0.0f
+                    ? -0.5f * (1.0f + config->rebound) * closing_speed
+                    : 0.0f;
+    impulse += 0.05f * penetration;
+
+    velocities[a] += normal * impulse;
+    velocities[b] -= normal * impulse;
+    grounded[a] = false;
+    grounded[b] = false;
+}
+
+void BallPool::hit(size_t ball, vec2 velocity, float freeze_duration) {
+    velocities[ball]       = velocity;
+    grounded[ball]         = false;
+    freeze_durations[ball] = freeze_duration;
+}
+
+Circle BallPool::collider(size_t ball) const {
+    return { positions[ball], config->radius };
+}
+
+void BallPool::reset(size_t ball) {
+    positions[ball]           = spawn_positions[ball];
+    last_tick_positions[ball] = spawn_positions[ball];
+    velocities[ball]          = vec2(0.0f);
+    rotations[ball]           = 0.0f;
+    last_tick_rotations[ball] = 0.0f;
+    rotation_speeds[ball]     = 0.0f;
+    grounded[ball]            = false;
+    carried_times[ball]       = 0.0f;
+}
+
+void BallPool::write_render_state(std::vector<glm::mat3>& models,
+                                  float alpha) const {
+    models.resize(size());
+    for (size_t i = 0; i < size(); ++i) {
+        // Rotation wraps around at 2 PI, take the short way
+        float rotation_change = rotations[i] - last_tick_rotations[i];
+        if (rotation_change > PI) {
+            rotation_change -= 2.0f * PI;
+        } else if (rotation_change < -PI) {
+            rotation_change += 2.0f * PI;
+        }
+
+        float rotation = last_tick_rotations[i] + rotation_change * alpha;
+        vec2 position  = glm::mix(last_tick_positions[i], positions[i], alpha);
+
+        glm::mat3 model = glm::translate(glm::mat3(1.0f), position);
+        model           = glm::rotate(model, rotation);
+        models[i]       = glm::scale(model, vec2(config->radius));
+    }
+}
+
+#ifndef HEADLESS
+void BallPool::render(const Renderer& renderer,
+                      const std::vector<glm::mat3>& models) const {
+    if (models.empty()) { return; }
+
+    renderer.textured_shader.use();
+    renderer.textured_shader.set_texture(texture);
+    for (const auto& model : models) {
+        renderer.textured_shader.set_model(&model);
+        renderer.textured_shader.DEFAULT_VAO.draw(GL_TRIANGLES);
+    }
+}
+#endif
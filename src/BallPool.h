@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include "Ball.h"
+#include "CollisionDetection.h"
+#include "rendering/Texture.h"
+
+// Lots of extra balls for party modes, on top of a World's match ball. All
+// balls share the Ball rules and config, but are stored one array per field,
+// so every step of update() is one pass over only the fields it needs and
+// all level queries of a tick go out as one batch.
+class BallPool {
+  public:
+    void init(const char* texture_path, const BallConfig* ball_config);
+
+    // Balls go back to where they were spawned after a goal
+    void spawn(vec2 position, vec2 velocity);
+    void clear();
+    size_t size() const noexcept;
+
+    // Call before every tick
+    void begin_tick();
+    void update(float delta_time,
+                const ColliderTree& level,
+                WorldEvents& events);
+
+    // Bounces two balls off each other, if they touch
+    void collide(size_t a, size_t b);
+    // Hit by a weapon, frozen for freeze_duration
+    void hit(size_t ball, vec2 velocity, float freeze_duration);
+
+    Circle collider(size_t ball) const;
+    // Ball that is in a goal, back at its spawn position
+    void reset(size_t ball);
+
+    void write_render_state(std::vector<glm::mat3>& models, float alpha) const;
+    void render(const Renderer& renderer,
+                const std::vector<glm::mat3>& models) const;
+
+  private:
+    std::vector<vec2> spawn_positions;
+    std::vector<vec2> positions, last_tick_positions;
+    std::vector<vec2> velocities;
+    std::vector<float> rotations, last_tick_rotations, rotation_speeds;
+    std::vector<u8> grounded;
+    std::vector<float> carried_times;
+    std::vector<float> freeze_durations;
+
+    // Scratch of update(), only grows
+    std::vector<BallisticMove> moves;
+    std::vector<BallisticMoveResult> move_results;
+    std::vector<u32> moving;
+
+    Texture texture;
+    const BallConfig* config;
+};
@@ -0,0 +1,364 @@
+#pragma once
+#include "BatchRunner.h"
+#include "Util.h"
+#include <chrono>
+#include <memory>
+
+// Ticks a task simulates before it queues the rest of its match
+static const u64 TICKS_PER_TASK = 600;
+
+static u64 add_tick_to_checksum(u64 checksum, const World& world) {
+    for (const auto& player : world.players) {
+        vec2 position = player.position();
+        checksum      = add_to_checksum(checksum, &position, sizeof(position));
+    }
+    vec2 ball_position = world.ball.collider().center;
+    checksum =
+      add_to_checksum(checksum, &ball_position, sizeof(ball_position));
+    for (size_t i = 0; i < world.party_balls.size(); ++i) {
+        ball_position = world.party_balls.collider(i).center;
+        checksum =
+          add_to_checksum(checksum, &ball_position, sizeof(ball_position));
+    }
+    return checksum;
+}
+
+void ScriptedMatch::init(const WorldConfig& world_config,
+                         vec2 ball_position,
+                         u32 seed,
+                         ThreadPool* jobs,
+                         size_t num_players,
+                         size_t num_party_balls) {
+    gamepads.resize(num_players);
+    inputs.assign(num_players, {});
+    bots.resize(num_players);
+    for (u32 i = 0; i < num_players; ++i) {
+        bots[i].init(seed + i);
+    }
+
+    world_.config = world_config;
+    world_.init(gamepads.data(), ball_position, num_players);
+    world_.spawn_party_balls(num_party_balls);
+    world_.jobs = jobs;
+
+    tick_count = 0;
+    num_hits   = 0;
+    checksum_  = CHECKSUM_BASIS;
+}
+
+void ScriptedMatch::run(u64 num_ticks) {
+    for (u64 n = 0; n < num_ticks; ++n, ++tick_count) {
+        for (size_t i = 0; i < bots.size(); ++i) {
+            inputs[i] = bots[i].next_input();
+            gamepads[i].set_state(inputs[i]);
+        }
+
+        if (recorder) { recorder->add_tick(inputs.data(), 0); }
+
+        world_.begin_tick();
+        world_.simulate(1.0f, events);
+        num_hits += events.hits.size();
+
+        checksum_ = add_tick_to_checksum(checksum_, world_);
+    }
+}
+
+bool ScriptedMatch::record(const char* path) {
+    if (!world_.is_match()) { return false; }
+
+    auto header        = std::make_unique<ReplayHeader>();
+    header->delta_time = 1.0f;
+    header->config     = world_.config;
+    world_.save(header->start);
+    for (u32 i = 0; i < World::NUM_PLAYERS; ++i) {
+        header->start_inputs[i] = gamepads[i].state();
+    }
+    header->has_saved_state = 0;
+
+    recorder = std::make_unique<ReplayWriter>();
+    if (!recorder->open(path, *header)) {
+        recorder.reset();
+        return false;
+    }
+    return true;
+}
+
+const World& ScriptedMatch::world() const noexcept {
+    return world_;
+}
+
+u64 ScriptedMatch::ticks() const noexcept {
+    return tick_count;
+}
+
+u64 ScriptedMatch::hits() const noexcept {
+    return num_hits;
+}
+
+u64 ScriptedMatch::checksum() const noexcept {
+    return add_to_checksum(checksum_, world_.score, sizeof(world_.score));
+}
+
+double BatchResult::ticks_per_second() const noexcept {
+    return run_seconds > 0.0 ? static_cast<double>(total_ticks) / run_seconds
+                             : 0.0;
+}
+
+double ReplayResult::ticks_per_second() const noexcept {
+    return seconds > 0.0 ? static_cast<double>(ticks) / seconds : 0.0;
+}
+
+struct MatchBatch {
+    ThreadPool& pool;
+    std::vector<std::unique_ptr<ScriptedMatch>> matches;
+    u64 ticks_per_match;
+};
+
+static void run_slice(MatchBatch& batch, size_t index) {
+    ScriptedMatch& match = *batch.matches[index];
+
+    u64 remaining = batch.ticks_per_match - match.ticks();
+    match.run(remaining < TICKS_PER_TASK ? remaining : TICKS_PER_TASK);
+
+    if (match.ticks() < batch.ticks_per_match) {
+        batch.pool.submit([&batch, index]() { run_slice(batch, index); });
+    }
+}
+
+BatchResult run_batch(ThreadPool& pool,
+                      const WorldConfig& world_config,
+                      vec2 ball_position,
+                      u32 num_matches,
+                      u64 ticks_per_match,
+                      u32 first_seed,
+                      size_t players_per_match,
+                      size_t balls_per_match) {
+    using Clock = std::chrono::steady_clock;
+
+    MatchBatch batch = { pool, {}, ticks_per_match };
+    batch.matches.resize(num_matches);
+
+    BatchResult result;
+    u64 steals_before = pool.num_steals();
+
+    // Loading is done on the pool as well, every match loads its own copy of
+    // the level and models
+    auto init_start = Clock::now();
+    for (u32 i = 0; i < num_matches; ++i) {
+        pool.submit([&batch,
+                     &world_config,
+                     ball_position,
+                     first_seed,
+                     players_per_match,
+                     balls_per_match,
+                     i]() {
+            batch.matches[i] = std::make_unique<ScriptedMatch>();
+            batch.matches[i]->init(world_config,
+                                   ball_position,
+                                   first_seed + i,
+                                   nullptr,
+                                   players_per_match,
+                                   balls_per_match);
+        });
+    }
+    pool.wait();
+
+    auto run_start = Clock::now();
+    if (ticks_per_match > 0) {
+        for (u32 i = 0; i < num_matches; ++i) {
+            pool.submit([&batch, i]() { run_slice(batch, i); });
+        }
+        pool.wait();
+    }
+    auto run_end = Clock::now();
+
+    result.init_seconds =
+      std::chrono::duration<double>(run_start - init_start).count();
+    result.run_seconds =
+      std::chrono::duration<double>(run_end - run_start).count();
+    result.total_ticks = ticks_per_match * num_matches;
+    result.steals      = pool.num_steals() - steals_before;
+
+    result.matches.reserve(num_matches);
+    for (u32 i = 0; i < num_matches; ++i) {
+        const ScriptedMatch& match = *batch.matches[i];
+        MatchResult match_result;
+        match_result.seed = first_seed + i;
+        for (size_t n = 0; n < World::NUM_PLAYERS; ++n) {
+            match_result.score[n] = match.world().score[n];
+        }
+        match_result.hits     = match.hits();
+        match_result.checksum = match.checksum();
+        result.matches.push_back(match_result);
+    }
+
+    // Freeing the worlds is spread over the pool as well
+    for (u32 i = 0; i < num_matches; ++i) {
+        pool.submit([&batch, i]() { batch.matches[i].reset(); });
+    }
+    pool.wait();
+
+    return result;
+}
+
+struct ReplayPlayer {
+    ReplayReader reader;
+    World world;
+    Gamepad gamepads[World::NUM_PLAYERS];
+    WorldEvents events;
+    WorldSnapshot saved_state;
+};
+
+ReplayResult play_replay(const char* path) {
+    using Clock = std::chrono::steady_clock;
+
+    ReplayResult result = {};
+    auto replay         = std::make_unique<ReplayPlayer>();
+    if (!replay->reader.open(path)) { return result; }
+    result.loaded = true;
+
+    const ReplayHeader& header = replay->reader.header();
+    World& world               = replay->world;
+    world.config               = header.config;
+    world.init(replay->gamepads, header.start.ball.starting_position);
+    world.restore(header.start);
+
+    for (u32 i = 0; i < World::NUM_PLAYERS; ++i) {
+        replay->gamepads[i].set_state(header.start_inputs[i]);
+    }
+    bool has_saved_state = header.has_saved_state != 0;
+    replay->saved_state  = header.saved_state;
+
+    u64 checksum = CHECKSUM_BASIS;
+    GamepadState inputs[World::NUM_PLAYERS];
+    u32 commands;
+
+    auto start = Clock::now();
+    while (replay->reader.next_tick(inputs, commands)) {
+        if (commands & ReplayCommand::SAVE_STATE) {
+            world.save(replay->saved_state);
+            has_saved_state = true;
+        }
+        if ((commands & ReplayCommand::LOAD_STATE) && has_saved_state) {
+            world.restore(replay->saved_state);
+        }
+
+        for (u32 i = 0; i < World::NUM_PLAYERS; ++i) {
+            replay->gamepads[i].set_state(inputs[i]);
+        }
+
+        world.begin_tick();
+        world.simulate(header.delta_time, replay->events);
+        checksum = add_tick_to_checksum(checksum, world);
+    }
+    auto end = Clock::now();
+
+    result.ticks   = replay->reader.ticks();
+    result.seconds = std::chrono::duration<double>(end - start).count();
+
+    result.checksum =
+      add_to_checksum(checksum, world.score, sizeof(world.score));
+    for (size_t i = 0; i < World::NUM_PLAYERS; ++i) {
+        result.score[i] = world.score[i];
+    }
+    return result;
+}
+
+struct LoopbackPeer {
+    World world;
+    Gamepad gamepads[World::NUM_PLAYERS];
+    RollbackSession session;
+    WorldEvents events;
+
+    Bot bot;
+
+    // Input for the next tick, made when input_index != num_inputs
+    GamepadState input;
+    u64 input_index;
+    u64 num_inputs;
+};
+
+LoopbackResult run_loopback_match(const WorldConfig& world_config,
+                                  vec2 ball_position,
+                                  const LoopbackLink::Settings& link_settings,
+                                  u32 input_delay,
+                                  u64 num_ticks,
+                                  u32 seed) {
+    using Clock            = std::chrono::steady_clock;
+    const double TICK_TIME = 1000.0 / 60.0;
+
+    std::unique_ptr<LoopbackPeer> peers[World::NUM_PLAYERS];
+    for (u32 i = 0; i < World::NUM_PLAYERS; ++i) {
+        peers[i]           = std::make_unique<LoopbackPeer>();
+        LoopbackPeer& peer = *peers[i];
+        peer.world.config  = world_config;
+        peer.input_index   = static_cast<u64>(-1);
+        peer.num_inputs    = 0;
+        peer.bot.init(seed + i);
+        peer.world.init(peer.gamepads, ball_position);
+        peer.session.init(&peer.world, peer.gamepads, i, input_delay);
+    }
+
+    LoopbackLink link;
+    link.init(link_settings);
+
+    LoopbackResult result   = {};
+    u64 num_advances        = 0;
+    double total_advance_ms = 0.0;
+
+    double now = 0.0;
+    while (peers[0]->session.current_tick() < num_ticks
+           || peers[1]->session.current_tick() < num_ticks) {
+        for (u32 i = 0; i < World::NUM_PLAYERS; ++i) {
+            LoopbackPeer& peer = *peers[i];
+
+            InputPacket packet;
+            while (link.receive(i, now, packet)) {
+                peer.session.add_remote_inputs(packet);
+            }
+
+            if (peer.session.current_tick() < num_ticks) {
+                if (peer.input_index != peer.num_inputs) {
+                    // Same input as the bot of a ScriptedMatch
+                    peer.input       = peer.bot.next_input();
+                    peer.input_index = peer.num_inputs;
+                }
+
+                auto start = Clock::now();
+                bool advanced =
+                  peer.session.advance(peer.input, 1.0f, peer.events);
+                double advance_ms = std::chrono::duration<double, std::milli>(
+                                      Clock::now() - start)
+                                      .count();
+
+                // A stalled peer tries the same input again next time
+                if (advanced) {
+                    ++peer.num_inputs;
+
+                    ++num_advances;
+                    total_advance_ms += advance_ms;
+                    if (advance_ms > result.max_advance_ms) {
+                        result.max_advance_ms = advance_ms;
+                    }
+                    u32 prediction = peer.session.prediction_ticks();
+                    if (prediction > result.max_prediction_ticks) {
+                        result.max_prediction_ticks = prediction;
+                    }
+                }
+            }
+
+            peer.session.make_packet(packet);
+            link.send(i, packet, now);
+        }
+        now += TICK_TIME;
+    }
+
+    for (u32 i = 0; i < World::NUM_PLAYERS; ++i) {
+        result.stats[i] = peers[i]->session.stats();
+    }
+    result.ticks = num_ticks;
+    result.average_advance_ms =
+      num_advances > 0 ? total_advance_ms / static_cast<double>(num_advances)
+                       : 0.0;
+    return result;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Bot.h"
+#include "Input.h"
+#include "Replay.h"
+#include "Rollback.h"
+#include "ThreadPool.h"
+#include "Types.h"
+#include "World.h"
+
+// A World with a Bot on every gamepad. Matches with the same config, seed and
+// number of players play out exactly the same.
+class ScriptedMatch {
+  public:
+    ScriptedMatch() = default;
+    ScriptedMatch(const ScriptedMatch&) = delete;
+    ScriptedMatch& operator=(const ScriptedMatch&) = delete;
+
+    // With jobs, the World updates its players in parallel on it. Only plain
+    // matches, without extra players or party balls, can be recorded.
+    void init(const WorldConfig& world_config,
+              vec2 ball_position,
+              u32 seed,
+              ThreadPool* jobs       = nullptr,
+              size_t num_players     = World::NUM_PLAYERS,
+              size_t num_party_balls = 0);
+    void run(u64 num_ticks);
+
+    // Records the inputs of every tick run() simulates from now on, until the
+    // match is destroyed
+    bool record(const char* path);
+
+    const World& world() const noexcept;
+    u64 ticks() const noexcept;
+    u64 hits() const noexcept;
+
+    // Of the positions of players and balls after every tick and the score
+    u64 checksum() const noexcept;
+
+  private:
+    World world_;
+    std::vector<Gamepad> gamepads;
+    std::vector<GamepadState> inputs;
+    std::vector<Bot> bots;
+    WorldEvents events;
+    std::unique_ptr<ReplayWriter> recorder;
+
+    u64 tick_count = 0;
+    u64 num_hits   = 0;
+    u64 checksum_  = 0;
+};
+
+struct MatchResult {
+    u32 seed;
+    uint score[World::NUM_PLAYERS];
+    u64 hits;
+    u64 checksum;
+};
+
+struct BatchResult {
+    std::vector<MatchResult> matches;  // In seed order
+    u64 total_ticks;
+    u64 steals;
+
+    double init_seconds;  // Loading levels and models
+    double run_seconds;   // Only simulating
+
+    double ticks_per_second() const noexcept;
+};
+
+// Plays num_matches independent matches with the seeds first_seed,
+// first_seed + 1, ... on pool, for balance testing and bot evaluation. Matches
+// are simulated in slices of a few hundred ticks, so the pool can balance
+// matches that take longer than others.
+BatchResult run_batch(ThreadPool& pool,
+                      const WorldConfig& world_config,
+                      vec2 ball_position,
+                      u32 num_matches,
+                      u64 ticks_per_match,
+                      u32 first_seed,
+                      size_t players_per_match = World::NUM_PLAYERS,
+                      size_t balls_per_match   = 0);
+
+struct ReplayResult {
+    bool loaded;
+    u64 ticks;
+    double seconds;
+
+    // Same as ScriptedMatch::checksum(), so a replay of a scripted match has
+    // to end up with the match's checksum
+    u64 checksum;
+    uint score[World::NUM_PLAYERS];
+
+    double ticks_per_second() const noexcept;
+};
+
+// Plays a replay file back as fast as possible. The level is loaded from disk,
+// like in the game.
+ReplayResult play_replay(const char* path);
+
+struct LoopbackResult {
+    RollbackStats stats[World::NUM_PLAYERS];  // Of each peer
+    u64 ticks;
+    u32 max_prediction_ticks;
+
+    // Time a peer took for advance(), including rolling back
+    double average_advance_ms;
+    double max_advance_ms;
+};
+
+// Plays a match as two peers, each with its own World and one scripted
+// player, connected through a LoopbackLink with the given latency. Both run at
+// 60 ticks per second of simulated time, as fast as they can.
+LoopbackResult run_loopback_match(const WorldConfig& world_config,
+                                  vec2 ball_position,
+                                  const LoopbackLink::Settings& link_settings,
+                                  u32 input_delay,
+                                  u64 num_ticks,
+                                  u32 seed);
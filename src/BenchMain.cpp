@@ -0,0 +1,593 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sdl/SDL_rwops.h>
+#include "Animator.h"
+#include "ColliderTree.h"
+#include "CollisionDetection.h"
+#include "Player.h"
+#include "Spline.h"
+#include "WeaponTrail.h"
+#include "rendering/Mesh.h"
+
+// Microbenchmarks of the hot kernels of the simulation, each on its own, so
+// changes to them can be compared on any machine. Every benchmark first
+// doubles the operations per sample until a sample takes at least --min-time,
+// which warms up the caches on the way, and then times --samples samples.
+// Reported per operation are the median, mean, standard deviation, extremes
+// and the 95% confidence interval of the mean. Compare medians, and only
+// trust differences that are bigger than the intervals.
+//
+// Usage: procAnimBench [--samples N] [--min-time MS] [--seed N]
+//                      [--filter TEXT] [--json FILE] [--list] [--verify]
+//
+// --filter only runs the benchmarks with TEXT in their name.
+// --json writes all results, including every sample, to FILE.
+// --verify checks that the collision kernel this was built with gets exactly
+// the same results as testing the boxes one at a time, instead of timing
+// anything. build_bench.sh also builds procAnimBenchScalar without SIMD, both
+// have to print the same checksum for the same seed.
+// Run it from inside bin like procAnimHeadless, the IK and bone benchmarks
+// use the player model from the assets.
+
+// Level sizes of the collision benchmarks, and the area a box gets
+static const size_t LEVEL_SIZES[] = { 100, 1000, 10000, 100000 };
+static const float LEVEL_CELL_SIZE = 400.0f;
+
+// Number of different inputs each benchmark cycles through. A power of two,
+// so picking one is a mask.
+static const size_t NUM_INPUTS = 4096;
+
+// Same as the ball in the default config
+static const float BALL_RADIUS = 57.0f;
+static const float REBOUND     = 0.8f;
+
+struct BenchSettings {
+    size_t samples            = 30;
+    double min_sample_seconds = 0.01;
+    u32 seed                  = 1;
+    const char* filter        = nullptr;
+    bool list                 = false;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string params;
+    u64 ops_per_sample;
+    std::vector<double> samples;  // Nanoseconds per operation
+
+    double median, mean, stddev, min, max;
+    double ci95;  // Half the width of the interval around the mean
+};
+
+// What the measured code computes ends up here, so it can't be optimized away
+static volatile float sink;
+
+static u32 next_random(u32& state) {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// In [min, max)
+static float random_float(u32& state, float min, float max) {
+    float unit = static_cast<float>(next_random(state) >> 8) / 16777216.0f;
+    return min + unit * (max - min);
+}
+
+static vec2 random_direction(u32& state) {
+    float angle = random_float(state, 0.0f, PI * 2.0f);
+    return vec2(cosf(angle), sinf(angle));
+}
+
+static bool wanted(const BenchSettings& settings, const char* name) {
+    if (settings.filter && !strstr(name, settings.filter)) { return false; }
+    if (settings.list) {
+        printf("%s\n", name);
+        return false;
+    }
+    return true;
+}
+
+static void summarize(BenchResult& result) {
+    std::vector<double> sorted = result.samples;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+
+    result.min    = sorted.front();
+    result.max    = sorted.back();
+    result.median = n % 2 == 1 ? sorted[n / 2]
+                               : (sorted[n / 2 - 1] + sorted[n / 2]) * 0.5;
+
+    double sum = 0.0;
+    for (double sample : sorted) {
+        sum += sample;
+    }
+    result.mean = sum / static_cast<double>(n);
+
+    double squares = 0.0;
+    for (double sample : sorted) {
+        squares += (sample - result.mean) * (sample - result.mean);
+    }
+    result.stddev =
+      n > 1 ? std::sqrt(squares / static_cast<double>(n - 1)) : 0.0;
+
+    // Normal approximation, close enough from the default 30 samples on
+    result.ci95 = 1.96 * result.stddev / std::sqrt(static_cast<double>(n));
+}
+
+// Runs op(i) for i = 0, 1, 2, ... and returns the time it took. op returns
+// something that depends on its work.
+template<typename Op>
+static double time_ops(Op& op, u64 num_ops) {
+    using Clock = std::chrono::steady_clock;
+
+    float accumulated = 0.0f;
+    auto start        = Clock::now();
+    for (u64 i = 0; i < num_ops; ++i) {
+        accumulated += op(i);
+    }
+    double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+    sink = accumulated;
+    return seconds;
+}
+
+template<typename Op>
+static void measure(const BenchSettings& settings,
+                    std::vector<BenchResult>& results,
+                    const char* name,
+                    const std::string& params,
+                    Op op) {
+    u64 num_ops = 1;
+    while (time_ops(op, num_ops) < settings.min_sample_seconds) {
+        num_ops *= 2;
+    }
+
+    BenchResult result;
+    result.name           = name;
+    result.params         = params;
+    result.ops_per_sample = num_ops;
+    for (size_t i = 0; i < settings.samples; ++i) {
+        double seconds = time_ops(op, num_ops);
+        result.samples.push_back(seconds * 1.0e9
+                                 / static_cast<double>(num_ops));
+    }
+    summarize(result);
+
+    printf("[BENCH] %-36s %-14s %10.1f ns +-%5.1f%%  (mean %.1f, sd %.1f, "
+           "min %.1f, %zd x %llu ops)\n",
+           name,
+           params.c_str(),
+           result.median,
+           result.mean > 0.0 ? result.ci95 / result.mean * 100.0 : 0.0,
+           result.mean,
+           result.stddev,
+           result.min,
+           result.samples.size(),
+           static_cast<unsigned long long>(num_ops));
+
+    results.push_back(std::move(result));
+}
+
+// Boxes spread over a square that grows with their number, so every level
+// size has the same density and the queries see about as many boxes. The
+// boxes must not move while the tree is in use.
+static void generate_level(size_t num_boxes,
+                           u32 seed,
+                           std::vector<AABB>& boxes,
+                           ColliderTree& tree) {
+    float side = std::sqrt(static_cast<float>(num_boxes)) * LEVEL_CELL_SIZE;
+
+    u32 state = seed;
+    boxes.clear();
+    boxes.reserve(num_boxes);
+    for (size_t i = 0; i < num_boxes; ++i) {
+        AABB box;
+        box.center   = { random_float(state, 0.0f, side),
+                         random_float(state, 0.0f, side) };
+        box.half_ext = { random_float(state, 25.0f, 150.0f),
+                         random_float(state, 25.0f, 150.0f) };
+        boxes.push_back(box);
+    }
+
+    std::vector<ColliderTree::Entry> entries;
+    entries.reserve(num_boxes);
+    for (const AABB& box : boxes) {
+        entries.push_back({ &box, ColliderTree::LEVEL });
+    }
+    tree.build(entries);
+}
+
+// Circles anywhere in the level that don't overlap a box yet, like the ball
+// at the start of a tick
+static void generate_queries(const ColliderTree& tree,
+                             size_t num_boxes,
+                             u32 seed,
+                             std::vector<SweptCircle>& queries) {
+    float side = std::sqrt(static_cast<float>(num_boxes)) * LEVEL_CELL_SIZE;
+
+    u32 state = seed;
+    SmallVector<const AABB*, 16> overlapping;
+    queries.clear();
+    while (queries.size() < NUM_INPUTS) {
+        Circle circle = { { random_float(state, 0.0f, side),
+                            random_float(state, 0.0f, side) },
+                          BALL_RADIUS };
+
+        overlapping.clear();
+        tree.find_candidates(
+          { circle.center, vec2(circle.radius) }, overlapping);
+        bool blocked = false;
+        for (const AABB* box : overlapping) {
+            if (test_circle_AABB(circle, *box)) { blocked = true; }
+        }
+        if (blocked) { continue; }
+
+        Vector move =
+          random_direction(state) * random_float(state, 0.0f, 80.0f);
+        queries.push_back({ circle, move });
+    }
+}
+
+static void bench_collision(const BenchSettings& settings,
+                            std::vector<BenchResult>& results) {
+    const char* SWEEP_NAME     = "find_first_collision_moving_circle";
+    const char* BALLISTIC_NAME = "get_ballistic_move_result";
+    bool sweep                 = wanted(settings, SWEEP_NAME);
+    bool ballistic             = wanted(settings, BALLISTIC_NAME);
+    if (!sweep && !ballistic) { return; }
+
+    for (size_t num_boxes : LEVEL_SIZES) {
+        std::vector<AABB> boxes;
+        ColliderTree tree;
+        std::vector<SweptCircle> queries;
+        generate_level(num_boxes, settings.seed, boxes, tree);
+        generate_queries(tree, num_boxes, settings.seed + 1, queries);
+
+        std::string params = "boxes=" + std::to_string(num_boxes);
+        CollisionScratch& scratch = CollisionScratch::for_this_thread();
+
+        if (sweep) {
+            measure(settings, results, SWEEP_NAME, params, [&](u64 i) {
+                const SweptCircle& query = queries[i & (NUM_INPUTS - 1)];
+                return find_first_collision_moving_circle(
+                         query.circle, query.move, tree, scratch)
+                  .t;
+            });
+        }
+
+        // The moves are the velocities for a whole tick, with up to five
+        // bounces like the ball
+        if (ballistic) {
+            measure(settings, results, BALLISTIC_NAME, params, [&](u64 i) {
+                const SweptCircle& query = queries[i & (NUM_INPUTS - 1)];
+                return get_ballistic_move_result(query.circle,
+                                                 query.move,
+                                                 1.0f,
+                                                 tree,
+                                                 REBOUND,
+                                                 5,
+                                                 scratch)
+                  .new_position.x;
+            });
+        }
+    }
+}
+
+static bool same_result(const CollisionData& a, const CollisionData& b) {
+    return a.t == b.t && a.position == b.position
+        && a.direction == b.direction && a.hit_object == b.hit_object;
+}
+
+// FNV-1a over everything in the result, with the hit box as its index
+static u64 hash_result(u64 hash,
+                       const CollisionData& result,
+                       const std::vector<AABB>& boxes) {
+    s64 box = result.hit_object ? result.hit_object - boxes.data() : -1;
+    float floats[3] = { result.t, result.position.x, result.position.y };
+    s32 direction   = static_cast<s32>(result.direction);
+
+    u8 bytes[sizeof(floats) + sizeof(direction) + sizeof(box)];
+    memcpy(bytes, floats, sizeof(floats));
+    memcpy(bytes + sizeof(floats), &direction, sizeof(direction));
+    memcpy(bytes + sizeof(floats) + sizeof(direction), &box, sizeof(box));
+    for (u8 byte : bytes) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool verify_collision(u32 seed) {
+#if defined(COLLISION_SIMD_AVX)
+    const char* kernel = "AVX";
+#elif defined(COLLISION_SIMD_SSE)
+    const char* kernel = "SSE";
+#else
+    const char* kernel = "scalar";
+#endif
+
+    u64 checksum         = 14695981039346656037ull;
+    size_t all_different = 0;
+    for (size_t num_boxes : LEVEL_SIZES) {
+        std::vector<AABB> boxes;
+        ColliderTree tree;
+        std::vector<SweptCircle> queries;
+        generate_level(num_boxes, seed, boxes, tree);
+        generate_queries(tree, num_boxes, seed + 1, queries);
+
+        // Moves along an axis and no move at all take their own paths
+        // through the kernel
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (i % 8 == 1) { queries[i].move.x = 0.0f; }
+            if (i % 8 == 2) { queries[i].move.y = 0.0f; }
+            if (i % 8 == 3) { queries[i].move = Vector(0.0f); }
+        }
+
+        std::vector<CollisionData> batched(queries.size());
+        for (size_t first = 0; first < queries.size();
+             first += ColliderTree::MAX_BATCH_SIZE) {
+            size_t count = std::min(ColliderTree::MAX_BATCH_SIZE,
+                                    queries.size() - first);
+            find_first_collisions_moving_circles(
+              &queries[first], count, tree, &batched[first]);
+        }
+
+        size_t different = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const SweptCircle& query = queries[i];
+            CollisionData expected =
+              find_first_collision_moving_circle_scalar(
+                query.circle, query.move, tree);
+            CollisionData single = find_first_collision_moving_circle(
+              query.circle, query.move, tree);
+
+            if (!same_result(single, expected)
+                || !same_result(batched[i], expected)) {
+                ++different;
+            }
+            checksum = hash_result(checksum, single, boxes);
+        }
+
+        printf("[BENCH] %s kernel, boxes=%zd: %zd of %zd queries differ\n",
+               kernel,
+               num_boxes,
+               different,
+               queries.size());
+        all_different += different;
+    }
+
+    printf("[BENCH] Checksum %016llx\n",
+           static_cast<unsigned long long>(checksum));
+    return all_different == 0;
+}
+
+static void bench_spline(const BenchSettings& settings,
+                         std::vector<BenchResult>& results) {
+    const char* NAME = "Spline::get_point_on_spline";
+    if (!wanted(settings, NAME)) { return; }
+
+    // Shaped like a step of the walk animation
+    const vec2 points[Spline::NUM_POINTS] = {
+        { 0.0f, 0.0f }, { 40.0f, 120.0f }, { 40.0f, -120.0f }, { 200.0f, 0.0f }
+    };
+    Spline spline;
+    spline.init(points);
+
+    measure(settings, results, NAME, "", [&](u64 i) {
+        float t = static_cast<float>(i & (NUM_INPUTS - 1))
+                / static_cast<float>(NUM_INPUTS);
+        return spline.get_point_on_spline(t).y;
+    });
+}
+
+static size_t chain_length(const Bone& bone) {
+    size_t length = 0;
+    for (const Bone* b = &bone; b; b = b->parent()) {
+        ++length;
+    }
+    return length;
+}
+
+static void bench_skeleton(const BenchSettings& settings,
+                           std::vector<BenchResult>& results,
+                           PlayerModel& model) {
+    const char* IK_NAME        = "solve_ik";
+    const char* TRANSFORM_NAME = "Bone::transform";
+    const char* ALL_BONES_NAME = "Bone::transform all bones";
+    bool ik                    = wanted(settings, IK_NAME);
+    bool transform             = wanted(settings, TRANSFORM_NAME);
+    bool all_bones             = wanted(settings, ALL_BONES_NAME);
+    if (!ik && !transform && !all_bones) { return; }
+
+    if (model.rigged_mesh.bones.empty()) {
+        model.load("../assets/playerTexture.png", "../assets/guy.fbx");
+    }
+    RiggedMesh mesh = model.rigged_mesh;
+
+    if (ik) {
+        // Targets in and out of reach of the left leg, in the model space
+        // solve_ik() works in
+        Bone* leg[2] = { mesh.find_bone("Leg_L_1"), mesh.find_bone("Leg_L_2") };
+        SDL_assert_always(leg[0] && leg[1]);
+        vec2 hip    = leg[0]->head();
+        float reach = leg[0]->length + leg[1]->length;
+
+        u32 state = settings.seed;
+        std::vector<vec2> targets(NUM_INPUTS);
+        for (vec2& target : targets) {
+            target = hip
+                   + random_direction(state)
+                       * random_float(state, 0.2f, 1.3f) * reach;
+        }
+
+        measure(settings, results, IK_NAME, "", [&](u64 i) {
+            solve_ik(leg, targets[i & (NUM_INPUTS - 1)]);
+            return leg[1]->rotation;
+        });
+    }
+
+    if (transform) {
+        const Bone* deepest = &mesh.bones.front();
+        for (const Bone& bone : mesh.bones) {
+            if (chain_length(bone) > chain_length(*deepest)) {
+                deepest = &bone;
+            }
+        }
+
+        std::string params = "depth=" + std::to_string(chain_length(*deepest));
+        measure(settings, results, TRANSFORM_NAME, params, [&](u64) {
+            return deepest->transform()[2].x;
+        });
+    }
+
+    // What posing a whole player costs, one operation is every bone
+    if (all_bones) {
+        std::string params = "bones=" + std::to_string(mesh.bones.size());
+        measure(settings, results, ALL_BONES_NAME, params, [&](u64) {
+            float x = 0.0f;
+            for (const Bone& bone : mesh.bones) {
+                x += bone.transform()[2].x;
+            }
+            return x;
+        });
+    }
+}
+
+static void bench_weapon_trail(const BenchSettings& settings,
+                               std::vector<BenchResult>& results) {
+    const char* NAME = "WeaponTrail::update";
+    if (!wanted(settings, NAME)) { return; }
+
+    PlayerConfig config;
+    WeaponTrail trail;
+    trail.init(&config.max_hit_trail_angle, &config.max_hit_trail_length);
+
+    // The tip of a weapon swinging back and forth, a new trail starts at
+    // every turn
+    const float SWING_RADIUS = 150.0f;
+    const size_t SWING_STEPS = 40;
+    std::vector<vec2> positions(NUM_INPUTS);
+    float angle = 0.0f;
+    float step  = 0.12f;
+    for (size_t i = 0; i < NUM_INPUTS; ++i) {
+        if (i % SWING_STEPS == 0) { step = -step; }
+        angle += step;
+        positions[i] = vec2(cosf(angle), sinf(angle)) * SWING_RADIUS;
+    }
+
+    measure(settings, results, NAME, "", [&](u64 i) {
+        trail.update(positions[i & (NUM_INPUTS - 1)]);
+        return trail.trail_length;
+    });
+}
+
+static void append_number(std::string& json, double value) {
+    char number[32];
+    snprintf(number, sizeof(number), "%.3f", value);
+    json += number;
+}
+
+static bool write_json(const char* path,
+                       const BenchSettings& settings,
+                       const std::vector<BenchResult>& results) {
+    std::string json = "{\n\"unit\":\"ns\",\"samples\":";
+    json += std::to_string(settings.samples);
+    json += ",\"min_sample_ms\":";
+    append_number(json, settings.min_sample_seconds * 1000.0);
+    json += ",\"seed\":" + std::to_string(settings.seed);
+    json += ",\n\"benchmarks\":[\n";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        if (i > 0) { json += ",\n"; }
+
+        json += "{\"name\":\"" + result.name + "\",\"params\":\""
+              + result.params + "\",\"ops_per_sample\":"
+              + std::to_string(result.ops_per_sample);
+        json += ",\"median\":";
+        append_number(json, result.median);
+        json += ",\"mean\":";
+        append_number(json, result.mean);
+        json += ",\"stddev\":";
+        append_number(json, result.stddev);
+        json += ",\"min\":";
+        append_number(json, result.min);
+        json += ",\"max\":";
+        append_number(json, result.max);
+        json += ",\"ci95\":";
+        append_number(json, result.ci95);
+        json += ",\"samples\":[";
+        for (size_t s = 0; s < result.samples.size(); ++s) {
+            if (s > 0) { json += ","; }
+            append_number(json, result.samples[s]);
+        }
+        json += "]}";
+    }
+    json += "\n]}\n";
+
+    SDL_RWops* file = SDL_RWFromFile(path, "w");
+    if (!file) { return false; }
+    size_t written = SDL_RWwrite(file, json.data(), 1, json.size());
+    SDL_RWclose(file);
+    return written == json.size();
+}
+
+int main(int argc, char* argv[]) {
+    BenchSettings settings;
+    const char* json_path = nullptr;
+    bool verify           = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            settings.samples = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            settings.min_sample_seconds = strtod(argv[++i], nullptr) / 1000.0;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            settings.seed = static_cast<u32>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            settings.filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            settings.list = true;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else {
+            printf("Usage: %s [--samples N] [--min-time MS] [--seed N] "
+                   "[--filter TEXT] [--json FILE] [--list] [--verify]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    if (settings.samples < 2) { settings.samples = 2; }
+    // xorshift gets stuck at 0
+    if (settings.seed == 0) { settings.seed = 1; }
+
+    if (verify) { return verify_collision(settings.seed) ? 0 : 1; }
+
+    std::vector<BenchResult> results;
+    PlayerModel model;
+
+    bench_collision(settings, results);
+    bench_spline(settings, results);
+    bench_skeleton(settings, results, model);
+    bench_weapon_trail(settings, results);
+
+    if (json_path && !settings.list) {
+        if (!write_json(json_path, settings, results)) {
+            printf("[BENCH] Couldn't write %s\n", json_path);
+            return 1;
+        }
+        printf("[BENCH] Wrote %s\n", json_path);
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+// Microbenchmarks of the simulation's hot kernels, without a window, GL
+// context or audio device. Build with HEADLESS defined. BenchMain.cpp comes
+// last so it can reach static functions like solve_ik().
+#ifndef HEADLESS
+#error "BenchUnity.cpp needs HEADLESS to be defined"
+#endif
+
+#include "Animator.cpp"
+#include "Ball.cpp"
+#include "BallPool.cpp"
+#include "Bot.cpp"
+#include "Collider.cpp"
+#include "ColliderTree.cpp"
+#include "CollisionDetection.cpp"
+#include "CollisionVerifier.cpp"
+#include "ConfigManager.cpp"
+#include "Counters.cpp"
+#include "DynamicBroadphase.cpp"
+#include "Entity.cpp"
+#include "FrameArena.cpp"
+#include "GroundIndex.cpp"
+#include "Input.cpp"
+#include "Level.cpp"
+#include "Player.cpp"
+#include "Profiler.cpp"
+#include "RenderState.cpp"
+#include "Replay.cpp"
+#include "Rollback.cpp"
+#include "Snapshot.cpp"
+#include "Spline.cpp"
+#include "TaskGraph.cpp"
+#include "ThreadPool.cpp"
+#include "Util.cpp"
+#include "WeaponTrail.cpp"
+#include "World.cpp"
+#include "rendering/Color.cpp"
+#include "rendering/Mesh.cpp"
+#include "rendering/Renderer.cpp"
+#include "rendering/Texture.cpp"
+#include "BenchMain.cpp"
+
+// Third party libraries
+#include "imgui/imgui.cpp"
+#include "imgui/imgui_widgets.cpp"
+#include "imgui/imgui_draw.cpp"
@@ -0,0 +1,45 @@
+#pragma once
+#include "Bot.h"
+
+void Bot::init(u32 seed) {
+    // xorshift gets stuck at 0
+    script_state = seed * 2654435761u | 1u;
+    held_input   = {};
+    num_inputs   = 0;
+}
+
+GamepadState Bot::next_input() {
+    GamepadState input;
+    if (num_inputs % INPUT_HOLD_TICKS == 0) {
+        held_input = random_input(script_state);
+        input      = held_input;
+    } else {
+        // Sticks stay where they are, buttons are let go after the first tick
+        // so they register as pressed again later
+        input         = held_input;
+        input.buttons = 0;
+    }
+    ++num_inputs;
+    return input;
+}
+
+GamepadState Bot::random_input(u32& state) {
+    auto next = [&state]() {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+    auto next_axis = [&next]() {
+        return static_cast<float>(next() % 2001) / 1000.0f - 1.0f;
+    };
+
+    GamepadState result = {};
+    result.axes[SDL_CONTROLLER_AXIS_LEFTX]  = next_axis();
+    result.axes[SDL_CONTROLLER_AXIS_RIGHTX] = next_axis();
+    result.axes[SDL_CONTROLLER_AXIS_RIGHTY] = next_axis();
+
+    if (next() % 4 == 0) { result.buttons |= BIT(SDL_CONTROLLER_BUTTON_A); }
+    return result;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Types.h"
+#include "Input.h"
+
+// Plays without a gamepad: random input from a seeded xorshift32, each held
+// for a few ticks. Bots with the same seed press the same buttons on the same
+// ticks, so matches they play can be repeated exactly.
+class Bot {
+  public:
+    // How many ticks each input is held
+    static const u32 INPUT_HOLD_TICKS = 20;
+
+    void init(u32 seed);
+
+    // Input for the next tick
+    GamepadState next_input();
+
+    // Random input from a xorshift32 state, changes state
+    static GamepadState random_input(u32& state);
+
+  private:
+    u32 script_state;
+    GamepadState held_input;
+    u64 num_inputs;
+};
@@ -0,0 +1,488 @@
+#pragma once
+#include "ColliderTree.h"
+#include "CollisionDetection.h"
+#include "Profiler.h"
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <glm/glm.hpp>
+#include <sdl/SDL_assert.h>
+
+// Half of the perimeter of the box [min, max]. Used as the cost of a node when
+// deciding where to insert a new leaf.
+static float half_perimeter(glm::vec2 min, glm::vec2 max) {
+    return (max.x - min.x) + (max.y - min.y);
+}
+
+static bool overlaps(glm::vec2 min_a,
+                     glm::vec2 max_a,
+                     glm::vec2 min_b,
+                     glm::vec2 max_b) {
+    return min_a.x <= max_b.x && min_b.x <= max_a.x && min_a.y <= max_b.y
+        && min_b.y <= max_a.y;
+}
+
+std::atomic<u64> ColliderTree::last_version { 0 };
+
+static u32 lowest_bit_index(u64 bits) {
+    SDL_assert(bits != 0);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return index;
+#else
+    return static_cast<u32>(__builtin_ctzll(bits));
+#endif
+}
+
+u32 ColliderTree::goal_group(size_t team) {
+    SDL_assert(team < 2);
+    return 1u << (team + 1);
+}
+
+bool ColliderTree::Node::is_leaf() const noexcept {
+    return children[0] == NULL_NODE;
+}
+
+void ColliderTree::build(const std::vector<Entry>& entries) {
+    nodes.clear();
+    leaf_of.clear();
+    root      = NULL_NODE;
+    free_list = NULL_NODE;
+    bump_version();
+
+    if (entries.empty()) { return; }
+
+    nodes.reserve(entries.size() * 2);
+
+    std::vector<s32> leaves;
+    leaves.reserve(entries.size());
+    for (const auto& entry : entries) {
+        s32 leaf           = allocate_node();
+        nodes[leaf].min    = entry.box->center - entry.box->half_ext;
+        nodes[leaf].max    = entry.box->center + entry.box->half_ext;
+        nodes[leaf].box    = entry.box;
+        nodes[leaf].groups = entry.group;
+
+        leaf_of[entry.box] = leaf;
+        leaves.push_back(leaf);
+    }
+
+    root               = build_recursive(leaves.data(), leaves.size());
+    nodes[root].parent = NULL_NODE;
+}
+
+void ColliderTree::insert(const AABB* box, u32 group) {
+    SDL_assert(leaf_of.find(box) == leaf_of.end());
+
+    s32 leaf           = allocate_node();
+    nodes[leaf].min    = box->center - box->half_ext;
+    nodes[leaf].max    = box->center + box->half_ext;
+    nodes[leaf].box    = box;
+    nodes[leaf].groups = group;
+    leaf_of[box]       = leaf;
+
+    insert_leaf(leaf);
+    bump_version();
+}
+
+void ColliderTree::remove(const AABB* box) {
+    auto it = leaf_of.find(box);
+    SDL_assert(it != leaf_of.end());
+
+    remove_leaf(it->second);
+    free_node(it->second);
+    leaf_of.erase(it);
+    bump_version();
+}
+
+void ColliderTree::update(const AABB* box) {
+    auto it = leaf_of.find(box);
+    SDL_assert(it != leaf_of.end());
+    s32 leaf = it->second;
+
+    glm::vec2 new_min = box->center - box->half_ext;
+    glm::vec2 new_max = box->center + box->half_ext;
+
+    if (overlaps(nodes[leaf].min, nodes[leaf].max, new_min, new_max)) {
+        // Small edits like dragging or resizing a box only need the bounds on
+        // the path to the root to be refit.
+        nodes[leaf].min = new_min;
+        nodes[leaf].max = new_max;
+        refit_ancestors(nodes[leaf].parent);
+    } else {
+        // The box was moved somewhere else entirely, reinsert it so it ends up
+        // next to its new neighbours.
+        remove_leaf(leaf);
+        nodes[leaf].min = new_min;
+        nodes[leaf].max = new_max;
+        insert_leaf(leaf);
+    }
+    bump_version();
+}
+
+void ColliderTree::find_candidates(const AABB& area,
+                                   ScratchVector<const AABB*>& out,
+                                   u32 groups) const {
+    PROFILE_SCOPE("ColliderTree::find_candidates");
+    if (root == NULL_NODE) { return; }
+
+    const glm::vec2 area_min = area.center - area.half_ext;
+    const glm::vec2 area_max = area.center + area.half_ext;
+
+    s32 stack[MAX_STACK_SIZE];
+    size_t stack_size   = 0;
+    stack[stack_size++] = root;
+
+    while (stack_size > 0) {
+        const Node& node = nodes[stack[--stack_size]];
+
+        if (!(node.groups & groups)
+            || !overlaps(node.min, node.max, area_min, area_max)) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            out.push_back(node.box);
+        } else {
+            SDL_assert(stack_size + 2 <= MAX_STACK_SIZE);
+            stack[stack_size++] = node.children[0];
+            stack[stack_size++] = node.children[1];
+        }
+    }
+}
+
+void ColliderTree::find_candidates(const AABB* areas,
+                                   size_t count,
+                                   ScratchVector<Candidate>& out,
+                                   u32 groups) const {
+    PROFILE_SCOPE("ColliderTree::find_candidates batch");
+    SDL_assert(count <= MAX_BATCH_SIZE);
+    if (root == NULL_NODE || count == 0) { return; }
+
+    glm::vec2 area_min[MAX_BATCH_SIZE], area_max[MAX_BATCH_SIZE];
+    for (size_t i = 0; i < count; ++i) {
+        area_min[i] = areas[i].center - areas[i].half_ext;
+        area_max[i] = areas[i].center + areas[i].half_ext;
+    }
+
+    // Every stack entry carries the set of areas that overlap all of its
+    // ancestors, so each node is only visited once for the whole batch.
+    struct StackEntry {
+        s32 node;
+        u64 areas;
+    };
+    StackEntry stack[MAX_STACK_SIZE];
+    size_t stack_size = 0;
+    stack[stack_size++] =
+      { root, count == 64 ? ~0ull : (1ull << count) - 1ull };
+
+    while (stack_size > 0) {
+        StackEntry entry = stack[--stack_size];
+        const Node& node = nodes[entry.node];
+        if (!(node.groups & groups)) { continue; }
+
+        u64 overlapping = 0;
+        for (u64 remaining = entry.areas; remaining;
+             remaining &= remaining - 1) {
+            u32 i = lowest_bit_index(remaining);
+            if (overlaps(node.min, node.max, area_min[i], area_max[i])) {
+                overlapping |= 1ull << i;
+            }
+        }
+        if (!overlapping) { continue; }
+
+        if (node.is_leaf()) {
+            for (u64 remaining = overlapping; remaining;
+                 remaining &= remaining - 1) {
+                out.push_back({ lowest_bit_index(remaining), node.box });
+            }
+        } else {
+            SDL_assert(stack_size + 2 <= MAX_STACK_SIZE);
+            stack[stack_size++] = { node.children[0], overlapping };
+            stack[stack_size++] = { node.children[1], overlapping };
+        }
+    }
+}
+
+const AABB* ColliderTree::find_at(Point p, u32 groups) const {
+    if (root == NULL_NODE) { return nullptr; }
+
+    s32 stack[MAX_STACK_SIZE];
+    size_t stack_size   = 0;
+    stack[stack_size++] = root;
+
+    while (stack_size > 0) {
+        const Node& node = nodes[stack[--stack_size]];
+
+        if (!(node.groups & groups) || !overlaps(node.min, node.max, p, p)) {
+            continue;
+        }
+
+        if (node.is_leaf()) {
+            if (test_point_AABB(p, *node.box)) { return node.box; }
+        } else {
+            SDL_assert(stack_size + 2 <= MAX_STACK_SIZE);
+            stack[stack_size++] = node.children[0];
+            stack[stack_size++] = node.children[1];
+        }
+    }
+    return nullptr;
+}
+
+void ColliderTree::find_all(std::vector<const AABB*>& out, u32 groups) const {
+    for (const auto& entry : leaf_of) {
+        if (nodes[entry.second].groups & groups) { out.push_back(entry.first); }
+    }
+}
+
+size_t ColliderTree::height() const noexcept {
+    if (root == NULL_NODE) { return 0; }
+    return static_cast<size_t>(nodes[root].height) + 1;
+}
+
+u64 ColliderTree::version() const noexcept { return version_; }
+
+void ColliderTree::bump_version() { version_ = ++last_version; }
+
+s32 ColliderTree::allocate_node() {
+    s32 index;
+    if (free_list != NULL_NODE) {
+        index     = free_list;
+        free_list = nodes[index].parent;
+    } else {
+        index = static_cast<s32>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    Node& node       = nodes[index];
+    node.parent      = NULL_NODE;
+    node.children[0] = NULL_NODE;
+    node.children[1] = NULL_NODE;
+    node.height      = 0;
+    node.box         = nullptr;
+    node.groups      = 0;
+    return index;
+}
+
+void ColliderTree::free_node(s32 index) {
+    nodes[index].height = -1;
+    nodes[index].parent = free_list;
+    free_list           = index;
+}
+
+s32 ColliderTree::build_recursive(s32* leaves, size_t count) {
+    SDL_assert(count > 0);
+    if (count == 1) { return leaves[0]; }
+
+    // Split the leaves at the median along the axis on which their centers are
+    // spread out the most
+    glm::vec2 centers_min = glm::vec2(FLT_MAX);
+    glm::vec2 centers_max = glm::vec2(-FLT_MAX);
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec2 center = nodes[leaves[i]].min + nodes[leaves[i]].max;
+        centers_min      = glm::min(centers_min, center);
+        centers_max      = glm::max(centers_max, center);
+    }
+    const glm::vec2 spread = centers_max - centers_min;
+    const int axis         = spread.x >= spread.y ? 0 : 1;
+
+    const size_t half = count / 2;
+    std::nth_element(leaves,
+                     leaves + half,
+                     leaves + count,
+                     [this, axis](s32 a, s32 b) {
+                         return nodes[a].min[axis] + nodes[a].max[axis]
+                              < nodes[b].min[axis] + nodes[b].max[axis];
+                     });
+
+    s32 left  = build_recursive(leaves, half);
+    s32 right = build_recursive(leaves + half, count - half);
+
+    s32 index                = allocate_node();
+    nodes[index].children[0] = left;
+    nodes[index].children[1] = right;
+    nodes[left].parent       = index;
+    nodes[right].parent      = index;
+    refit_node(index);
+
+    return index;
+}
+
+void ColliderTree::insert_leaf(s32 leaf) {
+    if (root == NULL_NODE) {
+        root               = leaf;
+        nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    const glm::vec2 leaf_min = nodes[leaf].min;
+    const glm::vec2 leaf_max = nodes[leaf].max;
+
+    // Walk down the tree to find the sibling that increases the summed
+    // perimeters of all nodes the least (see Box2D's b2DynamicTree)
+    s32 index = root;
+    while (!nodes[index].is_leaf()) {
+        const Node& node = nodes[index];
+
+        float area     = half_perimeter(node.min, node.max);
+        float combined = half_perimeter(glm::min(node.min, leaf_min),
+                                        glm::max(node.max, leaf_max));
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combined;
+
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritance_cost = 2.0f * (combined - area);
+
+        float child_cost[2];
+        for (size_t i = 0; i < 2; ++i) {
+            const Node& child = nodes[node.children[i]];
+
+            float child_combined = half_perimeter(
+              glm::min(child.min, leaf_min), glm::max(child.max, leaf_max));
+            if (child.is_leaf()) {
+                child_cost[i] = child_combined + inheritance_cost;
+            } else {
+                child_cost[i] = child_combined
+                              - half_perimeter(child.min, child.max)
+                              + inheritance_cost;
+            }
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1]) { break; }
+
+        index = child_cost[0] < child_cost[1] ? node.children[0]
+                                              : node.children[1];
+    }
+
+    const s32 sibling    = index;
+    const s32 old_parent = nodes[sibling].parent;
+    const s32 new_parent = allocate_node();
+
+    nodes[new_parent].parent      = old_parent;
+    nodes[new_parent].children[0] = sibling;
+    nodes[new_parent].children[1] = leaf;
+    nodes[sibling].parent         = new_parent;
+    nodes[leaf].parent            = new_parent;
+
+    if (old_parent == NULL_NODE) {
+        root = new_parent;
+    } else if (nodes[old_parent].children[0] == sibling) {
+        nodes[old_parent].children[0] = new_parent;
+    } else {
+        nodes[old_parent].children[1] = new_parent;
+    }
+
+    refit_ancestors(new_parent);
+}
+
+void ColliderTree::remove_leaf(s32 leaf) {
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    const s32 parent      = nodes[leaf].parent;
+    const s32 grandparent = nodes[parent].parent;
+    const s32 sibling     = nodes[parent].children[0] == leaf
+                            ? nodes[parent].children[1]
+                            : nodes[parent].children[0];
+
+    if (grandparent == NULL_NODE) {
+        root                  = sibling;
+        nodes[sibling].parent = NULL_NODE;
+        free_node(parent);
+        return;
+    }
+
+    // Replace the parent with the sibling
+    if (nodes[grandparent].children[0] == parent) {
+        nodes[grandparent].children[0] = sibling;
+    } else {
+        nodes[grandparent].children[1] = sibling;
+    }
+    nodes[sibling].parent = grandparent;
+    free_node(parent);
+
+    refit_ancestors(grandparent);
+}
+
+void ColliderTree::refit_ancestors(s32 index) {
+    while (index != NULL_NODE) {
+        refit_node(index);
+        index = balance(index);
+        index = nodes[index].parent;
+    }
+}
+
+// Performs a left or right rotation if the subtree at index is imbalanced.
+// Returns the new root of the subtree (see Box2D's b2DynamicTree::Balance).
+s32 ColliderTree::balance(s32 index_a) {
+    if (nodes[index_a].is_leaf() || nodes[index_a].height < 2) {
+        return index_a;
+    }
+
+    const s32 index_b = nodes[index_a].children[0];
+    const s32 index_c = nodes[index_a].children[1];
+    const s32 balance = nodes[index_c].height - nodes[index_b].height;
+
+    // Rotate the higher child up. side is the index of the higher child in A's
+    // children.
+    if (balance > 1 || balance < -1) {
+        const size_t side     = balance > 1 ? 1 : 0;
+        const s32 index_up    = nodes[index_a].children[side];
+        const s32 grandchild0 = nodes[index_up].children[0];
+        const s32 grandchild1 = nodes[index_up].children[1];
+
+        // Swap A and the higher child
+        nodes[index_up].children[0] = index_a;
+        nodes[index_up].parent      = nodes[index_a].parent;
+        nodes[index_a].parent       = index_up;
+
+        const s32 old_parent = nodes[index_up].parent;
+        if (old_parent == NULL_NODE) {
+            root = index_up;
+        } else if (nodes[old_parent].children[0] == index_a) {
+            nodes[old_parent].children[0] = index_up;
+        } else {
+            nodes[old_parent].children[1] = index_up;
+        }
+
+        // The higher grandchild stays with the rotated node, the other one
+        // takes the rotated node's old place in A
+        s32 keep, give;
+        if (nodes[grandchild0].height > nodes[grandchild1].height) {
+            keep = grandchild0;
+            give = grandchild1;
+        } else {
+            keep = grandchild1;
+            give = grandchild0;
+        }
+
+        nodes[index_up].children[1]   = keep;
+        nodes[index_a].children[side] = give;
+        nodes[give].parent            = index_a;
+
+        refit_node(index_a);
+        refit_node(index_up);
+
+        return index_up;
+    }
+
+    return index_a;
+}
+
+void ColliderTree::refit_node(s32 index) {
+    Node& node = nodes[index];
+    if (node.is_leaf()) { return; }
+
+    const Node& child0 = nodes[node.children[0]];
+    const Node& child1 = nodes[node.children[1]];
+
+    node.min    = glm::min(child0.min, child1.min);
+    node.max    = glm::max(child0.max, child1.max);
+    node.height = 1 + std::max(child0.height, child1.height);
+    node.groups = child0.groups | child1.groups;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include "Collider.h"
+#include "SmallVector.h"
+#include "Types.h"
+#include "Util.h"
+
+// Bounding volume hierarchy over the colliders of a level. The tree is built
+// top-down when a level is loaded and then kept up to date incrementally, so
+// the LevelEditor can add, move, resize and delete colliders without
+// rebuilding it.
+class ColliderTree {
+  public:
+    // Every collider belongs to exactly one group. Queries take a mask of the
+    // groups they are interested in.
+    static const u32 LEVEL      = BIT(0);
+    static const u32 ALL_GOALS  = BIT(1) | BIT(2);
+    static const u32 ALL_GROUPS = LEVEL | ALL_GOALS;
+
+    static u32 goal_group(size_t team);
+
+    struct Entry {
+        const AABB* box;
+        u32 group;
+    };
+
+    // A box that overlaps areas[area] of a batch query
+    struct Candidate {
+        u32 area;
+        const AABB* box;
+    };
+
+    static const size_t MAX_BATCH_SIZE = 64;
+
+    void build(const std::vector<Entry>& entries);
+
+    void insert(const AABB* box, u32 group);
+    void remove(const AABB* box);
+
+    // Has to be called after box was moved or resized.
+    void update(const AABB* box);
+
+    // Appends all boxes in groups that overlap area to out.
+    void find_candidates(const AABB& area,
+                         ScratchVector<const AABB*>& out,
+                         u32 groups = LEVEL) const;
+
+    // Finds the candidates of up to MAX_BATCH_SIZE areas in a single
+    // traversal. For each area the boxes are appended in the same order as
+    // find_candidates() would return them.
+    void find_candidates(const AABB* areas,
+                         size_t count,
+                         ScratchVector<Candidate>& out,
+                         u32 groups = LEVEL) const;
+
+    // Returns a box in groups that contains p or nullptr if there is none.
+    const AABB* find_at(Point p, u32 groups = ALL_GROUPS) const;
+
+    // Appends every box in groups to out.
+    void find_all(std::vector<const AABB*>& out, u32 groups = LEVEL) const;
+
+    size_t height() const noexcept;
+
+    // Changes whenever a box is added, removed or updated. Versions are unique
+    // across all trees.
+    u64 version() const noexcept;
+
+  private:
+    static const s32 NULL_NODE         = -1;
+    static const size_t MAX_STACK_SIZE = 256;
+
+    struct Node {
+        glm::vec2 min, max;
+        s32 parent;
+        s32 children[2];
+        s32 height;  // 0 for leaves, -1 for nodes in the free list
+
+        const AABB* box;  // nullptr for inner nodes
+        u32 groups;       // For inner nodes, the union of all children
+
+        bool is_leaf() const noexcept;
+    };
+
+    std::vector<Node> nodes;
+    s32 root      = NULL_NODE;
+    s32 free_list = NULL_NODE;
+
+    std::unordered_map<const AABB*, s32> leaf_of;
+
+    u64 version_ = 0;
+    static std::atomic<u64> last_version;
+
+    s32 allocate_node();
+    void free_node(s32 index);
+
+    s32 build_recursive(s32* leaves, size_t count);
+
+    void insert_leaf(s32 leaf);
+    void remove_leaf(s32 leaf);
+
+    // Recalculates bounds, height and groups of index and all its ancestors,
+    // rebalancing the tree on the way up.
+    void refit_ancestors(s32 index);
+    s32 balance(s32 index);
+    void refit_node(s32 index);
+
+    void bump_version();
+};
@@ -3,10 +3,23 @@
 #include "glm/glm.hpp"
 #include "sdl/SDL_assert.h"
 #include "CollisionDetection.h"
+#include "CollisionVerifier.h"
 #include "Types.h"
 #include "Util.h"
-
-#define VERIFY_COLLISION_OUTCOMES
+#include "Profiler.h"
+#include "Counters.h"
+
+// Define COLLISION_FORCE_SCALAR to run the batch kernel without SIMD.
+#if !defined(COLLISION_FORCE_SCALAR)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define COLLISION_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLLISION_SIMD_SSE
+#endif
+#endif
 
 struct Ray {
     Point origin;
@@ -261,23 +274,18 @@ static Point apply_margins(Point p, Direction dir, const AABB& box) {
     return p;
 }
 
-static bool intersect_moving_circle_AABB(const Circle& circle,
-                                         const Vector& move,
-                                         const AABB& box,
-                                         float& t,
-                                         Point& p,
-                                         Direction& dir) {
-
-    // Compute the AABB resulting from expanding the box by circle.radius
+// Given the intersection t, p and dir of the circle movement with box
+// expanded by circle.radius, checks whether the circle actually hits box and
+// corrects t, p and dir if the hit is on one of the corners.
+static bool resolve_moving_circle_AABB_hit(const Circle& circle,
+                                           const Vector& move,
+                                           const AABB& box,
+                                           float& t,
+                                           Point& p,
+                                           Direction& dir) {
     AABB expanded_box = box;
     expanded_box.half_ext += Vector(circle.radius);
 
-    // Intersect ray against expanded_box. Exit with no itnersection if ray
-    // misses, else get intersection point and time t as result
-    if (!intersect_ray_AABB(
-          Ray { circle.center, move }, expanded_box, t, p, dir))
-        return false;
-
     // If the intersection lies in the Voronoi region of a corner, set
     // intersection_corner to that one
     Corner intersection_corner = Corner::NONE;
@@ -337,102 +345,623 @@ static bool intersect_moving_circle_AABB(const Circle& circle,
     return true;
 }
 
-const CollisionData find_first_collision_moving_circle(
-  const Circle& circle, const Vector move, const std::list<AABB>& boxes) {
-    AABB culling_box;
-    {
-        Vector half_move       = move * 0.5f;
-        culling_box.center     = circle.center + half_move;
-        culling_box.half_ext.x = std::abs(half_move.x) + circle.radius + 5.0f;
-        culling_box.half_ext.y = std::abs(half_move.y) + circle.radius + 5.0f;
+#ifdef VERIFY_COLLISION_OUTCOMES
+static bool intersect_moving_circle_AABB(const Circle& circle,
+                                         const Vector& move,
+                                         const AABB& box,
+                                         float& t,
+                                         Point& p,
+                                         Direction& dir) {
+
+    // Compute the AABB resulting from expanding the box by circle.radius
+    AABB expanded_box = box;
+    expanded_box.half_ext += Vector(circle.radius);
+
+    // Intersect ray against expanded_box. Exit with no itnersection if ray
+    // misses, else get intersection point and time t as result
+    if (!intersect_ray_AABB(
+          Ray { circle.center, move }, expanded_box, t, p, dir))
+        return false;
+
+    return resolve_moving_circle_AABB_hit(circle, move, box, t, p, dir);
+}
+#endif
+
+CollisionScratch& CollisionScratch::for_this_thread() {
+    static thread_local CollisionScratch scratch;
+    return scratch;
+}
+
+// Fills the structure of arrays bounds of scratch.boxes, with every box
+// expanded by radius, so the batch kernel can run the slab test on several
+// boxes at once.
+static void expand_candidates(CollisionScratch& scratch, float radius) {
+    const size_t count = scratch.boxes.size();
+    scratch.min_x.resize(count);
+    scratch.min_y.resize(count);
+    scratch.max_x.resize(count);
+    scratch.max_y.resize(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        // Same operations as AABB::min()/max() on the expanded box, so the
+        // kernel gets bit identical t values to intersect_ray_AABB()
+        const AABB& box  = *scratch.boxes[i];
+        Vector half_ext  = box.half_ext + Vector(radius);
+        scratch.min_x[i] = box.center.x - half_ext.x;
+        scratch.min_y[i] = box.center.y - half_ext.y;
+        scratch.max_x[i] = box.center.x + half_ext.x;
+        scratch.max_y[i] = box.center.y + half_ext.y;
+    }
+}
+
+#if defined(COLLISION_SIMD_AVX) || defined(COLLISION_SIMD_SSE)
+// Thin wrappers so the kernel is written once for both register widths
+namespace Lanes {
+#if defined(COLLISION_SIMD_AVX)
+typedef __m256 Floats;
+const size_t WIDTH = 8;
+
+static Floats load(const float* p) { return _mm256_loadu_ps(p); }
+static Floats set(float f) { return _mm256_set1_ps(f); }
+static void store(float* p, Floats a) { _mm256_storeu_ps(p, a); }
+static Floats sub(Floats a, Floats b) { return _mm256_sub_ps(a, b); }
+static Floats mul(Floats a, Floats b) { return _mm256_mul_ps(a, b); }
+static Floats smaller(Floats a, Floats b) { return _mm256_min_ps(a, b); }
+static Floats larger(Floats a, Floats b) { return _mm256_max_ps(a, b); }
+static Floats both(Floats a, Floats b) { return _mm256_and_ps(a, b); }
+static Floats greater(Floats a, Floats b) {
+    return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+static Floats less(Floats a, Floats b) {
+    return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+static Floats less_equal(Floats a, Floats b) {
+    return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+}
+static int mask(Floats a) { return _mm256_movemask_ps(a); }
+#else
+typedef __m128 Floats;
+const size_t WIDTH = 4;
+
+static Floats load(const float* p) { return _mm_loadu_ps(p); }
+static Floats set(float f) { return _mm_set1_ps(f); }
+static void store(float* p, Floats a) { _mm_storeu_ps(p, a); }
+static Floats sub(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+static Floats mul(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+static Floats smaller(Floats a, Floats b) { return _mm_min_ps(a, b); }
+static Floats larger(Floats a, Floats b) { return _mm_max_ps(a, b); }
+static Floats both(Floats a, Floats b) { return _mm_and_ps(a, b); }
+static Floats greater(Floats a, Floats b) { return _mm_cmpgt_ps(a, b); }
+static Floats less(Floats a, Floats b) { return _mm_cmplt_ps(a, b); }
+static Floats less_equal(Floats a, Floats b) { return _mm_cmple_ps(a, b); }
+static int mask(Floats a) { return _mm_movemask_ps(a); }
+#endif
+}  // namespace Lanes
+#endif
+
+// Result of the slab test of one moving circle against one expanded box
+struct SlabHit {
+    float t;
+    Direction dir;
+};
+
+static Direction slab_direction(const Vector& move, int axis) {
+    if (axis == 0) return move.x < 0.0f ? Direction::LEFT : Direction::RIGHT;
+    return move.y < 0.0f ? Direction::DOWN : Direction::UP;
+}
+
+// Scalar version of the slab test in the kernel below. Follows the same steps
+// as intersect_ray_AABB(), just on the structure of arrays layout.
+static bool slab_test(const Point& origin,
+                      const Vector& move,
+                      const CollisionScratch& candidates,
+                      size_t i,
+                      SlabHit& hit) {
+    const float mins[2] = { candidates.min_x[i], candidates.min_y[i] };
+    const float maxs[2] = { candidates.max_x[i], candidates.max_y[i] };
+
+    float t     = 0.0f;
+    float t_max = FLT_MAX;
+    hit.dir     = Direction::NONE;
+    for (int axis = 0; axis < 2; ++axis) {
+        if (std::abs(move[axis]) < FLT_EPSILON) {
+            if (origin[axis] <= mins[axis] || origin[axis] >= maxs[axis])
+                return false;
+        } else {
+            float ood = 1.0f / move[axis];
+            float t1  = (mins[axis] - origin[axis]) * ood;
+            float t2  = (maxs[axis] - origin[axis]) * ood;
+            if (t1 > t2) std::swap(t1, t2);
+            if (t1 > t) {
+                t       = t1;
+                hit.dir = slab_direction(move, axis);
+            }
+            if (t2 < t_max) t_max = t2;
+            if (t > t_max || t_max <= 0.0f) return false;
+        }
+    }
+    hit.t = t;
+    return true;
+}
+
+// Turns the slab hit of candidate i into an actual hit and keeps it in result
+// if it is the earliest one so far. Candidates have to be passed in order so
+// ties go to the same box as in the scalar loop.
+static void resolve_slab_hit(const Circle& circle,
+                             const Vector& move,
+                             const CollisionScratch& candidates,
+                             size_t i,
+                             const SlabHit& hit,
+                             CollisionData& result,
+                             size_t& hit_index) {
+    float t       = hit.t;
+    Direction dir = hit.dir;
+    Point p       = circle.center + move * t;
+    if (!resolve_moving_circle_AABB_hit(
+          circle, move, *candidates.boxes[i], t, p, dir))
+        return;
+
+    if (t < result.t) {
+        result.position   = p;
+        result.t          = t;
+        result.direction  = dir;
+        result.hit_object = candidates.boxes[i];
+        hit_index         = i;
     }
+}
 
-    std::vector<const AABB*> candidates;
-    for (const auto& box : boxes) {
-        if (test_AABB_AABB(culling_box, box)) { candidates.push_back(&box); }
+static const size_t NO_HIT = SIZE_MAX;
+
+// The candidates from first on, one at a time
+static void intersect_moving_circle_candidates_scalar(
+  const Circle& circle,
+  const Vector& move,
+  const CollisionScratch& candidates,
+  size_t first,
+  CollisionData& result,
+  size_t& hit_index) {
+    for (size_t i = first; i < candidates.boxes.size(); ++i) {
+        SlabHit hit;
+        if (slab_test(circle.center, move, candidates, i, hit)) {
+            resolve_slab_hit(
+              circle, move, candidates, i, hit, result, hit_index);
+        }
     }
+}
+
+// Finds the earliest hit of the moving circle with any of the candidates.
+// The slab tests run on several boxes per instruction, only the (rare) lanes
+// that hit fall back to scalar code for the corner regions. Returns the index
+// of the box that was hit or NO_HIT.
+static size_t intersect_moving_circle_candidates(
+  const Circle& circle,
+  const Vector& move,
+  const CollisionScratch& candidates,
+  CollisionData& result) {
+    size_t hit_index = NO_HIT;
+    size_t i         = 0;
+
+#if defined(COLLISION_SIMD_AVX) || defined(COLLISION_SIMD_SSE)
+    using namespace Lanes;
+    const size_t count = candidates.boxes.size();
+
+    // The movement is the same for all lanes, so the parallel axis cases
+    // can be decided once per query instead of once per box
+    const bool parallel_x = std::abs(move.x) < FLT_EPSILON;
+    const bool parallel_y = std::abs(move.y) < FLT_EPSILON;
+
+    const Floats zero     = set(0.0f);
+    const Floats origin_x = set(circle.center.x);
+    const Floats origin_y = set(circle.center.y);
+    const Floats ood_x    = set(parallel_x ? 0.0f : 1.0f / move.x);
+    const Floats ood_y    = set(parallel_y ? 0.0f : 1.0f / move.y);
+    const Direction dir_x = slab_direction(move, 0);
+    const Direction dir_y = slab_direction(move, 1);
+
+    for (; i + WIDTH <= count; i += WIDTH) {
+        const Floats min_x = load(&candidates.min_x[i]);
+        const Floats max_x = load(&candidates.max_x[i]);
+        const Floats min_y = load(&candidates.min_y[i]);
+        const Floats max_y = load(&candidates.max_y[i]);
+
+        Floats t     = zero;
+        Floats t_max = set(FLT_MAX);
+        Floats valid = less_equal(zero, zero);
+        Floats hit_x = zero;
+        Floats hit_y = zero;
+
+        if (parallel_x) {
+            valid = both(valid, greater(origin_x, min_x));
+            valid = both(valid, less(origin_x, max_x));
+        } else {
+            Floats a  = mul(sub(min_x, origin_x), ood_x);
+            Floats b  = mul(sub(max_x, origin_x), ood_x);
+            Floats t1 = smaller(a, b);
+            hit_x     = greater(t1, t);
+            t         = larger(t1, t);
+            t_max     = smaller(larger(a, b), t_max);
+        }
+
+        if (parallel_y) {
+            valid = both(valid, greater(origin_y, min_y));
+            valid = both(valid, less(origin_y, max_y));
+        } else {
+            Floats a  = mul(sub(min_y, origin_y), ood_y);
+            Floats b  = mul(sub(max_y, origin_y), ood_y);
+            Floats t1 = smaller(a, b);
+            hit_y     = greater(t1, t);
+            t         = larger(t1, t);
+            t_max     = smaller(larger(a, b), t_max);
+        }
+
+        valid = both(valid, less_equal(t, t_max));
+        valid = both(valid, greater(t_max, zero));
+
+        int hits = mask(valid);
+        if (!hits) continue;
+
+        float ts[WIDTH];
+        store(ts, t);
+        const int x_entered = mask(hit_x);
+        const int y_entered = mask(hit_y);
+
+        for (size_t lane = 0; lane < WIDTH; ++lane) {
+            if (!(hits & BIT(lane))) continue;
+
+            SlabHit hit;
+            hit.t = ts[lane];
+            if (y_entered & BIT(lane)) {
+                hit.dir = dir_y;
+            } else if (x_entered & BIT(lane)) {
+                hit.dir = dir_x;
+            } else {
+                hit.dir = Direction::NONE;
+            }
+            resolve_slab_hit(
+              circle, move, candidates, i + lane, hit, result, hit_index);
+        }
+    }
+#endif
+
+    // Remaining boxes that don't fill a whole register
+    intersect_moving_circle_candidates_scalar(
+      circle, move, candidates, i, result, hit_index);
+
+    return hit_index;
+}
+
+// Box around everything a circle can touch while moving by move
+static AABB culling_box_of(const Circle& circle, const Vector move) {
+    AABB culling_box;
+    Vector half_move       = move * 0.5f;
+    culling_box.center     = circle.center + half_move;
+    culling_box.half_ext.x = std::abs(half_move.x) + circle.radius + 5.0f;
+    culling_box.half_ext.y = std::abs(half_move.y) + circle.radius + 5.0f;
+    return culling_box;
+}
+
+// Narrowphase of a single query against the candidates in scratch.boxes
+static CollisionData
+find_first_collision_in_candidates(const Circle& circle,
+                                   const Vector move,
+                                   const ColliderTree& level,
+                                   CollisionScratch& scratch) {
+    Counters::add(Counter::SWEPT_QUERIES);
+    Counters::add(Counter::CANDIDATE_BOXES, scratch.boxes.size());
+    expand_candidates(scratch, circle.radius);
 
     CollisionData result {
         circle.center + move, 1.0f, Direction::NONE, nullptr
     };
-    for (const auto& box : candidates) {
-        float t;
-        Point p;
-        Direction dir;
-        if (intersect_moving_circle_AABB(circle, move, *box, t, p, dir)) {
-            if (t < result.t) {
-                result.position   = p;
-                result.t          = t;
-                result.direction  = dir;
-                result.hit_object = box;
+    intersect_moving_circle_candidates(circle, move, scratch, result);
+
+#ifdef VERIFY_COLLISION_OUTCOMES
+    {
+        // The batch kernel has to agree exactly with testing every box on
+        // its own
+        CollisionData expected {
+            circle.center + move, 1.0f, Direction::NONE, nullptr
+        };
+        for (const auto& box : scratch.boxes) {
+            float t;
+            Point p;
+            Direction dir = Direction::NONE;
+            if (intersect_moving_circle_AABB(circle, move, *box, t, p, dir)) {
+                if (t < expected.t) {
+                    expected.position   = p;
+                    expected.t          = t;
+                    expected.direction  = dir;
+                    expected.hit_object = box;
+                }
             }
         }
+        SDL_assert(result.t == expected.t);
+        SDL_assert(result.position == expected.position);
+        SDL_assert(result.direction == expected.direction);
+        SDL_assert(result.hit_object == expected.hit_object);
     }
-
-#ifdef VERIFY_COLLISION_OUTCOMES
     {
         Circle final_pos { result.position, circle.radius };
-        for (const auto& box : candidates) {
+        for (const auto& box : scratch.boxes) {
             SDL_assert(!test_circle_AABB(final_pos, *box));
         }
-        for (const auto& box : boxes) {
-            SDL_assert(!test_circle_AABB(final_pos, box));
-        }
     }
+    CollisionVerifier::submit({ CollisionVerifier::QueryType::FIRST_COLLISION,
+                                circle,
+                                move,
+                                1.0f,
+                                1.0f,
+                                result.position,
+                                result.t,
+                                result.direction },
+                              level);
+#else
+    (void)level;
 #endif
 
     return result;
 }
 
+const CollisionData
+find_first_collision_moving_circle(const Circle& circle,
+                                   const Vector move,
+                                   const ColliderTree& level,
+                                   CollisionScratch& scratch) {
+    scratch.boxes.clear();
+    level.find_candidates(culling_box_of(circle, move), scratch.boxes);
+    return find_first_collision_in_candidates(circle, move, level, scratch);
+}
+
+const CollisionData
+find_first_collision_moving_circle_scalar(const Circle& circle,
+                                          const Vector move,
+                                          const ColliderTree& level,
+                                          CollisionScratch& scratch) {
+    scratch.boxes.clear();
+    level.find_candidates(culling_box_of(circle, move), scratch.boxes);
+    expand_candidates(scratch, circle.radius);
+
+    CollisionData result {
+        circle.center + move, 1.0f, Direction::NONE, nullptr
+    };
+    size_t hit_index = NO_HIT;
+    intersect_moving_circle_candidates_scalar(
+      circle, move, scratch, 0, result, hit_index);
+    return result;
+}
+
+void find_first_collisions_moving_circles(const SweptCircle* queries,
+                                          size_t count,
+                                          const ColliderTree& level,
+                                          CollisionData* results,
+                                          CollisionScratch& scratch) {
+    PROFILE_SCOPE("find_first_collisions_moving_circles");
+    const size_t MAX_BATCH_SIZE = ColliderTree::MAX_BATCH_SIZE;
+
+    for (size_t first = 0; first < count; first += MAX_BATCH_SIZE) {
+        const size_t batch_size =
+          count - first < MAX_BATCH_SIZE ? count - first : MAX_BATCH_SIZE;
+        const SweptCircle* batch = queries + first;
+
+        scratch.areas.resize(batch_size);
+        for (size_t i = 0; i < batch_size; ++i) {
+            scratch.areas[i] = culling_box_of(batch[i].circle, batch[i].move);
+        }
+
+        scratch.batch_candidates.clear();
+        level.find_candidates(
+          scratch.areas.data(), batch_size, scratch.batch_candidates);
+
+        // Counting sort by circle. Keeps the traversal order of the
+        // candidates of each circle, so ties are resolved like in a single
+        // query.
+        u32 offsets[MAX_BATCH_SIZE + 1] = {};
+        for (const auto& candidate : scratch.batch_candidates) {
+            ++offsets[candidate.area + 1];
+        }
+        for (size_t i = 1; i <= batch_size; ++i) {
+            offsets[i] += offsets[i - 1];
+        }
+
+        u32 write_pos[MAX_BATCH_SIZE];
+        for (size_t i = 0; i < batch_size; ++i) {
+            write_pos[i] = offsets[i];
+        }
+        scratch.sorted_candidates.resize(scratch.batch_candidates.size());
+        for (const auto& candidate : scratch.batch_candidates) {
+            scratch.sorted_candidates[write_pos[candidate.area]++] =
+              candidate.box;
+        }
+
+        for (size_t i = 0; i < batch_size; ++i) {
+            scratch.boxes.clear();
+            for (u32 j = offsets[i]; j < offsets[i + 1]; ++j) {
+                scratch.boxes.push_back(scratch.sorted_candidates[j]);
+            }
+            results[first + i] = find_first_collision_in_candidates(
+              batch[i].circle, batch[i].move, level, scratch);
+        }
+    }
+}
+
+void BallisticMoveStats::record(u64 move_iterations,
+                                bool exhausted) noexcept {
+    ++total_moves;
+    total_iterations += move_iterations;
+    if (exhausted) { ++total_exhausted; }
+    if (move_iterations > most_iterations) {
+        most_iterations = move_iterations;
+    }
+}
+
+BallisticMoveStats BallisticMoveStats::take() noexcept {
+    BallisticMoveStats stats;
+    stats.moves            = total_moves;
+    stats.iterations       = total_iterations;
+    stats.max_iterations   = most_iterations;
+    stats.budget_exhausted = total_exhausted;
+
+    total_moves = total_iterations = most_iterations = total_exhausted = 0;
+    return stats;
+}
+
+// Applies the outcome of one sweep to a ballistic move in progress. Returns
+// true if the body didn't hit anything and state is final.
+static bool advance_ballistic_move(const BallisticMove& move,
+                                   const CollisionData& collision,
+                                   float& remaining_time,
+                                   BallisticMoveResult& state) {
+    state.new_position = collision.position;
+
+    if (collision.direction == Direction::NONE) {
+        return true;
+    } else if (collision.direction == Direction::LEFT
+               || collision.direction == Direction::RIGHT) {
+        state.new_velocity.x *= -move.rebound;
+    } else {
+        SDL_assert(collision.direction == Direction::UP
+                   || collision.direction == Direction::DOWN);
+        state.new_velocity.y *= -move.rebound;
+    }
+
+    remaining_time -= remaining_time * collision.t;
+    state.last_hit_diretcion = collision.direction;
+    state.last_hit_object    = collision.hit_object;
+    return false;
+}
+
+// Ends a ballistic move after iterations sweeps. If the body ran out of
+// sweeps, it stays at its last contact and keeps the time it had left.
+static void finish_ballistic_move(const BallisticMove& move,
+                                  const ColliderTree& level,
+                                  size_t iterations,
+                                  bool exhausted,
+                                  float remaining_time,
+                                  BallisticMoveResult& state) {
+    state.remaining_time = exhausted ? remaining_time : 0.0f;
+    state.iterations     = static_cast<u32>(iterations);
+    BallisticMoveStats::record(iterations, exhausted);
+    Counters::add(Counter::BOUNCE_ITERATIONS, iterations);
+
+#ifdef VERIFY_COLLISION_OUTCOMES
+    float t = move.delta_time > 0.0f
+                ? 1.0f - state.remaining_time / move.delta_time
+                : 1.0f;
+    CollisionVerifier::submit({ CollisionVerifier::QueryType::BALLISTIC_MOVE,
+                                move.circle,
+                                move.velocity,
+                                move.delta_time,
+                                move.rebound,
+                                state.new_position,
+                                t,
+                                state.last_hit_diretcion },
+                              level);
+#else
+    (void)move;
+    (void)level;
+#endif
+}
+
 const BallisticMoveResult
 get_ballistic_move_result(const Circle& coll,
                           const Vector velocity,
                           const float delta_time,
-                          const std::list<AABB>& level,
+                          const ColliderTree& level,
                           float rebound,
-                          const size_t max_collision_iterations) {
-
-    CollisionData collision;
-    float remaining_time         = delta_time;
-    Circle circle                = coll;
-    Vector updated_velocity      = velocity;
-    Direction last_hit_direction = Direction::NONE;
-    const AABB* last_hit_object  = nullptr;
+                          const size_t max_collision_iterations,
+                          CollisionScratch& scratch) {
+    PROFILE_SCOPE("get_ballistic_move_result");
+    const BallisticMove move  = { coll, velocity, delta_time, rebound };
+    BallisticMoveResult state = {
+        coll.center, velocity, Direction::NONE, nullptr, 0.0f, 0
+    };
+    float remaining_time = delta_time;
 
     for (size_t i = 0; i < max_collision_iterations; ++i) {
-        collision = find_first_collision_moving_circle(
-          circle, updated_velocity * remaining_time, level);
+        CollisionData collision = find_first_collision_moving_circle(
+          Circle { state.new_position, coll.radius },
+          state.new_velocity * remaining_time,
+          level,
+          scratch);
+
+        if (advance_ballistic_move(move, collision, remaining_time, state)) {
+            finish_ballistic_move(
+              move, level, i + 1, false, remaining_time, state);
+            return state;
+        }
+    }
 
-        if (collision.direction == Direction::NONE) {
+    finish_ballistic_move(
+      move, level, max_collision_iterations, true, remaining_time, state);
+    return state;
+}
 
-#ifdef VERIFY_COLLISION_OUTCOMES
-            {
-                Circle final_pos { collision.position, circle.radius };
-                for (const auto& box : level) {
-                    SDL_assert(!test_circle_AABB(final_pos, box));
-                }
-            }
-#endif
+void get_ballistic_move_results(const BallisticMove* moves,
+                                size_t count,
+                                const ColliderTree& level,
+                                BallisticMoveResult* results,
+                                const size_t max_collision_iterations,
+                                CollisionScratch& scratch) {
+    PROFILE_SCOPE("get_ballistic_move_results");
+    scratch.moving.clear();
+    scratch.remaining_time.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        results[i] = { moves[i].circle.center,
+                       moves[i].velocity,
+                       Direction::NONE,
+                       nullptr,
+                       0.0f,
+                       0 };
+        scratch.remaining_time[i] = moves[i].delta_time;
+        scratch.moving.push_back(static_cast<u32>(i));
+    }
 
-            return { collision.position,
-                     updated_velocity,
-                     last_hit_direction,
-                     last_hit_object };
+    for (size_t iteration = 0;
+         iteration < max_collision_iterations && !scratch.moving.empty();
+         ++iteration) {
+        scratch.sweeps.clear();
+        for (const u32 body : scratch.moving) {
+            Circle circle = { results[body].new_position,
+                              moves[body].circle.radius };
+            scratch.sweeps.push_back(
+              { circle,
+                results[body].new_velocity * scratch.remaining_time[body] });
+        }
 
-        } else if (collision.direction == Direction::LEFT
-                   || collision.direction == Direction::RIGHT) {
-            updated_velocity.x *= -rebound;
-        } else {
-            SDL_assert(collision.direction == Direction::UP
-                       || collision.direction == Direction::DOWN);
-            updated_velocity.y *= -rebound;
+        scratch.sweep_results.resize(scratch.sweeps.size());
+        find_first_collisions_moving_circles(scratch.sweeps.data(),
+                                             scratch.sweeps.size(),
+                                             level,
+                                             scratch.sweep_results.data(),
+                                             scratch);
+
+        // Keep the bodies that bounced for the next iteration
+        size_t still_moving = 0;
+        for (size_t i = 0; i < scratch.moving.size(); ++i) {
+            const u32 body = scratch.moving[i];
+            if (advance_ballistic_move(moves[body],
+                                       scratch.sweep_results[i],
+                                       scratch.remaining_time[body],
+                                       results[body])) {
+                finish_ballistic_move(moves[body],
+                                      level,
+                                      iteration + 1,
+                                      false,
+                                      scratch.remaining_time[body],
+                                      results[body]);
+            } else {
+                scratch.moving[still_moving++] = body;
+            }
         }
+        scratch.moving.resize(still_moving);
+    }
 
-        remaining_time -= remaining_time * collision.t;
-        circle.center      = collision.position;
-        last_hit_direction = collision.direction;
-        last_hit_object    = collision.hit_object;
+    for (const u32 body : scratch.moving) {
+        finish_ballistic_move(moves[body],
+                              level,
+                              max_collision_iterations,
+                              true,
+                              scratch.remaining_time[body],
+                              results[body]);
     }
-    SDL_TriggerBreakpoint();
-    return {};
-}
\ No newline at end of file
+}
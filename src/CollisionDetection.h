@@ -1,6 +1,14 @@
 #pragma once
 #include "Collider.h"
-#include <list>
+#include "ColliderTree.h"
+#include "SmallVector.h"
+
+// Debug builds check the outcome of collision queries. Checks against the
+// whole level are sampled and run on a background thread (see
+// CollisionVerifier).
+#ifdef _DEBUG
+#define VERIFY_COLLISION_OUTCOMES
+#endif
 
 enum class Direction { NONE, UP, DOWN, LEFT, RIGHT };
 
@@ -8,6 +16,8 @@ bool test_point_AABB(const Point& p, const AABB& box);
 
 bool test_circle_AABB(const Circle& circle, const AABB& box);
 
+bool test_AABB_AABB(const AABB& a, const AABB& b);
+
 bool intersect_segment_segment(const Segment& seg1,
                                const Segment& seg2,
                                float* t = nullptr,
@@ -19,6 +29,18 @@ bool intersect_segment_circle(const Segment& seg,
                               Point* p       = nullptr,
                               Direction* dir = nullptr);
 
+struct SweptCircle {
+    Circle circle;
+    Vector move;
+};
+
+struct BallisticMove {
+    Circle circle;
+    Vector velocity;
+    float delta_time;
+    float rebound;
+};
+
 struct CollisionData {
     Point position;
     float t;
@@ -26,20 +48,113 @@ struct CollisionData {
     const AABB* hit_object;
 };
 
-const CollisionData find_first_collision_moving_circle(
-  const Circle& circle, const Vector move, const std::list<AABB>& level);
-
 struct BallisticMoveResult {
     glm::vec2 new_position;
     glm::vec2 new_velocity;
     Direction last_hit_diretcion;
     const AABB* last_hit_object;
+
+    // Time that was left when the iteration budget ran out, in the units of
+    // delta_time. The body stops at its last contact, so the caller can carry
+    // this over to the next tick.
+    float remaining_time;
+    u32 iterations;
 };
 
+// Iterations of ballistic moves on the calling thread since its last take().
+// Per thread so worlds that run side by side each get their own numbers.
+struct BallisticMoveStats {
+    u64 moves;
+    u64 iterations;
+    u64 max_iterations;  // Of a single move
+    u64 budget_exhausted;
+
+    static void record(u64 move_iterations, bool exhausted) noexcept;
+
+    // Returns everything recorded since the last call and starts over
+    static BallisticMoveStats take() noexcept;
+
+  private:
+    static inline thread_local u64 total_moves      = 0;
+    static inline thread_local u64 total_iterations = 0;
+    static inline thread_local u64 most_iterations  = 0;
+    static inline thread_local u64 total_exhausted  = 0;
+};
+
+// Reusable memory for collision queries. Small queries fit into the inline
+// storage, bigger ones grow the buffers once and reuse them afterwards, so
+// queries don't allocate in steady state. Pass one in from each thread or use
+// the thread's default.
+struct CollisionScratch {
+    static const size_t INLINE_CAPACITY = 64;
+
+    // Candidate boxes of the current query and their bounds expanded by the
+    // radius of the moving circle, in structure of arrays layout
+    SmallVector<const AABB*, INLINE_CAPACITY> boxes;
+    SmallVector<float, INLINE_CAPACITY> min_x, min_y, max_x, max_y;
+
+    // Batch queries: culling boxes and candidates of all circles in a batch,
+    // and the candidates sorted by circle
+    SmallVector<AABB, ColliderTree::MAX_BATCH_SIZE> areas;
+    SmallVector<ColliderTree::Candidate, INLINE_CAPACITY> batch_candidates;
+    SmallVector<const AABB*, INLINE_CAPACITY> sorted_candidates;
+
+    // Batched ballistic moves: the bodies that are still moving and their
+    // sweeps for the current iteration
+    SmallVector<u32, 16> moving;
+    SmallVector<float, 16> remaining_time;
+    SmallVector<SweptCircle, 16> sweeps;
+    SmallVector<CollisionData, 16> sweep_results;
+
+    static CollisionScratch& for_this_thread();
+};
+
+const CollisionData find_first_collision_moving_circle(
+  const Circle& circle,
+  const Vector move,
+  const ColliderTree& level,
+  CollisionScratch& scratch = CollisionScratch::for_this_thread());
+
+// Same as find_first_collision_moving_circle(), but tests the candidates one
+// at a time without SIMD. The results have to be exactly the same, this is
+// what procAnimBench --verify compares them with.
+const CollisionData find_first_collision_moving_circle_scalar(
+  const Circle& circle,
+  const Vector move,
+  const ColliderTree& level,
+  CollisionScratch& scratch = CollisionScratch::for_this_thread());
+
+// Batch version of find_first_collision_moving_circle(), with one traversal
+// of the level for up to ColliderTree::MAX_BATCH_SIZE circles. Results are the
+// same as querying every circle on its own. The queries don't depend on each
+// other, so a batch can be split up and run on several threads, each with its
+// own scratch.
+void find_first_collisions_moving_circles(
+  const SweptCircle* queries,
+  size_t count,
+  const ColliderTree& level,
+  CollisionData* results,
+  CollisionScratch& scratch = CollisionScratch::for_this_thread());
+
+// Moves the circle for delta_time and bounces it off of everything it hits,
+// with up to max_collision_iterations sweeps. A body that runs out of sweeps
+// stops at its last contact and reports the time it has left.
 const BallisticMoveResult
 get_ballistic_move_result(const Circle& coll,
                           const Vector velocity,
                           const float delta_time,
-                          const std::list<AABB>& level,
+                          const ColliderTree& level,
                           float rebound                         = 1.0f,
-                          const size_t max_collision_iterations = 5);
+                          const size_t max_collision_iterations = 5,
+                          CollisionScratch& scratch =
+                            CollisionScratch::for_this_thread());
+
+// Batch version of get_ballistic_move_result(). All bodies that are still
+// moving share one level traversal per bounce.
+void get_ballistic_move_results(
+  const BallisticMove* moves,
+  size_t count,
+  const ColliderTree& level,
+  BallisticMoveResult* results,
+  const size_t max_collision_iterations = 5,
+  CollisionScratch& scratch             = CollisionScratch::for_this_thread());
@@ -0,0 +1,189 @@
+#pragma once
+#include "CollisionVerifier.h"
+#include "ColliderTree.h"
+#include <cstdio>
+
+float CollisionVerifier::SAMPLING_RATE = 0.1f;
+
+static const char* query_type_name(CollisionVerifier::QueryType type) {
+    switch (type) {
+        case CollisionVerifier::QueryType::FIRST_COLLISION:
+            return "find_first_collision_moving_circle";
+        case CollisionVerifier::QueryType::BALLISTIC_MOVE:
+            return "get_ballistic_move_result";
+        default: return "resting position";
+    }
+}
+
+void CollisionVerifier::submit(const Query& query, const ColliderTree& level) {
+    if (SAMPLING_RATE <= 0.0f) { return; }
+
+    // Pick every 1/SAMPLING_RATE-th query. Deterministic, so a failing run
+    // can be repeated.
+    static thread_local float sample_accumulator = 0.0f;
+    sample_accumulator += SAMPLING_RATE;
+    if (sample_accumulator < 1.0f) { return; }
+    sample_accumulator -= 1.0f;
+
+    CollisionVerifier& self = instance();
+    u64 index               = self.submitted++;
+
+    std::unique_lock<std::mutex> lock(self.mutex);
+    if (self.jobs.size() >= MAX_QUEUE_SIZE) {
+        ++self.dropped;
+        return;
+    }
+
+    // Every tree has its own version, and the matches of a batch run each
+    // load their own level, so a copy of the last few trees is kept
+    std::shared_ptr<const LevelSnapshot> snapshot =
+      self.find_snapshot(level.version());
+    if (!snapshot) {
+        // Copying a big level takes a while, don't make the other threads
+        // wait for it
+        lock.unlock();
+        auto new_snapshot     = std::make_shared<LevelSnapshot>();
+        new_snapshot->version = level.version();
+
+        std::vector<const AABB*> boxes;
+        level.find_all(boxes);
+        new_snapshot->boxes.reserve(boxes.size());
+        for (const auto box : boxes) {
+            new_snapshot->boxes.push_back(*box);
+        }
+        lock.lock();
+
+        // Another thread might have copied the same tree in the meantime
+        snapshot = self.find_snapshot(new_snapshot->version);
+        if (!snapshot) {
+            if (self.snapshots.size() >= MAX_SNAPSHOTS) {
+                self.snapshots.erase(self.snapshots.begin());
+            }
+            snapshot = std::move(new_snapshot);
+            self.snapshots.push_back(snapshot);
+        }
+    }
+
+    self.jobs.push_back({ query, index, std::move(snapshot) });
+    if (!self.worker.joinable()) {
+        self.worker = std::thread(&CollisionVerifier::run, &self);
+    }
+    lock.unlock();
+
+    self.jobs_available.notify_one();
+}
+
+std::shared_ptr<const CollisionVerifier::LevelSnapshot>
+CollisionVerifier::find_snapshot(u64 version) {
+    for (size_t i = 0; i < snapshots.size(); ++i) {
+        if (snapshots[i]->version != version) { continue; }
+
+        // Move it to the back, the front is the one that goes first
+        std::shared_ptr<const LevelSnapshot> found = snapshots[i];
+        snapshots.erase(snapshots.begin() + static_cast<ptrdiff_t>(i));
+        snapshots.push_back(found);
+        return found;
+    }
+    return nullptr;
+}
+
+u64 CollisionVerifier::num_verified() noexcept {
+    return instance().verified.load();
+}
+
+u64 CollisionVerifier::num_violations() noexcept {
+    return instance().violations.load();
+}
+
+u64 CollisionVerifier::num_dropped() noexcept {
+    return instance().dropped.load();
+}
+
+CollisionVerifier::~CollisionVerifier() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    jobs_available.notify_one();
+    if (worker.joinable()) { worker.join(); }
+}
+
+CollisionVerifier& CollisionVerifier::instance() {
+    static CollisionVerifier verifier;
+    return verifier;
+}
+
+void CollisionVerifier::run() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobs_available.wait(lock, [this] { return quit || !jobs.empty(); });
+            if (jobs.empty()) { return; }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        verify(job);
+        ++verified;
+    }
+}
+
+void CollisionVerifier::verify(const Job& job) {
+    const Query& q = job.query;
+    Circle final_pos { q.position, q.circle.radius };
+
+    const AABB* overlapping = nullptr;
+    for (const auto& box : job.level->boxes) {
+        if (test_circle_AABB(final_pos, box)) {
+            overlapping = &box;
+            break;
+        }
+    }
+    if (!overlapping) { return; }
+
+    ++violations;
+
+    // Hex floats so the query can be replayed bit for bit
+    printf_s("[COLLISION] Verification of %s #%llu failed (level version "
+             "%llu)\n"
+             "    circle:   center (%a, %a) radius %a\n"
+             "    move:     (%a, %a) delta_time %a rebound %a\n"
+             "    result:   position (%a, %a) t %a direction %d\n"
+             "    overlaps: center (%a, %a) half_ext (%a, %a)\n",
+             query_type_name(q.type),
+             static_cast<unsigned long long>(job.index),
+             static_cast<unsigned long long>(job.level->version),
+             q.circle.center.x,
+             q.circle.center.y,
+             q.circle.radius,
+             q.move.x,
+             q.move.y,
+             q.delta_time,
+             q.rebound,
+             q.position.x,
+             q.position.y,
+             q.t,
+             static_cast<int>(q.direction),
+             overlapping->center.x,
+             overlapping->center.y,
+             overlapping->half_ext.x,
+             overlapping->half_ext.y);
+
+    // Every box the query could have touched, enough to rebuild the level
+    // around it. The circle can't get further than its movement on either
+    // axis, no matter how often it bounces.
+    AABB reachable;
+    reachable.center   = q.circle.center;
+    reachable.half_ext = glm::abs(q.move * q.delta_time)
+                       + Vector(q.circle.radius + 5.0f);
+    for (const auto& box : job.level->boxes) {
+        if (test_AABB_AABB(reachable, box)) {
+            printf_s("    box:      center (%a, %a) half_ext (%a, %a)\n",
+                     box.center.x,
+                     box.center.y,
+                     box.half_ext.x,
+                     box.half_ext.y);
+        }
+    }
+}
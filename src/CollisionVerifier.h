@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Collider.h"
+#include "CollisionDetection.h"
+#include "Types.h"
+
+// Checks the outcome of collision queries against every box of the level on a
+// background thread. Only a sample of the queries is checked and each level is
+// only copied when it changes, so debug builds stay fast on big levels.
+// Violations are printed with everything needed to reproduce them.
+class CollisionVerifier {
+  public:
+    // Fraction of the queries that get verified. 0 turns verification off.
+    static float SAMPLING_RATE;
+
+    enum class QueryType { FIRST_COLLISION, BALLISTIC_MOVE, RESTING };
+
+    struct Query {
+        QueryType type;
+
+        // Inputs. move is the velocity for BALLISTIC_MOVE.
+        Circle circle;
+        Vector move;
+        float delta_time;
+        float rebound;
+
+        // Outputs
+        Point position;
+        float t;
+        Direction direction;
+    };
+
+    // Queues query for verification against level if it is picked by the
+    // sampling. Can be called from any thread.
+    static void submit(const Query& query, const ColliderTree& level);
+
+    static u64 num_verified() noexcept;
+    static u64 num_violations() noexcept;
+    static u64 num_dropped() noexcept;
+
+    ~CollisionVerifier();
+
+  private:
+    static const size_t MAX_QUEUE_SIZE = 4096;
+    static const size_t MAX_SNAPSHOTS  = 8;
+
+    struct LevelSnapshot {
+        u64 version;
+        std::vector<AABB> boxes;
+    };
+
+    struct Job {
+        Query query;
+        u64 index;
+        std::shared_ptr<const LevelSnapshot> level;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable jobs_available;
+    std::deque<Job> jobs;
+    bool quit = false;
+
+    // Copies of the levels that were submitted last, least recently used
+    // first. Each is shared by all jobs queued for it, and outlives being
+    // dropped from here until those are done.
+    std::vector<std::shared_ptr<const LevelSnapshot>> snapshots;
+
+    std::atomic<u64> submitted  = { 0 };
+    std::atomic<u64> verified   = { 0 };
+    std::atomic<u64> violations = { 0 };
+    std::atomic<u64> dropped    = { 0 };
+
+    static CollisionVerifier& instance();
+
+    // Call with mutex locked
+    std::shared_ptr<const LevelSnapshot> find_snapshot(u64 version);
+
+    void run();
+    void verify(const Job& job);
+};
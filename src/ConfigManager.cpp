@@ -6,7 +6,11 @@
 #include <imgui/imgui.h>
 #include <glm/gtc/type_ptr.hpp>
 
-void ConfigManager::init(GameConfig& game_config, Renderer& renderer) {
+void ConfigManager::init(GameConfig& game_config,
+                         Renderer& renderer,
+                         WorldConfig& world_config) {
+    init_simulation(world_config);
+
     property_map items;
 
     // GameConfig
@@ -14,10 +18,15 @@ void ConfigManager::init(GameConfig& game_config, Renderer& renderer) {
     items.emplace("speed", &game_config.speed);
     items.emplace("use_const_delta_time", &game_config.use_const_delta_time);
     items.emplace("step_mode", &game_config.step_mode);
+    items.emplace("max_fps", &game_config.max_fps);
+    items.emplace("present_mode", &game_config.present_mode);
+    items.emplace("jit_margin_ms", &game_config.jit_margin_ms);
+    items.emplace("tick_rate", &game_config.tick_rate);
+    items.emplace("max_ticks_per_frame", &game_config.max_ticks_per_frame);
+    items.emplace("interpolate", &game_config.interpolate);
+    items.emplace("loopback_rtt", &game_config.loopback_rtt);
     items.emplace("hit_screen_shake_intensity",
                   &game_config.hit_screen_shake_intensity);
-    items.emplace("hit_screen_shake_duration",
-                  &game_config.hit_screen_shake_duration);
     items.emplace("hit_screen_shake_speed",
                   &game_config.hit_screen_shake_speed);
     objects.emplace("GameConfig", std::move(items));
@@ -35,44 +44,63 @@ void ConfigManager::init(GameConfig& game_config, Renderer& renderer) {
     items.emplace("draw_leg_splines", &renderer.draw_leg_splines);
     items.emplace("draw_weapon_trails", &renderer.draw_weapon_trails);
     objects.emplace("Renderer", std::move(items));
+}
+
+void ConfigManager::init_simulation(WorldConfig& world_config) {
+    PlayerConfig& player = world_config.player;
+    BallConfig& ball     = world_config.ball;
+
+    property_map items;
 
     // Player
-    items.clear();
-    items.emplace("ground_hover_distance", &Player::GROUND_HOVER_DISTANCE);
-    items.emplace("jump_force", &Player::JUMP_FORCE);
-    items.emplace("double_jump_force", &Player::DOUBLE_JUMP_FORCE);
-    items.emplace("gravity", &Player::GRAVITY);
+    items.emplace("ground_hover_distance", &player.ground_hover_distance);
+    items.emplace("jump_force", &player.jump_force);
+    items.emplace("double_jump_force", &player.double_jump_force);
+    items.emplace("gravity", &player.gravity);
 
-    items.emplace("wall_jump_force", &Player::WALL_JUMP_FORCE);
+    items.emplace("wall_jump_force", &player.wall_jump_force);
     items.emplace("max_wall_jump_coyote_time",
-                  &Player::MAX_WALL_JUMP_COYOTE_TIME);
+                  &player.max_wall_jump_coyote_time);
 
-    items.emplace("wall_slide_speed", &Player::WALL_SLIDE_SPEED);
-    items.emplace("max_wall_slide_speed", &Player::MAX_WALL_SLIDE_SPEED);
+    items.emplace("wall_slide_speed", &player.wall_slide_speed);
+    items.emplace("max_wall_slide_speed", &player.max_wall_slide_speed);
 
-    items.emplace("max_walk_acceleration", &Player::WALK_ACCELERATION);
-    items.emplace("max_walk_velocity", &Player::MAX_WALK_VELOCITY);
+    items.emplace("max_walk_acceleration", &player.walk_acceleration);
+    items.emplace("max_walk_velocity", &player.max_walk_velocity);
 
-    items.emplace("max_air_acceleration", &Player::MAX_AIR_ACCELERATION);
-    items.emplace("max_air_velocity", &Player::MAX_AIR_VELOCITY);
+    items.emplace("max_air_acceleration", &player.max_air_acceleration);
+    items.emplace("max_air_velocity", &player.max_air_velocity);
 
-    items.emplace("hit_speed_multiplier", &Player::HIT_SPEED_MULTIPLIER);
-    items.emplace("hit_cooldown", &Player::MAX_HIT_COOLDOWN);
-    items.emplace("max_hit_trail_angle", &Player::MAX_HIT_TRAIL_ANGLE);
-    items.emplace("max_hit_trail_length", &Player::MAX_HIT_TRAIL_LENGTH);
+    items.emplace("hit_speed_multiplier", &player.hit_speed_multiplier);
+    items.emplace("hit_cooldown", &player.max_hit_cooldown);
+    items.emplace("max_hit_trail_angle", &player.max_hit_trail_angle);
+    items.emplace("max_hit_trail_length", &player.max_hit_trail_length);
     items.emplace("hitstun_duration_multiplier",
-                  &Player::HITSTUN_DURATION_MULTIPLIER);
+                  &player.hitstun_duration_multiplier);
+    items.emplace("max_bounces_per_tick", &player.max_bounces_per_tick);
     objects.emplace("Player", std::move(items));
 
     // Ball
     items.clear();
-    items.emplace("damping_factor", &Ball::REBOUND);
-    items.emplace("radius", &Ball::RADIUS);
-    items.emplace("rolling_friction", &Ball::ROLLING_FRICTION);
-    items.emplace("gravity", &Ball::GRAVITY);
-    items.emplace("rolling_rotation_speed", &Ball::ROLLING_ROTATION_SPEED);
+    items.emplace("damping_factor", &ball.rebound);
+    items.emplace("radius", &ball.radius);
+    items.emplace("rolling_friction", &ball.rolling_friction);
+    items.emplace("gravity", &ball.gravity);
+    items.emplace("rolling_rotation_speed", &ball.rolling_rotation_speed);
+    items.emplace("max_bounces_per_tick", &ball.max_bounces_per_tick);
     objects.emplace("Ball", std::move(items));
 
+    // Collision
+    items.clear();
+    items.emplace("verification_sampling_rate",
+                  &CollisionVerifier::SAMPLING_RATE);
+    objects.emplace("Collision", std::move(items));
+
+    // World
+    items.clear();
+    items.emplace("hit_freeze_duration", &world_config.hit_freeze_duration);
+    objects.emplace("World", std::move(items));
+
     // Gamepad
     items.clear();
     items.emplace("stick_deadzone_in", &Gamepad::STICK_DEADZONE_IN);
@@ -106,7 +134,9 @@ void ConfigManager::load_config(const char* path) {
         }
 
         SDL_assert(current_property);
-        std::visit(ParseVisitor { stream }, (*current_property)[word]);
+        auto property = current_property->find(word);
+        if (property == current_property->end()) { continue; }
+        std::visit(ParseVisitor { stream }, property->second);
     }
 
     file_stream.close();
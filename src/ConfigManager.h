@@ -5,11 +5,18 @@
 #include "Types.h"
 
 struct GameConfig;
+struct WorldConfig;
 class Renderer;
 
 class ConfigManager {
   public:
-    void init(GameConfig& game_config, Renderer& renderer);
+    void init(GameConfig& game_config,
+              Renderer& renderer,
+              WorldConfig& world_config);
+
+    // Only the settings of the simulation, for running it headless. Settings
+    // nobody registered are skipped when loading.
+    void init_simulation(WorldConfig& world_config);
     void load_config(const char* path = nullptr);
     void save_config();
 
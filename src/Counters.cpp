@@ -0,0 +1,146 @@
+#pragma once
+#include "Counters.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <imgui/imgui.h>
+
+static const char* COUNTER_NAMES[NUM_COUNTERS] = {
+    "Swept circle queries",
+    "Candidate boxes tested",
+    "Bounce iterations",
+    "IK solves",
+    "Bone::transform calls",
+    "Draw calls",
+    "Program binds",
+    "Texture binds",
+    "Bytes uploaded",
+    "Heap allocations",
+};
+
+#ifdef COUNT_HEAP_ALLOCATIONS
+// Every allocation through new goes through here, that's what
+// HEAP_ALLOCATIONS counts
+void* operator new(size_t size) {
+    Counters::add(Counter::HEAP_ALLOCATIONS);
+    if (void* memory = std::malloc(size > 0 ? size : 1)) { return memory; }
+    throw std::bad_alloc();
+}
+
+// GCC inlines these into callers of new and can't tell that the memory came
+// from the malloc above
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+Counters& Counters::instance() {
+    static Counters counters;
+    return counters;
+}
+
+Counters::Block& Counters::add_block() noexcept {
+    // The aligned operator new isn't the one that counts, so this doesn't end
+    // up back here
+    void* memory =
+      ::operator new(sizeof(Block), std::align_val_t(alignof(Block)));
+    Block* block = new (memory) Block;
+    for (auto& value : block->values) {
+        value.store(0, std::memory_order_relaxed);
+    }
+
+    block->next = blocks.load(std::memory_order_relaxed);
+    while (!blocks.compare_exchange_weak(
+      block->next, block, std::memory_order_release)) {
+    }
+    thread_block = block;
+    return *block;
+}
+
+u64 Counters::total(Counter counter) noexcept {
+    size_t index = static_cast<size_t>(counter);
+    u64 sum      = 0;
+    Block* block = blocks.load(std::memory_order_acquire);
+    for (; block; block = block->next) {
+        sum += block->values[index].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void Counters::end_frame() {
+    Counters& self = instance();
+    for (size_t i = 0; i < NUM_COUNTERS; ++i) {
+        u64 sum = total(static_cast<Counter>(i));
+        self.history[i][self.history_index] =
+          static_cast<float>(sum - self.last_totals[i]);
+        self.last_totals[i] = sum;
+    }
+    self.history_index = (self.history_index + 1) % HISTORY_SIZE;
+    ++self.num_frames;
+}
+
+void Counters::display_ui_window() {
+    using namespace ImGui;
+    Counters& self = instance();
+
+    SetNextWindowSize(ImVec2(420.0f, 640.0f), ImGuiCond_FirstUseEver);
+    Begin("Counters");
+#ifdef DISABLE_COUNTERS
+    Text("Built with DISABLE_COUNTERS, nothing is counted");
+#endif
+
+    // Frames that were never counted don't go into the average
+    const size_t num_shown = std::min(self.num_frames, HISTORY_SIZE);
+    const size_t newest =
+      (self.history_index + HISTORY_SIZE - 1) % HISTORY_SIZE;
+    const float width = GetContentRegionAvail().x;
+    for (size_t i = 0; i < NUM_COUNTERS; ++i) {
+#ifndef COUNT_HEAP_ALLOCATIONS
+        if (static_cast<Counter>(i) == Counter::HEAP_ALLOCATIONS) {
+            Text("%s: build with COUNT_HEAP_ALLOCATIONS", COUNTER_NAMES[i]);
+            continue;
+        }
+#endif
+        const float* values = self.history[i];
+        float max           = 0.0f;
+        double sum          = 0.0;
+        for (size_t frame = 0; frame < num_shown; ++frame) {
+            float value =
+              values[(newest + HISTORY_SIZE - frame) % HISTORY_SIZE];
+            max = std::max(max, value);
+            sum += value;
+        }
+        float average =
+          num_shown > 0
+            ? static_cast<float>(sum / static_cast<double>(num_shown))
+            : 0.0f;
+
+        char overlay[64];
+        snprintf(overlay,
+                 sizeof(overlay),
+                 "last %.0f  avg %.1f  max %.0f",
+                 values[newest],
+                 average,
+                 max);
+        Text("%s", COUNTER_NAMES[i]);
+        PushID(static_cast<int>(i));
+        PlotLines("",
+                  values,
+                  static_cast<int>(HISTORY_SIZE),
+                  static_cast<int>(self.history_index),
+                  overlay,
+                  0.0f,
+                  max > 0.0f ? max * 1.1f : 1.0f,
+                  ImVec2(width, 40.0f));
+        PopID();
+    }
+
+    End();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include "Types.h"
+
+// Things that are counted, see COUNTER_NAMES in Counters.cpp
+enum class Counter : u32 {
+    SWEPT_QUERIES,
+    CANDIDATE_BOXES,
+    BOUNCE_ITERATIONS,
+    IK_SOLVES,
+    BONE_TRANSFORMS,
+    DRAW_CALLS,
+    PROGRAM_BINDS,
+    TEXTURE_BINDS,
+    UPLOADED_BYTES,
+    HEAP_ALLOCATIONS,
+};
+constexpr size_t NUM_COUNTERS =
+  static_cast<size_t>(Counter::HEAP_ALLOCATIONS) + 1;
+
+// Counts how often things happen in each frame, on any thread. Every thread
+// counts into its own block, so adding is a relaxed load and store without
+// any contention. The blocks are kept in a lock-free list that end_frame()
+// sums up, and are never freed, so nothing counted by a thread that is gone
+// gets lost.
+//
+// Define DISABLE_COUNTERS to compile all counting out, like build_bench.sh
+// does so the benchmarks time the kernels alone. Heap allocations are only
+// counted with COUNT_HEAP_ALLOCATIONS defined, which replaces the global
+// operator new and delete.
+class Counters {
+  public:
+#ifdef DISABLE_COUNTERS
+    static void add(Counter, u64 = 1) noexcept {}
+#else
+    static void add(Counter counter, u64 amount = 1) noexcept {
+        std::atomic<u64>& value =
+          local_block().values[static_cast<size_t>(counter)];
+        value.store(value.load(std::memory_order_relaxed) + amount,
+                    std::memory_order_relaxed);
+    }
+#endif
+
+    // Since the start, over all threads
+    static u64 total(Counter counter) noexcept;
+
+    // Call on the main thread once per frame, turns the totals into the
+    // amounts of the last frame
+    static void end_frame();
+
+    static void display_ui_window();
+
+  private:
+    struct alignas(64) Block {
+        std::atomic<u64> values[NUM_COUNTERS];
+        Block* next;
+    };
+
+    static inline std::atomic<Block*> blocks = { nullptr };
+    static inline thread_local Block* thread_block = nullptr;
+
+    static Block& local_block() noexcept {
+        if (thread_block) { return *thread_block; }
+        return add_block();
+    }
+    static Block& add_block() noexcept;
+
+    // The rest is for the main thread only
+    static constexpr size_t HISTORY_SIZE = 240;
+    u64 last_totals[NUM_COUNTERS]             = {};
+    float history[NUM_COUNTERS][HISTORY_SIZE] = {};
+    size_t history_index                      = 0;
+    size_t num_frames                         = 0;
+
+    static Counters& instance();
+};
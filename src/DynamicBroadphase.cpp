@@ -0,0 +1,85 @@
+#pragma once
+#include "DynamicBroadphase.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <sdl/SDL_assert.h>
+
+u32 DynamicBroadphase::add(u32 group, u32 mask, u32 index, u32 owner) {
+    u32 id = static_cast<u32>(proxies.size());
+    proxies.push_back(
+      { glm::vec2(0.0f), glm::vec2(0.0f), group, mask, index, owner });
+
+    // New proxies start at the end, the next sort moves them into place
+    order.push_back(id);
+    return id;
+}
+
+void DynamicBroadphase::clear() {
+    proxies.clear();
+    order.clear();
+    swap_count = 0;
+}
+
+void DynamicBroadphase::set_bounds(u32 id, const Circle& circle) {
+    SDL_assert(id < proxies.size());
+    proxies[id].min = circle.center - glm::vec2(circle.radius);
+    proxies[id].max = circle.center + glm::vec2(circle.radius);
+}
+
+void DynamicBroadphase::set_bounds(u32 id, const Segment& segment) {
+    SDL_assert(id < proxies.size());
+    proxies[id].min = glm::min(segment.a, segment.b);
+    proxies[id].max = glm::max(segment.a, segment.b);
+}
+
+const DynamicBroadphase::Proxy& DynamicBroadphase::proxy(u32 id) const {
+    SDL_assert(id < proxies.size());
+    return proxies[id];
+}
+
+void DynamicBroadphase::find_pairs(ScratchVector<Pair>& out) {
+    PROFILE_SCOPE("DynamicBroadphase::find_pairs");
+    // Insertion sort, close to linear for last frame's order
+    swap_count = 0;
+    for (size_t i = 1; i < order.size(); ++i) {
+        u32 id        = order[i];
+        float min_x   = proxies[id].min.x;
+        size_t insert = i;
+        while (insert > 0 && proxies[order[insert - 1]].min.x > min_x) {
+            order[insert] = order[insert - 1];
+            --insert;
+            ++swap_count;
+        }
+        order[insert] = id;
+    }
+
+    size_t first_pair = out.size();
+
+    // Sweep: only proxies that start before the current one ends can overlap
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Proxy& a = proxies[order[i]];
+
+        for (size_t j = i + 1; j < order.size(); ++j) {
+            const Proxy& b = proxies[order[j]];
+            if (b.min.x > a.max.x) { break; }
+
+            if (!(a.mask & b.group) || !(b.mask & a.group)) { continue; }
+            if (a.owner != NO_OWNER && a.owner == b.owner) { continue; }
+            if (a.min.y > b.max.y || b.min.y > a.max.y) { continue; }
+
+            u32 id_a = order[i], id_b = order[j];
+            if (id_a > id_b) { std::swap(id_a, id_b); }
+            out.push_back({ id_a, id_b });
+        }
+    }
+
+    std::sort(out.begin() + first_pair,
+              out.end(),
+              [](const Pair& lhs, const Pair& rhs) {
+                  return lhs.a != rhs.a ? lhs.a < rhs.a : lhs.b < rhs.b;
+              });
+}
+
+size_t DynamicBroadphase::last_swap_count() const noexcept {
+    return swap_count;
+}
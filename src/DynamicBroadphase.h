@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include "Collider.h"
+#include "SmallVector.h"
+#include "Types.h"
+#include "Util.h"
+
+// Sweep and prune over everything that moves in a match and hits something
+// else that moves: weapons and balls. Proxies are kept sorted along the x axis
+// between frames, so restoring the order is an insertion sort that does close
+// to no work when things only move a little per frame.
+class DynamicBroadphase {
+  public:
+    static const u32 WEAPON     = BIT(0);
+    static const u32 BALL       = BIT(1);
+    static const u32 PARTY_BALL = BIT(2);
+
+    // Proxies with the same owner never form a pair
+    static const u32 NO_OWNER = UINT32_MAX;
+
+    struct Proxy {
+        glm::vec2 min, max;
+        u32 group;    // One of the constants above
+        u32 mask;     // Groups this proxy forms pairs with
+        u32 index;    // Index of the object in its own array, e.g. the player
+        u32 owner;
+    };
+
+    // Proxy ids, a < b
+    struct Pair {
+        u32 a, b;
+    };
+
+    u32 add(u32 group, u32 mask, u32 index, u32 owner = NO_OWNER);
+    // Removes all proxies, ids start at 0 again
+    void clear();
+
+    void set_bounds(u32 id, const Circle& circle);
+    void set_bounds(u32 id, const Segment& segment);
+
+    const Proxy& proxy(u32 id) const;
+
+    // Restores the order along the x axis and appends all pairs of proxies
+    // with overlapping bounds whose groups and masks match. Pairs are sorted
+    // by their ids so they come out in the same order no matter where
+    // everything is.
+    void find_pairs(ScratchVector<Pair>& out);
+
+    // Number of swaps the last find_pairs() needed to sort the proxies
+    size_t last_swap_count() const noexcept;
+
+  private:
+    std::vector<Proxy> proxies;
+
+    // Proxy ids sorted by min.x as of the last find_pairs()
+    std::vector<u32> order;
+
+    size_t swap_count = 0;
+};
@@ -10,8 +10,9 @@ void Entity::update_model_matrix() {
 }
 
 void Entity::init(glm::vec2 pos_, glm::vec2 scale_) {
-    position_ = pos_;
-    scale     = scale_;
+    position_           = pos_;
+    last_tick_position_ = pos_;
+    scale               = scale_;
     update_model_matrix();
 }
 
@@ -42,6 +43,16 @@ const glm::mat3& Entity::model_matrix() const {
     return model;
 }
 
+void Entity::begin_tick() {
+    last_tick_position_ = position_;
+}
+
+glm::mat3 Entity::interpolated_model_matrix(float alpha) const {
+    glm::mat3 result = glm::translate(
+      glm::mat3(1.0f), glm::mix(last_tick_position_, position_, alpha));
+    return glm::scale(result, scale);
+}
+
 glm::vec2 Entity::position() const {
     return position_;
 }
\ No newline at end of file
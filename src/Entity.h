@@ -8,6 +8,9 @@ class Entity {
     glm::vec2 scale     = glm::vec2(1.0f);
     glm::mat3 model     = glm::mat3(1.0f);
 
+    // Position before the last simulation tick, for rendering in between ticks
+    glm::vec2 last_tick_position_ = glm::vec2(0.0f);
+
     void update_model_matrix();
     void init(glm::vec2 pos_   = glm::vec2(0.0f),
               glm::vec2 scale_ = glm::vec2(1.0f));
@@ -24,5 +27,11 @@ class Entity {
 
     const glm::mat3& model_matrix() const;
 
+    // Call before every simulation tick
+    void begin_tick();
+
+    // Model matrix at alpha between the last two ticks
+    glm::mat3 interpolated_model_matrix(float alpha) const;
+
     glm::vec2 position() const;
 };
\ No newline at end of file
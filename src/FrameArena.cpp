@@ -0,0 +1,104 @@
+#pragma once
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstdint>
+#include <sdl/SDL_assert.h>
+
+FrameArena& FrameArena::local() {
+    static thread_local FrameArena arena;
+    return arena;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    SDL_assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    if (blocks.empty()) { add_block(size + alignment); }
+
+    for (;;) {
+        Block& block  = blocks[current];
+        uintptr_t top = reinterpret_cast<uintptr_t>(block.data.get()) + offset;
+        size_t start  = offset + ((alignment - top % alignment) % alignment);
+
+        if (start + size <= block.size) {
+            offset = start + size;
+            peak   = std::max(peak, before_current + offset);
+            return block.data.get() + start;
+        }
+
+        // The rest of this block stays unused until the arena is rewound
+        if (current + 1 < blocks.size()
+            && blocks[current + 1].size >= size + alignment) {
+            before_current += block.size;
+            ++current;
+            offset = 0;
+        } else {
+            add_block(size + alignment);
+        }
+    }
+}
+
+void FrameArena::reset() {
+    if (blocks.size() > 1) {
+        size_t total_size = 0;
+        for (const Block& block : blocks) {
+            total_size += block.size;
+        }
+        blocks.clear();
+        add_block(total_size);
+    }
+
+    current        = 0;
+    offset         = 0;
+    before_current = 0;
+}
+
+FrameArena::Marker FrameArena::mark() const noexcept {
+    return { current, offset };
+}
+
+void FrameArena::rewind(Marker marker) {
+    SDL_assert(marker.block < current
+               || (marker.block == current && marker.offset <= offset));
+
+    if (marker.block == 0 && marker.offset == 0) {
+        reset();
+        return;
+    }
+
+    // Blocks are only ever inserted after the current one, the ones before
+    // the marker are still where they were
+    before_current = 0;
+    for (size_t i = 0; i < marker.block; ++i) {
+        before_current += blocks[i].size;
+    }
+    current = marker.block;
+    offset  = marker.offset;
+}
+
+size_t FrameArena::bytes_used() const noexcept {
+    return before_current + offset;
+}
+
+size_t FrameArena::peak_bytes() const noexcept {
+    return peak;
+}
+
+void FrameArena::add_block(size_t min_size) {
+    size_t size = std::max(min_size, MIN_BLOCK_SIZE);
+    Block block = { std::unique_ptr<u8[]>(new u8[size]), size };
+    ++heap_allocations;
+
+    if (blocks.empty()) {
+        blocks.push_back(std::move(block));
+        current        = 0;
+        offset         = 0;
+        before_current = 0;
+        return;
+    }
+
+    before_current += blocks[current].size;
+    blocks.insert(blocks.begin() + static_cast<ptrdiff_t>(current + 1),
+                  std::move(block));
+    ++current;
+    offset = 0;
+}
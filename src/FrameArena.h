@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "Types.h"
+
+// Linear allocator for memory that is only needed for a short while, at most
+// until the end of the frame. Allocating moves an offset forward, freeing
+// happens all at once with reset(), or back to a mark() with rewind(). When a
+// block is full the arena takes another one from the heap, and the next
+// reset() replaces them with a single block big enough for all of them, so an
+// arena that is reset every frame stops allocating once it has seen its
+// biggest frame.
+class FrameArena {
+  public:
+    static constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+    // Number of blocks any arena took from the heap
+    static inline std::atomic<u64> heap_allocations { 0 };
+
+    FrameArena() = default;
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // The calling thread's arena. The main thread's is reset at the end of
+    // every frame. Which worker runs what changes from frame to frame, so code
+    // that can run on the workers only uses their arenas inside a Scope.
+    static FrameArena& local();
+
+    void* allocate(size_t size, size_t alignment);
+
+    template<typename T>
+    T* allocate(size_t count) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void reset();
+
+    struct Marker {
+        size_t block;
+        size_t offset;
+    };
+    Marker mark() const noexcept;
+    // Frees everything allocated since the marker was taken. Rewinding an
+    // arena to empty is the same as reset().
+    void rewind(Marker marker);
+
+    // Rewinds the arena to where it was when the Scope was created
+    class Scope {
+      public:
+        explicit Scope(FrameArena& arena_)
+            : arena(arena_), marker(arena_.mark()) {}
+        ~Scope() { arena.rewind(marker); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+        FrameArena& arena;
+        Marker marker;
+    };
+
+    // Including what was skipped at the end of full blocks
+    size_t bytes_used() const noexcept;
+    // The most that was in use at once
+    size_t peak_bytes() const noexcept;
+
+  private:
+    struct Block {
+        std::unique_ptr<u8[]> data;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+
+    size_t current        = 0;  // The block allocations come from
+    size_t offset         = 0;  // Into the current block
+    size_t before_current = 0;  // Size of all blocks before the current one
+    size_t peak           = 0;
+
+    // Inserts a block after the current one and moves on to it
+    void add_block(size_t min_size);
+};
+
+// Lets standard containers allocate from a FrameArena. Nothing is freed before
+// the arena is reset or rewound, so containers that grow should reserve() what
+// they need up front.
+template<typename T>
+class FrameAllocator {
+  public:
+    typedef T value_type;
+
+    FrameAllocator() noexcept : arena(&FrameArena::local()) {}
+    explicit FrameAllocator(FrameArena& arena_) noexcept : arena(&arena_) {}
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) noexcept
+        : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->allocate<T>(count); }
+    void deallocate(T*, size_t) noexcept {}
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U>& other) const noexcept {
+        return arena == other.arena;
+    }
+    template<typename U>
+    bool operator!=(const FrameAllocator<U>& other) const noexcept {
+        return arena != other.arena;
+    }
+
+  private:
+    template<typename U>
+    friend class FrameAllocator;
+
+    FrameArena* arena;
+};
+
+// A std::vector in the calling thread's FrameArena
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
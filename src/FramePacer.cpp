@@ -0,0 +1,179 @@
+#pragma once
+#include "FramePacer.h"
+#include <thread>
+#include <sdl/SDL.h>
+#include <glm/common.hpp>
+
+void FramePacer::init(SDL_Window* window_, PresentMode mode) {
+    window       = window_;
+    ticks_per_ms = static_cast<double>(SDL_GetPerformanceFrequency()) / 1000.0;
+
+    SDL_DisplayMode display_mode;
+    refresh_rate = 0;
+    if (SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window),
+                                  &display_mode)
+        == 0) {
+        refresh_rate = display_mode.refresh_rate;
+    }
+
+    frame_start      = SDL_GetPerformanceCounter();
+    last_frame_start = frame_start;
+    last_present     = frame_start;
+    wait_ticks       = 0;
+    work_estimate    = 0;
+
+    stats    = {};
+    averages = {};
+    for (float& latency : mode_latency) {
+        latency = 0.0f;
+    }
+    for (float& frame_time : history) {
+        frame_time = 0.0f;
+    }
+    history_index = 0;
+
+    set_mode(mode);
+}
+
+void FramePacer::set_mode(PresentMode mode) {
+    int interval = 0;
+    if (mode == PresentMode::VSYNC || mode == PresentMode::JUST_IN_TIME) {
+        interval = 1;
+    } else if (mode == PresentMode::ADAPTIVE) {
+        interval = -1;
+    }
+
+    if (SDL_GL_SetSwapInterval(interval) < 0) {
+        if (interval == -1 && SDL_GL_SetSwapInterval(1) == 0) {
+            printf("Warning: No adaptive VSync, using VSync instead.\n");
+        } else {
+            printf("Warning: Unable to set swap interval %d! SDL Error: %s\n",
+                   interval,
+                   SDL_GetError());
+        }
+    }
+    current_mode = mode;
+}
+
+PresentMode FramePacer::mode() const { return current_mode; }
+
+void FramePacer::begin_frame(s32 max_fps, float margin_ms) {
+    wait_ticks = 0;
+
+    if (current_mode == PresentMode::JUST_IN_TIME) {
+        // The last swap returned at a blank, the next one is a whole number
+        // of refreshes later. Without a refresh rate max_fps has to do.
+        u64 period = frame_period(refresh_rate);
+        if (period > 0 && max_fps > 0 && max_fps < refresh_rate) {
+            period *= static_cast<u64>(
+              glm::round(static_cast<float>(refresh_rate)
+                         / static_cast<float>(max_fps)));
+        } else if (period == 0) {
+            period = frame_period(max_fps);
+        }
+
+        if (period > 0) {
+            u64 lead = work_estimate
+                     + static_cast<u64>(glm::max(margin_ms, 0.0f)
+                                        * ticks_per_ms);
+            u64 deadline = last_present + period;
+            if (deadline > lead) { wait_ticks = wait_until(deadline - lead); }
+        }
+    }
+
+    last_frame_start = frame_start;
+    frame_start      = SDL_GetPerformanceCounter();
+}
+
+u64 FramePacer::input_sampled() { return SDL_GetPerformanceCounter(); }
+
+void FramePacer::present(s32 max_fps, u64 input_time) {
+    u64 swap_start = SDL_GetPerformanceCounter();
+    SDL_GL_SwapWindow(window);
+    last_present = SDL_GetPerformanceCounter();
+
+    u64 work = swap_start - frame_start;
+    if (work > work_estimate) {
+        work_estimate = work;
+    } else {
+        work_estimate -= (work_estimate - work) / 16;
+    }
+
+    if (current_mode != PresentMode::JUST_IN_TIME) {
+        u64 period = frame_period(max_fps);
+        if (period > 0) { wait_ticks += wait_until(frame_start + period); }
+    }
+
+    stats.frame   = to_ms(frame_start - last_frame_start);
+    stats.work    = to_ms(work);
+    stats.swap    = to_ms(last_present - swap_start);
+    stats.wait    = to_ms(wait_ticks);
+    if (input_time > 0 && input_time <= last_present) {
+        stats.latency = to_ms(last_present - input_time);
+    }
+
+    // About a second at 60 fps
+    const float rate = 0.05f;
+    averages.frame += (stats.frame - averages.frame) * rate;
+    averages.work += (stats.work - averages.work) * rate;
+    averages.swap += (stats.swap - averages.swap) * rate;
+    averages.wait += (stats.wait - averages.wait) * rate;
+
+    if (input_time > 0 && input_time <= last_present) {
+        averages.latency += (stats.latency - averages.latency) * rate;
+
+        float& latency = mode_latency[static_cast<s32>(current_mode)];
+        if (latency == 0.0f) {
+            latency = stats.latency;
+        } else {
+            latency += (stats.latency - latency) * rate;
+        }
+    }
+
+    history[history_index] = stats.frame;
+    history_index          = (history_index + 1) % HISTORY_SIZE;
+}
+
+float FramePacer::last_frame_seconds() const {
+    return to_ms(frame_start - last_frame_start) / 1000.0f;
+}
+
+const FrameStats& FramePacer::last_stats() const { return stats; }
+
+const FrameStats& FramePacer::average_stats() const { return averages; }
+
+float FramePacer::average_latency(PresentMode mode) const {
+    return mode_latency[static_cast<s32>(mode)];
+}
+
+const float* FramePacer::frame_history() const { return history; }
+
+s32 FramePacer::history_offset() const { return history_index; }
+
+u64 FramePacer::frame_period(s32 fps) const {
+    if (fps <= 0) { return 0; }
+    return SDL_GetPerformanceFrequency() / static_cast<u64>(fps);
+}
+
+u64 FramePacer::wait_until(u64 target) const {
+    const u64 start = SDL_GetPerformanceCounter();
+    const u64 spin  = static_cast<u64>(SPIN_MS * ticks_per_ms);
+
+    u64 now = start;
+    while (now < target && target - now > spin) {
+        u64 sleep_ticks = target - now - spin;
+        u32 sleep_ms =
+          static_cast<u32>(static_cast<double>(sleep_ticks) / ticks_per_ms);
+        SDL_Delay(glm::max(sleep_ms, 1u));
+        now = SDL_GetPerformanceCounter();
+    }
+    while (now < target) {
+        std::this_thread::yield();
+        now = SDL_GetPerformanceCounter();
+    }
+    return now - start;
+}
+
+float FramePacer::to_ms(u64 ticks) const {
+    return static_cast<float>(static_cast<double>(ticks) / ticks_per_ms);
+}
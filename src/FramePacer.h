@@ -0,0 +1,98 @@
+#pragma once
+#include "Types.h"
+#include <sdl/SDL_video.h>
+
+// How finished frames get to the screen
+enum class PresentMode : s32 {
+    // Swapping waits for the vertical blank
+    VSYNC = 0,
+    // Like VSYNC, but a late frame is swapped right away instead of waiting
+    // for the next blank. Falls back to VSYNC where the driver can't do it.
+    ADAPTIVE = 1,
+    // Swapping doesn't wait, only the limiter does
+    UNCAPPED = 2,
+    // Like VSYNC, but instead of reading the input right after the last
+    // blank and then waiting for the next one in the swap, the frame sleeps
+    // first and starts as late as its measured work allows. The input is
+    // fresher when the frame is shown.
+    JUST_IN_TIME = 3,
+};
+constexpr s32 NUM_PRESENT_MODES = 4;
+
+// In milliseconds
+struct FrameStats {
+    float frame   = 0.0f;  // From the start of the last frame to this one
+    float work    = 0.0f;  // From the start of the frame until it's swapped
+    float swap    = 0.0f;  // Blocked in SDL_GL_SwapWindow()
+    float wait    = 0.0f;  // Sleeping and spinning for the limiter
+    // From reading the input the shown frame was simulated from until the
+    // swap returned
+    float latency = 0.0f;
+};
+
+// Paces frames with the high resolution performance counter instead of the
+// millisecond ticks. Waits sleep while the deadline is far away and spin for
+// the last bit, since sleeping can overshoot by a millisecond or more.
+class FramePacer {
+  public:
+    // Needs the OpenGL context
+    void init(SDL_Window* window, PresentMode mode);
+    void set_mode(PresentMode mode);
+    PresentMode mode() const;
+
+    // Call first thing in the frame. Just in time, this is where the frame
+    // waits until it has to start to be swapped right before the next blank.
+    // max_fps 0 turns the limiter off, margin_ms is time given to the frame
+    // on top of the longest it took recently.
+    void begin_frame(s32 max_fps, float margin_ms);
+    // Call right after the input was read. Returns the time to hand to
+    // present() in the frame that shows what was simulated from that input.
+    u64 input_sampled();
+    // Swaps the window, then waits for max_fps unless just in time.
+    // input_time is from input_sampled(), or 0 if the frame shows nothing
+    // newly simulated, which leaves the latency as it was.
+    void present(s32 max_fps, u64 input_time);
+
+    // Between the starts of the last two frames
+    float last_frame_seconds() const;
+
+    const FrameStats& last_stats() const;
+    // Moving averages over roughly the last second
+    const FrameStats& average_stats() const;
+    // Average latency while each mode was used, 0 for modes that weren't
+    float average_latency(PresentMode mode) const;
+
+    // Frame times of the last HISTORY_SIZE frames, for plotting. The oldest
+    // one is at history_offset().
+    static const s32 HISTORY_SIZE = 120;
+    const float* frame_history() const;
+    s32 history_offset() const;
+
+  private:
+    // Closer to the deadline than this, waits spin instead of sleeping
+    static constexpr double SPIN_MS = 2.0;
+
+    SDL_Window* window;
+    PresentMode current_mode;
+    double ticks_per_ms;
+    s32 refresh_rate;  // 0 if the display doesn't say
+
+    u64 frame_start, last_frame_start;
+    u64 last_present;
+    u64 wait_ticks;
+
+    // How long frames take from their start until they are swapped. Goes up
+    // right away and slowly back down.
+    u64 work_estimate;
+
+    FrameStats stats, averages;
+    float mode_latency[NUM_PRESENT_MODES];
+
+    float history[HISTORY_SIZE];
+    s32 history_index;
+
+    u64 frame_period(s32 fps) const;
+    // Returns how long it waited
+    u64 wait_until(u64 target) const;
+    float to_ms(u64 ticks) const;
+};
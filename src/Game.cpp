@@ -11,11 +11,14 @@
 #include <glm/gtx/matrix_transform_2d.hpp>
 
 void Game::init() {
+    Profiler::set_thread_name("Main");
+    Profiler::set_enabled(true);
+
     // Initialize SDL
     SDL_assert_always(SDL_Init(SDL_INIT_EVERYTHING) == 0);
     SDL_assert_always(IMG_Init(IMG_INIT_PNG) != 0);
 
-    config_loader.init(game_config, renderer);
+    config_loader.init(game_config, renderer, world.config);
     config_loader.load_config("../assets/config.ini");
 
     glm::ivec2 window_size = static_cast<glm::ivec2>(renderer.window_size());
@@ -53,9 +56,6 @@ void Game::init() {
     }
 
     // OpenGL configuration
-    if (SDL_GL_SetSwapInterval(1) < 0) {
-        printf("Warning: Unable to set VSync! SDL Error: %s\n", SDL_GetError());
-    }
     glViewport(0, 0, window_size.x, window_size.y);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -100,45 +100,86 @@ void Game::init() {
 
     background.init("../assets/background.png");
 
-    // Level
-    level.load_from_file("../assets/default.level");
-    level_editor.init(&level);
-
-    // Player
-    glm::vec3 position = { 960.0f, 271.0f, 0.0f };
-    players[0].init(position,
-                    glm::vec3(100.0f, 100.0f, 1.0f),
-                    "../assets/playerTexture.png",
-                    "../assets/guy.fbx",
-                    &gamepads[0],
-                    level.colliders);
-
-    position.x += 50.0f;
-    players[1].init(position,
-                    glm::vec3(100.0f, 100.0f, 1.0f),
-                    "../assets/playerTexture.png",
-                    "../assets/guy.fbx",
-                    &gamepads[1],
-                    level.colliders);
-
-    // Ball
-    ball.init(renderer.camera_center(), "../assets/ball.png");
-
-    frame_start = SDL_GetTicks();
-    is_running  = true;
+    // The main thread and the simulation thread are busy already
+    u32 hardware_threads = std::thread::hardware_concurrency();
+    job_pool = std::make_unique<ThreadPool>(
+      hardware_threads > 3 ? hardware_threads - 2 : 1, "Jobs");
+
+    world_gamepads.resize(NUM_PLAYERS);
+    world.init(world_gamepads.data(), renderer.camera_center());
+    world.jobs = job_pool.get();
+    level_editor.init(&world.level);
+
+    for (auto& player_splines : leg_splines) {
+        for (auto& spline : player_splines) {
+            spline.init(nullptr);
+        }
+    }
+    for (auto& state : render_states) {
+        state.clear_events();
+        state.players.resize(world.players.size());
+        write_render_state(state, 1.0f);
+    }
+
+    TaskGraph::TaskId ticks = frame_graph.add([this]() {
+        render_states[1 - front_render_state].clear_events();
+        for (u32 n = 0; n < frame.num_ticks; ++n) {
+            tick(frame.delta_time);
+        }
+    });
+    frame_graph.add(
+      [this]() {
+          PROFILE_SCOPE("Player render states");
+          RenderState& state = render_states[1 - front_render_state];
+          parallel_for(job_pool.get(), world.players.size(), 1, [&](size_t i) {
+              world.players[i].write_render_state(state.players[i],
+                                                  frame.alpha);
+          });
+      },
+      { ticks });
+    frame_graph.add(
+      [this]() {
+          PROFILE_SCOPE("Ball render states");
+          RenderState& state = render_states[1 - front_render_state];
+          world.ball.write_render_state(state.ball, frame.alpha);
+          world.party_balls.write_render_state(state.party_balls,
+                                               frame.alpha);
+      },
+      { ticks });
+
+    frame_pacer.init(window, present_mode());
+    is_running = true;
 };
 
 void Game::run() {
-    last_frame_start = frame_start;
-    frame_start      = SDL_GetTicks();
+    Profiler::begin_frame();
+    PROFILE_SCOPE("Game::run");
+
+    if (present_mode() != frame_pacer.mode()) {
+        frame_pacer.set_mode(present_mode());
+    }
+    {
+        PROFILE_SCOPE("Wait for frame");
+        frame_pacer.begin_frame(game_config.max_fps,
+                                game_config.jit_margin_ms);
+    }
+
+    // The World belongs to the simulation thread until the last frame's ticks
+    // are done
+    {
+        PROFILE_SCOPE("Wait for simulation");
+        finish_simulation();
+    }
 
     SDL_PumpEvents();
 
     // Get inputs
     mouse_keyboard_input.update();
 
-    for (auto& pad : gamepads) {
-        pad.update();
+    for (size_t i = 0; i < NUM_PLAYERS; ++i) {
+        gamepads[i].update();
+        polled_input[i] =
+          gamepads[i].sdl_ptr ? gamepads[i].state() : GamepadState {};
     }
 
     {  // Process events
@@ -175,6 +216,7 @@ void Game::run() {
             }
         }
     }
+    const u64 input_time = frame_pacer.input_sampled();
 
     // Handle general keyboard inputs
     if (mouse_keyboard_input.key_down(Keybinds::DRAW_BONES)) {
@@ -192,6 +234,12 @@ void Game::run() {
     if (mouse_keyboard_input.key_down(Keybinds::SPEED_DOWN)) {
         game_config.speed *= 2.0f;
     }
+    if (mouse_keyboard_input.key_down(Keybinds::SAVE_STATE)) {
+        pending_commands |= ReplayCommand::SAVE_STATE;
+    }
+    if (mouse_keyboard_input.key_down(Keybinds::LOAD_STATE)) {
+        pending_commands |= ReplayCommand::LOAD_STATE;
+    }
     if (mouse_keyboard_input.key_down(Keybinds::QUIT)) {
         if (game_mode == PLAY) {
             is_running = false;
@@ -226,31 +274,71 @@ void Game::run() {
 
     update_gui();
 
-    float last_frame_duration =
-      static_cast<float>(frame_start - last_frame_start);
-    float frame_delay = static_cast<float>(game_config.frame_delay);
+    // Simulation time is in 60 Hz frames
+    const float tick_delta_time = 60.0f / game_config.tick_rate;
+
+    // How far the rendered frame is between the last two ticks
+    float alpha      = 1.0f;
+    ticks_last_frame = 0;
 
     // Update components based on the current game_mode
     if (game_mode == PLAY) {
-
-        float delta_time;
-        if (game_config.use_const_delta_time || game_config.step_mode) {
-            delta_time = game_config.speed;
+        // The LevelEditor works on the unbaked level
+        if (!world.level.is_baked()) { world.level.bake(); }
+
+        bool plain_match = world.is_match() && !replay_writer.is_open()
+                        && !replay_reader.is_open();
+        float loopback_rtt =
+          plain_match ? glm::max(game_config.loopback_rtt, 0.0f) : 0.0f;
+        if (loopback_rtt != loopback.rtt) { start_loopback(loopback_rtt); }
+
+        if (game_config.step_mode) {
+            if (mouse_keyboard_input.key_down(Keybinds::NEXT_STEP)
+                || mouse_keyboard_input.key(Keybinds::HOLD_TO_STEP)) {
+                ticks_last_frame = 1;
+            }
+            tick_accumulator = 0.0f;
         } else {
-            delta_time = last_frame_duration / frame_delay * game_config.speed;
-        }
+            // Constant delta time pretends every frame took exactly as long
+            // as max_fps asks for
+            float new_ticks;
+            if (game_config.use_const_delta_time) {
+                s32 fps   = glm::max(game_config.max_fps, 1);
+                new_ticks = game_config.tick_rate / static_cast<float>(fps);
+            } else {
+                new_ticks =
+                  frame_pacer.last_frame_seconds() * game_config.tick_rate;
+            }
+            tick_accumulator += new_ticks * game_config.speed;
+
+            const float max_ticks =
+              static_cast<float>(glm::max(game_config.max_ticks_per_frame, 1));
+            if (tick_accumulator >= max_ticks + 1.0f) {
+                float due_ticks = glm::floor(tick_accumulator);
+                dropped_ticks += static_cast<u64>(due_ticks - max_ticks);
+                tick_accumulator -= due_ticks - max_ticks;
+            }
 
-        if (!game_config.step_mode
-            || (game_config.step_mode
-                && (mouse_keyboard_input.key_down(Keybinds::NEXT_STEP)
-                    || mouse_keyboard_input.key(Keybinds::HOLD_TO_STEP)))) {
-            simulate_world(delta_time);
+            while (tick_accumulator >= 1.0f) {
+                tick_accumulator -= 1.0f;
+                ++ticks_last_frame;
+            }
+
+            if (game_config.interpolate) { alpha = tick_accumulator; }
         }
 
+        // The ticks run while this frame draws what the last frame simulated
+        u32 num_ticks = ticks_last_frame;
+        render_states[1 - front_render_state].input_time = input_time;
+        simulation_thread.submit([this, num_ticks, tick_delta_time, alpha]() {
+            simulate_frame(num_ticks, tick_delta_time, alpha);
+        });
+        simulation_running = true;
+
     } else if (game_mode == SPLINE_EDITOR) {
-        if (!players[0].animator.spline_editor->update(mouse_keyboard_input)) {
-            game_mode = PLAY;
-        }
+        SplineEditor* spline_editor =
+          world.players[0].animator.spline_editor.get();
+        if (!spline_editor->update(mouse_keyboard_input)) { game_mode = PLAY; }
     } else if (game_mode == LEVEL_EDITOR) {
         if (!level_editor.update(renderer, mouse_keyboard_input)) {
             game_mode = PLAY;
@@ -263,101 +351,217 @@ void Game::run() {
 
     background.render(renderer, renderer.camera_center());
 
-    level.render(renderer);
+    world.level.render(renderer);
 
-    // Ball
-    ball.render(renderer);
+    render_world(render_states[front_render_state]);
 
-    // Players
-    std::array<glm::mat3, RiggedShader::NUMBER_OF_BONES>
-      bone_transforms[NUM_PLAYERS];
-    if (renderer.draw_limbs || renderer.draw_wireframes) {
-        for (size_t n_player = 0; n_player < NUM_PLAYERS; ++n_player) {
-            const auto& player = players[n_player];
+#ifdef _DEBUG
+    // Debug data
+    if (collision_point.collision_happened) {
+        renderer.debug_shader.set_color(Color::LIGHT_BLUE);
+        glPointSize(2.0f);
+        collision_point.vao.draw(GL_POINTS);
+    }
+#endif
 
-            SDL_assert(player.rigged_mesh.bones.size()
-                       <= RiggedShader::NUMBER_OF_BONES);
+    if (game_mode == SPLINE_EDITOR) {
+        world.players[0].animator.spline_editor->render(renderer, true);
+    } else if (game_mode == LEVEL_EDITOR) {
+        level_editor.render(renderer);
+    }
 
-            for (size_t n_bone = 0; n_bone < player.rigged_mesh.bones.size();
-                 ++n_bone) {
-                bone_transforms[n_player][n_bone] =
-                  player.rigged_mesh.bones[n_bone].transform();
-            }
+    {
+        PROFILE_SCOPE("Render ImGui");
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
+
+    {
+        PROFILE_SCOPE("Present");
+        frame_pacer.present(game_config.max_fps, shown_input_time);
+    }
+
+    Counters::end_frame();
+    FrameArena::local().reset();
+}
+
+void Game::tick(float delta_time) {
+    PROFILE_SCOPE("Game::tick");
+    // A replay that is playing replaces the gamepads and keyboard commands
+    GamepadState inputs[NUM_PLAYERS];
+    u32 commands = 0;
+    if (replay_reader.is_open()) {
+        if (replay_reader.next_tick(inputs, commands)) {
+            delta_time = replay_reader.header().delta_time;
+        } else {
+            printf("[REPLAY] Played back %llu ticks\n",
+                   static_cast<unsigned long long>(replay_reader.ticks()));
+            replay_reader.close();
         }
     }
+    if (!replay_reader.is_open()) {
+        for (size_t i = 0; i < NUM_PLAYERS; ++i) {
+            inputs[i] = polled_input[i];
+        }
+        commands = pending_commands;
+    }
+    pending_commands = 0;
+
+    if (commands & ReplayCommand::SAVE_STATE) { save_state(); }
+    if (commands & ReplayCommand::LOAD_STATE) { load_state(); }
+
+    if (loopback.rtt > 0.0f) {
+        if (!tick_loopback(inputs, delta_time)) { return; }
+    } else {
+        for (size_t i = 0; i < NUM_PLAYERS; ++i) {
+            world_gamepads[i].set_state(inputs[i]);
+        }
+        for (size_t i = 0; i < bots.size(); ++i) {
+            world_gamepads[NUM_PLAYERS + i].set_state(bots[i].next_input());
+        }
+        world.begin_tick();
+        world.simulate(delta_time, world_events);
+    }
+
+    if (replay_writer.is_open()) { replay_writer.add_tick(inputs, commands); }
+
+    render_states[1 - front_render_state].add_events(world_events, delta_time);
+}
+
+void Game::simulate_frame(u32 num_ticks, float delta_time, float alpha) {
+    PROFILE_SCOPE("Game::simulate_frame");
+    frame.num_ticks  = num_ticks;
+    frame.delta_time = delta_time;
+    frame.alpha      = alpha;
+    frame_graph.run(job_pool.get());
+}
+
+void Game::finish_simulation() {
+    simulation_thread.wait();
+    shown_input_time = 0;
+    if (!simulation_running) { return; }
+    simulation_running = false;
+
+    front_render_state       = 1 - front_render_state;
+    const RenderState& state = render_states[front_render_state];
+    shown_input_time         = state.input_time;
+
+    for (const Sound sound : state.sounds) {
+        audio_manager.play(sound);
+    }
+
+    for (const auto& hit : state.hits) {
+        renderer.shake_screen(
+          game_config.hit_screen_shake_intensity * hit.strength,
+          hit.duration,
+          game_config.hit_screen_shake_speed);
+    }
+
+    if (state.weapons_collided) {
+        printf("Weapons colliding at pos: %.2f, %.2f\n",
+               state.weapon_collision_point.x,
+               state.weapon_collision_point.y);
+    }
+
+#ifdef _DEBUG
+    collision_point.collision_happened = state.weapons_collided;
+    if (state.weapons_collided) {
+        std::array<DebugShader::Vertex, 1> shader_vertex = {
+            state.weapon_collision_point
+        };
+        collision_point.vao.update_vertex_data(shader_vertex);
+    }
+#endif
+
+    renderer.update(state.delta_time);
+}
+
+void Game::write_render_state(RenderState& state, float alpha) const {
+    for (size_t n_player = 0; n_player < world.players.size(); ++n_player) {
+        world.players[n_player].write_render_state(state.players[n_player],
+                                                   alpha);
+    }
+    world.ball.write_render_state(state.ball, alpha);
+    world.party_balls.write_render_state(state.party_balls, alpha);
+}
+
+void Game::render_world(const RenderState& state) {
+    PROFILE_SCOPE("Game::render_world");
+    const PlayerModel& player_model = world.player_model;
+
+    {
+        PROFILE_SCOPE("Render balls");
+        world.ball.render(renderer, state.ball);
+        world.party_balls.render(renderer, state.party_balls);
+    }
 
     if (renderer.draw_limbs) {
+        PROFILE_SCOPE("Render limbs");
         renderer.rigged_shader.use();
-        for (size_t n_player = 0; n_player < NUM_PLAYERS; ++n_player) {
-            const auto& player = players[n_player];
-
-            renderer.rigged_shader.set_model(&player.model);
+        for (const auto& player_state : state.players) {
+            renderer.rigged_shader.set_model(&player_state.model);
             renderer.rigged_shader.set_bone_transforms(
-              bone_transforms[n_player].data());
-            renderer.rigged_shader.set_texture(player.texture);
+              player_state.bone_transforms.data());
+            renderer.rigged_shader.set_texture(player_model.texture);
 
-            player.rigged_mesh.vao.draw(GL_TRIANGLES);
+            player_model.rigged_mesh.vao.draw(GL_TRIANGLES);
         }
     }
 
     if (renderer.draw_body) {
+        PROFILE_SCOPE("Render bodies");
         renderer.textured_shader.use();
-        for (size_t n_player = 0; n_player < NUM_PLAYERS; ++n_player) {
-            const auto& player = players[n_player];
-
-            glm::mat3 flipped_model;
-            if (player.is_facing_right()) {
-                flipped_model = glm::scale(player.model, vec2(-1.0f, 1.0f));
-            } else {
-                flipped_model = player.model;
+        for (const auto& player_state : state.players) {
+            glm::mat3 flipped_model = player_state.model;
+            if (player_state.facing_right) {
+                flipped_model = glm::scale(flipped_model, vec2(-1.0f, 1.0f));
             }
 
             renderer.textured_shader.set_model(&flipped_model);
-            renderer.textured_shader.set_texture(player.texture);
+            renderer.textured_shader.set_texture(player_model.texture);
 
-            player.body_mesh.vao.draw(GL_TRIANGLES);
+            player_model.body_mesh.vao.draw(GL_TRIANGLES);
         }
     }
 
     if (renderer.draw_wireframes) {
+        PROFILE_SCOPE("Render wireframes");
         renderer.rigged_debug_shader.use();
-        for (size_t n_player = 0; n_player < NUM_PLAYERS; ++n_player) {
-            const auto& player = players[n_player];
-
-            renderer.rigged_debug_shader.set_model(&player.model);
+        for (const auto& player_state : state.players) {
+            renderer.rigged_debug_shader.set_model(&player_state.model);
             renderer.rigged_debug_shader.set_color(Color::BLUE);
             renderer.rigged_debug_shader.set_bone_transforms(
-              bone_transforms[n_player].data());
+              player_state.bone_transforms.data());
 
             glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            player.rigged_mesh.vao.draw(GL_TRIANGLES);
+            player_model.rigged_mesh.vao.draw(GL_TRIANGLES);
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         }
     }
 
     if (renderer.draw_bones) {
+        PROFILE_SCOPE("Render bones");
         renderer.bone_shader.use();
-        for (size_t n_player = 0; n_player < NUM_PLAYERS; ++n_player) {
-            const auto& player = players[n_player];
-
-            renderer.bone_shader.set_model(&player.model);
+        for (const auto& player_state : state.players) {
+            renderer.bone_shader.set_model(&player_state.model);
             renderer.bone_shader.set_color(Color::RED);
             renderer.bone_shader.set_bone_transforms(
-              bone_transforms[n_player].data());
+              player_state.bone_transforms.data());
 
             glLineWidth(2.0f);
-            player.rigged_mesh.bones_vao.draw(GL_LINES);
+            player_model.rigged_mesh.bones_vao.draw(GL_LINES);
             glPointSize(1.0f);
-            player.rigged_mesh.bones_vao.draw(GL_POINTS);
+            player_model.rigged_mesh.bones_vao.draw(GL_POINTS);
         }
     }
 
     if (renderer.draw_colliders) {
+        PROFILE_SCOPE("Render colliders");
         renderer.debug_shader.use();
-        for (const auto& player : players) {
+        for (const auto& player_state : state.players) {
             renderer.debug_shader.set_color(Color::ORANGE);
 
-            const auto collider = player.body_collider();
+            const auto& collider = player_state.body_collider;
             glm::mat3 model = glm::translate(glm::mat3(1.0f), collider.center);
             model           = glm::scale(model, glm::vec2(collider.radius));
 
@@ -367,6 +571,7 @@ void Game::run() {
     }
 
     if (renderer.draw_leg_splines) {
+        PROFILE_SCOPE("Render leg splines");
         renderer.debug_shader.use();
         renderer.debug_shader.set_color(Color::GREEN);
 
@@ -375,279 +580,157 @@ void Game::run() {
         glm::mat3 model(1.0f);
         renderer.debug_shader.set_model(&model);
 
-        for (const auto& player : players) {
-            player.animator.limbs[Animator::LEFT_LEG].spline.render(renderer,
-                                                                    true);
-            player.animator.limbs[Animator::RIGHT_LEG].spline.render(renderer,
-                                                                     true);
+        for (size_t n_player = 0; n_player < NUM_PLAYERS; ++n_player) {
+            for (size_t leg = 0; leg < 2; ++leg) {
+                Spline& spline = leg_splines[n_player][leg];
+                spline.set_points(
+                  state.players[n_player].leg_spline_points[leg]);
+                spline.render(renderer, true);
+            }
         }
     }
 
     if (renderer.draw_weapon_trails) {
+        PROFILE_SCOPE("Render weapon trails");
         renderer.trail_shader.use();
 
-        for (auto& player : players) {
-            renderer.trail_shader.set_model(&player.model_matrix());
-            player.weapon_trail.render();
-        }
-    }
-
-#ifdef _DEBUG
-    // Debug data
-    if (collision_point.collision_happened) {
-        renderer.debug_shader.set_color(Color::LIGHT_BLUE);
-        glPointSize(2.0f);
-        collision_point.vao.draw(GL_POINTS);
-    }
-#endif
-
-    if (game_mode == SPLINE_EDITOR) {
-        players[0].animator.spline_editor->render(renderer, true);
-    } else if (game_mode == LEVEL_EDITOR) {
-        level_editor.render(renderer);
-    }
-
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        for (size_t n_player = 0; n_player < state.players.size(); ++n_player) {
+            const auto& player_state = state.players[n_player];
 
-    SDL_GL_SwapWindow(window);
-
-    // Wait for next frame
-    u32 last_frame_time = SDL_GetTicks() - frame_start;
-    if (game_config.frame_delay > last_frame_time) {
-        SDL_Delay(game_config.frame_delay - last_frame_time);
+            renderer.trail_shader.set_model(&player_state.model);
+            world.players[n_player].weapon_trail.render(
+              player_state.trail_vertices.data(),
+              player_state.num_trail_vertices);
+        }
     }
 }
 
-void Game::simulate_world(float delta_time) {
-
-    for (auto& player : players) {
-        if (player.freeze_duration > 0.0f) {
-            player.freeze_duration -= delta_time;
-            continue;
-        }
-
-        player.update(delta_time, level.colliders);
-
-        //              Resolve collisions              //
-        Point new_player_position;
-        vec2 new_player_velocity = player.velocity;
-
-        // Body collisions with level
-        if (player.state == Player::HITSTUN) {
-            BallisticMoveResult result =
-              get_ballistic_move_result(player.body_collider(),
-                                        player.velocity,
-                                        delta_time,
-                                        level.colliders);
-
-            new_player_position = result.new_position;
-            new_player_velocity = result.new_velocity;
-
-            if (result.last_hit_diretcion != Direction::NONE) {
-                audio_manager.play(Sound::WALL_BOUNCE);
-            }
-
-        } else {  // player.state != Player::HITSTUN
-            vec2 player_move              = player.velocity * delta_time;
-            CollisionData first_collision = find_first_collision_moving_circle(
-              player.body_collider(), player_move, level.colliders);
-
-            if (first_collision.direction == Direction::NONE) {
-                new_player_position = player.position() + player_move;
-
-            } else {
-                vec2 remaining_player_move;
-                if (first_collision.direction == Direction::DOWN
-                    || first_collision.direction == Direction::UP) {
-
-                    new_player_velocity.y = 0.0f;
-
-                    remaining_player_move =
-                      vec2(player_move.x * (1.0f - first_collision.t), 0.0f);
-
-                } else {
-                    SDL_assert(first_collision.direction == Direction::LEFT
-                               || first_collision.direction
-                                    == Direction::RIGHT);
-                    new_player_velocity.x = 0.0f;
+void Game::start_loopback(float rtt) {
+    loopback.rtt = rtt;
+    if (loopback.rtt == 0.0f) { return; }
 
-                    remaining_player_move =
-                      vec2(0.0f, player_move.y - (1.0f - first_collision.t));
-
-                    if (!player.grounded) {
-                        player.wall_direction = first_collision.direction;
-                        player.state          = Player::WALL_CLING;
-                        player.velocity.y     = 0.0f;
-                    }
-                }
+    LoopbackLink::Settings link_settings;
+    link_settings.latency = loopback.rtt * 0.5f;
+    loopback.link.init(link_settings);
+    loopback.session.init(&world, world_gamepads.data(), 0);
+    loopback.now          = 0.0;
+    loopback.remote_ticks = 0;
+}
 
-                Circle body_collider = player.body_collider();
-                body_collider.center = first_collision.position;
-
-                CollisionData second_collision =
-                  find_first_collision_moving_circle(
-                    body_collider, remaining_player_move, level.colliders);
-
-                SDL_assert(second_collision.direction
-                           != first_collision.direction);
-
-                if (second_collision.direction != Direction::NONE) {
-                    // The player hit a corner, can't move any further
-                    new_player_velocity = vec2(0.0f);
-                } else if (second_collision.direction == Direction::LEFT
-                           || second_collision.direction == Direction::RIGHT) {
-                    if (!player.grounded) {
-                        player.wall_direction = second_collision.direction;
-                        player.state          = Player::WALL_CLING;
-                        SDL_assert(player.velocity.y == 0.0f);
-                    }
-                }
+bool Game::tick_loopback(const GamepadState inputs[NUM_PLAYERS],
+                         float delta_time) {
+    // The second player's input for this tick leaves the "remote machine"
+    InputPacket packet;
+    packet.first_tick    = loopback.remote_ticks++;
+    packet.num_inputs    = 1;
+    packet.ack_tick      = 0;
+    packet.checksum_tick = InputPacket::NO_CHECKSUM;
+    packet.checksum      = 0;
+    packet.inputs[0]     = inputs[1];
+    loopback.link.send(1, packet, loopback.now);
 
-                new_player_position = second_collision.position;
-            }
-        }
+    while (loopback.link.receive(0, loopback.now, packet)) {
+        loopback.session.add_remote_inputs(packet);
+    }
+    loopback.now += 1000.0 / static_cast<double>(game_config.tick_rate);
 
-        if (player.state != Player::HITSTUN
-            && player.state != Player::WALL_CLING) {
-            // Keep player above ground, check grounded status
-            auto ground_under_player =
-              level.find_ground_under(new_player_position);
-            if (!ground_under_player
-                || new_player_position.y - ground_under_player->max(1)
-                     > Player::GROUND_HOVER_DISTANCE
-                         + 2.0f /* small tolerance */) {
+    return loopback.session.advance(inputs[0], delta_time, world_events);
+}
 
-                player.grounded = false;
-                player.state    = Player::FALLING;
+void Game::save_state() {
+    if (!world.is_match()) { return; }
+    world.save(saved_state.world);
+    renderer.save_screen_shake(saved_state.screen_shake);
+    saved_state.valid = true;
+}
 
-            } else {
-                new_player_velocity.y = std::max(new_player_velocity.y, 0.0f);
-                new_player_position.y =
-                  ground_under_player->max(1) + Player::GROUND_HOVER_DISTANCE;
-
-                player.grounded        = true;
-                player.can_double_jump = true;
-                if (player.state == Player::FALLING) {
-                    player.state = Player::STANDING;
-                }
-            }
-        }
+void Game::load_state() {
+    if (!saved_state.valid || !world.is_match()) { return; }
+    world.restore(saved_state.world);
+    renderer.restore_screen_shake(saved_state.screen_shake);
 
-        if (!player.grounded && player.state != Player::WALL_CLING) {
-            new_player_velocity.y -= Player::GRAVITY;
-        }
+    // The session's snapshots are from before the jump
+    if (loopback.rtt > 0.0f) { start_loopback(loopback.rtt); }
+}
 
-        player.velocity  = new_player_velocity;
-        player.position_ = new_player_position;
-    }  // End for each player
+void Game::start_recording(const char* path) {
+    replay_reader.close();
 
-    {  // Player/Player Collisions // TODO
-        Circle colliders[2];
-        colliders[0] = players[0].body_collider();
-        colliders[1] = players[1].body_collider();
+    auto header        = std::make_unique<ReplayHeader>();
+    header->delta_time = 60.0f / game_config.tick_rate;
+    header->config     = world.config;
+    world.save(header->start);
+    for (size_t i = 0; i < NUM_PLAYERS; ++i) {
+        header->start_inputs[i] = world_gamepads[i].state();
+    }
+    header->has_saved_state = saved_state.valid;
+    if (saved_state.valid) { header->saved_state = saved_state.world; }
 
-        glm::vec2 between_colliders = colliders[0].center - colliders[1].center;
-        float distance              = glm::length(between_colliders);
+    if (!replay_writer.open(path, *header)) {
+        printf("[REPLAY] Couldn't create %s\n", path);
+    }
+}
 
-        if (distance < colliders[0].radius + colliders[1].radius) {
-            // players[0].velocity +=
-        }
+void Game::start_replay(const char* path) {
+    replay_writer.close();
+    if (!replay_reader.open(path)) {
+        printf("[REPLAY] Couldn't load %s\n", path);
+        return;
     }
 
-    // Collisions between weapon and weapon/ball
-    const Segment* weapons[NUM_PLAYERS];
+    const ReplayHeader& header = replay_reader.header();
+    world.config               = header.config;
+    world.restore(header.start);
     for (size_t i = 0; i < NUM_PLAYERS; ++i) {
-        weapons[i] = &players[i].weapon_collider;
+        world_gamepads[i].set_state(header.start_inputs[i]);
     }
 
-    if (weapons[0]->line() != glm::vec2(0.0f)
-        || weapons[1]->line() != glm::vec2(0.0f)) {
+    saved_state.valid = header.has_saved_state != 0;
+    saved_state.world = header.saved_state;
+    renderer.save_screen_shake(saved_state.screen_shake);
 
-        // Weapon vs. weapon
-        {
-            float t;
-            Point collision_pos;
-            if (intersect_segment_segment(
-                  *weapons[0], *weapons[1], &t, &collision_pos)) {
-                printf("Weapons colliding at t=%.2f, pos: %.2f, %.2f\n",
-                       t,
-                       collision_pos.x,
-                       collision_pos.y);
-
-#ifdef _DEBUG
-                std::array<DebugShader::Vertex, 1> shader_vertex = {
-                    collision_pos
-                };
-                collision_point.vao.update_vertex_data(shader_vertex);
-                collision_point.collision_happened = true;
-            } else {
-                collision_point.collision_happened = false;
-#endif
-            }
-        }
-
-        // Weapon vs. ball
-        for (size_t i = 0; i < NUM_PLAYERS; ++i) {
-            auto& weapon = weapons[i];
-            auto& player = players[i];
-
-            float t;
-            if (player.hit_cooldown <= 0.0f
-                && glm::length(weapon->line()) > player.body_collider().radius
-                && intersect_segment_circle(*weapon, ball.collider(), &t)) {
-
-                // The ball was hit
-                vec2 hit_direction = glm::normalize(
-                  player.weapon_collider.b - player.last_weapon_collider.b);
+    tick_accumulator = 0.0f;
+}
 
-                const float& trail_length = player.weapon_trail.trail_length;
+void Game::spawn_bots(u32 num_bots) {
+    // Replays and the saved state don't fit the new match
+    replay_writer.close();
+    replay_reader.close();
+    saved_state.valid = false;
 
-                vec2 hit_velocity = hit_direction * trail_length
-                                  * Player::HIT_SPEED_MULTIPLIER * t;
+    bots.resize(num_bots);
+    for (u32 i = 0; i < num_bots; ++i) {
+        bots[i].init(i + 1);
+    }
 
-                ball.set_velocity(hit_velocity);
+    world_gamepads.resize(NUM_PLAYERS + num_bots);
+    world.spawn_players(world_gamepads.data(), world_gamepads.size());
 
-                player.hit_cooldown = Player::MAX_HIT_COOLDOWN;
+    for (auto& state : render_states) {
+        state.players.resize(world.players.size());
+        write_render_state(state, 1.0f);
+    }
 
-                const float screen_shake_duration =
-                  game_config.hit_screen_shake_duration * trail_length;
+    // The session points at the old gamepads and players
+    start_loopback(world.is_match() ? loopback.rtt : 0.0f);
+}
 
-                player.freeze_duration = screen_shake_duration;
-                ball.freeze_duration   = screen_shake_duration;
-                renderer.shake_screen(game_config.hit_screen_shake_intensity
-                                        * trail_length,
-                                      screen_shake_duration,
-                                      game_config.hit_screen_shake_speed);
-                audio_manager.play(Sound::HIT_2);
-            }
-        }
-    }
+void Game::spawn_party_balls(u32 num_balls) {
+    replay_writer.close();
+    replay_reader.close();
+    saved_state.valid = false;
 
-    // Ball vs. goal
-    {
-        bool goal_hit = false;
-        for (uint i = 0; i < 2; ++i) {
-            for (const auto& coll : level.goals[i].colliders) {
-                if (test_circle_AABB(ball.collider(), coll)) {
-                    ball.reset();
-                    score[i] += 1;
-                    goal_hit = true;
-                    break;
-                }
-            }
-            if (goal_hit) break;
-        }
-    }
+    world.spawn_party_balls(num_balls);
+    start_loopback(world.is_match() ? loopback.rtt : 0.0f);
+}
 
-    ball.update(delta_time,
-                level.colliders,
-                audio_manager,
-                renderer.draw_ball_trajectory);
-    renderer.update(delta_time);
+PresentMode Game::present_mode() const {
+    return static_cast<PresentMode>(
+      glm::clamp(game_config.present_mode, 0, NUM_PRESENT_MODES - 1));
 }
 
 void Game::update_gui() {
+    PROFILE_SCOPE("Game::update_gui");
     using namespace ImGui;
     //////          Debug controls window           //////
     Begin("Debug control", NULL, ImGuiWindowFlags_NoTitleBar);
@@ -677,27 +760,182 @@ void Game::update_gui() {
             sprintf_s(label, "Player %zd", i);
             Checkbox(label, &player_window_open[i]);
             if (player_window_open[i]) {
-                player_window_open[i] = players[i].display_debug_ui(i);
+                player_window_open[i] =
+                  world.players[i].display_debug_ui(i);
             }
         }
     }
     {
         static bool ball_window_open = true;
         Checkbox("Ball", &ball_window_open);
-        if (ball_window_open) { ball.display_debug_ui(); }
+        if (ball_window_open) { world.ball.display_debug_ui(); }
+    }
+    {
+        static bool profiler_window_open = true;
+        Checkbox("Profiler", &profiler_window_open);
+        if (profiler_window_open) { Profiler::display_ui_window(); }
+    }
+    {
+        static bool counters_window_open = true;
+        Checkbox("Counters", &counters_window_open);
+        if (counters_window_open) { Counters::display_ui_window(); }
+    }
+
+    Separator();
+    Text("Frame pacing");
+    {
+        static const char* mode_names[NUM_PRESENT_MODES] = {
+            "VSync", "Adaptive VSync", "Uncapped", "Just in time"
+        };
+        PushItemWidth(150);
+        Combo("Present mode",
+              &game_config.present_mode,
+              mode_names,
+              NUM_PRESENT_MODES);
+        PopItemWidth();
+
+        const FrameStats& average = frame_pacer.average_stats();
+        Text("Frame %.2f ms: work %.2f, swap %.2f, wait %.2f",
+             average.frame,
+             average.work,
+             average.swap,
+             average.wait);
+        Text("Input to present %.2f ms", average.latency);
+        PlotLines("##frame_times",
+                  frame_pacer.frame_history(),
+                  FramePacer::HISTORY_SIZE,
+                  frame_pacer.history_offset(),
+                  "Frame times",
+                  0.0f,
+                  50.0f,
+                  ImVec2(0.0f, 40.0f));
+
+        // Switch between the modes to fill these in
+        float jit_latency =
+          frame_pacer.average_latency(PresentMode::JUST_IN_TIME);
+        for (s32 i = 0; i < NUM_PRESENT_MODES; ++i) {
+            float latency =
+              frame_pacer.average_latency(static_cast<PresentMode>(i));
+            if (latency == 0.0f) { continue; }
+            if (jit_latency > 0.0f
+                && i != static_cast<s32>(PresentMode::JUST_IN_TIME)) {
+                Text("%s: %.2f ms, just in time saves %.2f ms",
+                     mode_names[i],
+                     latency,
+                     latency - jit_latency);
+            } else {
+                Text("%s: %.2f ms", mode_names[i], latency);
+            }
+        }
+    }
+
+    Separator();
+    Text("Simulation");
+    Text("%u ticks last frame, %llu dropped",
+         ticks_last_frame,
+         static_cast<unsigned long long>(dropped_ticks));
+    if (Button("Save state (F5)")) {
+        pending_commands |= ReplayCommand::SAVE_STATE;
+    }
+    SameLine();
+    if (Button("Load state (F9)")) {
+        pending_commands |= ReplayCommand::LOAD_STATE;
+    }
+    Text("Snapshots are %zu bytes", sizeof(WorldSnapshot));
+    if (replay_writer.is_open()) {
+        Text("Recording: %llu ticks, %llu bytes",
+             static_cast<unsigned long long>(replay_writer.ticks()),
+             static_cast<unsigned long long>(replay_writer.size()));
+        SameLine();
+        if (Button("Stop recording")) { replay_writer.close(); }
+    } else if (replay_reader.is_open()) {
+        Text("Playing replay: tick %llu",
+             static_cast<unsigned long long>(replay_reader.ticks()));
+        SameLine();
+        if (Button("Stop replay")) { replay_reader.close(); }
+    } else if (world.is_match()) {
+        std::string path;
+        if (Button("Record replay")
+            && get_save_path(path, L".replay", L"*.replay", L"replay")) {
+            start_recording(path.c_str());
+        }
+        SameLine();
+        if (Button("Play replay")
+            && get_load_path(path, L".replay", L"*.replay")) {
+            start_replay(path.c_str());
+        }
     }
+    if (loopback.rtt > 0.0f) {
+        const RollbackStats& stats = loopback.session.stats();
+        Text("Rollback at %.0f ms RTT: %u ticks predicted, %llu rollbacks, "
+             "%llu ticks again (max %u), %llu stalls",
+             loopback.rtt,
+             loopback.session.prediction_ticks(),
+             static_cast<unsigned long long>(stats.rollbacks),
+             static_cast<unsigned long long>(stats.resimulated_ticks),
+             stats.max_rollback_ticks,
+             static_cast<unsigned long long>(stats.stalls));
+    }
+
+    Separator();
+    Text("Stress test");
+    PushItemWidth(100);
+    SliderInt("Bots", &requested_bots, 0, MAX_BOTS);
+    PopItemWidth();
+    SameLine();
+    if (Button("Restart match")) {
+        spawn_bots(static_cast<u32>(requested_bots));
+    }
+    PushItemWidth(100);
+    SliderInt("Party balls", &requested_party_balls, 0, MAX_PARTY_BALLS);
+    PopItemWidth();
+    SameLine();
+    if (Button("Drop balls")) {
+        spawn_party_balls(static_cast<u32>(requested_party_balls));
+    }
+    if (!world.is_match()) {
+        Text("%zu players, %zu party balls, no snapshots, replays or "
+             "loopback",
+             world.players.size(),
+             world.party_balls.size());
+    }
+
+    Separator();
+    Text("Collision");
+    // Should stop going up once every thread has seen its biggest query
+    Text("%llu scratch heap allocations",
+         static_cast<unsigned long long>(
+           ScratchVectorStats::heap_allocations.load()));
+    Text("%llu frame arena blocks, %zu bytes at most on the main thread",
+         static_cast<unsigned long long>(FrameArena::heap_allocations.load()),
+         FrameArena::local().peak_bytes());
+    Text("%zu broadphase swaps", world.broadphase().last_swap_count());
+    const BallisticMoveStats& move_stats = world.last_tick_move_stats();
+    Text("Bounces last tick: %llu moves, %llu iterations (max %llu), "
+         "%llu out of budget",
+         static_cast<unsigned long long>(move_stats.moves),
+         static_cast<unsigned long long>(move_stats.iterations),
+         static_cast<unsigned long long>(move_stats.max_iterations),
+         static_cast<unsigned long long>(move_stats.budget_exhausted));
+#ifdef VERIFY_COLLISION_OUTCOMES
+    Text("Verification: %llu checked, %llu failed, %llu dropped",
+         static_cast<unsigned long long>(CollisionVerifier::num_verified()),
+         static_cast<unsigned long long>(CollisionVerifier::num_violations()),
+         static_cast<unsigned long long>(CollisionVerifier::num_dropped()));
+#endif
 
     Separator();
     Text("Animation controls");
     PushItemWidth(100);
+    Animator& animator = world.players[0].animator;
     DragFloat("Step distance multiplier",
-              &players[0].animator.step_distance_multiplier,
+              &animator.step_distance_multiplier,
               1.0f,
               0.0f,
               0.0f,
               "%.1f");
     DragFloat2("Interpolation speed min/max",
-               &players[0].animator.interpolation_speed_multiplier.min,
+               &animator.interpolation_speed_multiplier.min,
                0.01f);
     PopItemWidth();
 
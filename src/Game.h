@@ -7,12 +7,23 @@
 #include "Player.h"
 #include "Input.h"
 #include "Background.h"
+#include "Bot.h"
+#include "FramePacer.h"
+#include "Profiler.h"
+#include "Counters.h"
 #include "rendering/Renderer.h"
 #include "Level.h"
 #include "Audio.h"
 #include "ConfigManager.h"
-#include "Ball.h"
-#include <sdl\SDL.h>
+#include "CollisionVerifier.h"
+#include "World.h"
+#include "Snapshot.h"
+#include "Replay.h"
+#include "Rollback.h"
+#include "RenderState.h"
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+#include <sdl/SDL.h>
 
 namespace Keybinds {
 constexpr SDL_Scancode DRAW_BONES   = SDL_SCANCODE_F1;
@@ -22,6 +33,8 @@ constexpr SDL_Scancode NEXT_STEP    = SDL_SCANCODE_N;
 constexpr SDL_Scancode HOLD_TO_STEP = SDL_SCANCODE_M;
 constexpr SDL_Scancode SPEED_UP     = SDL_SCANCODE_B;
 constexpr SDL_Scancode SPEED_DOWN   = SDL_SCANCODE_V;
+constexpr SDL_Scancode SAVE_STATE   = SDL_SCANCODE_F5;
+constexpr SDL_Scancode LOAD_STATE   = SDL_SCANCODE_F9;
 constexpr SDL_Scancode QUIT         = SDL_SCANCODE_ESCAPE;
 };  // namespace Keybinds
 
@@ -29,16 +42,35 @@ struct GameConfig {
     const u32 window_flags     = SDL_WINDOW_BORDERLESS | SDL_WINDOW_OPENGL;
     glm::ivec2 window_position = { 0, 0 };
 
-    const u32 fps         = 60;
-    const u32 frame_delay = 1000 / fps;
+    // Frames per second, 0 means no limit
+    s32 max_fps = 60;
+
+    // A PresentMode. Just in time, frames start late enough to be swapped
+    // jit_margin_ms before the next blank, after what they took recently.
+    s32 present_mode    = static_cast<s32>(PresentMode::VSYNC);
+    float jit_margin_ms = 1.5f;
+
+    // The simulation runs in fixed ticks, independent of the frame rate.
+    // Frames are rendered in between the last two ticks if interpolate is set.
+    // When the simulation falls behind by more than max_ticks_per_frame, the
+    // rest is dropped instead of catching up.
+    float tick_rate         = 60.0f;
+    s32 max_ticks_per_frame = 4;
+    bool interpolate        = true;
 
     float speed               = 1.0f;
     bool step_mode            = false;
     bool use_const_delta_time = true;
 
+    // Per unit of weapon trail length. The duration is the hit freeze
+    // duration of WorldConfig.
     float hit_screen_shake_intensity = 5.0f;
-    float hit_screen_shake_duration  = 30.0f;
     float hit_screen_shake_speed     = 0.5f;
+
+    // Round trip time in milliseconds of a simulated connection the second
+    // player's input is sent through, to try out rollback on one machine. 0
+    // turns it off.
+    float loopback_rtt = 0.0f;
 };
 
 class Game {
@@ -49,7 +81,12 @@ class Game {
     void run();
 
   private:
-    u32 frame_start, last_frame_start;
+    FramePacer frame_pacer;
+
+    // Simulation ticks that are due, the fraction is how far the next one is
+    float tick_accumulator = 0.0f;
+    u32 ticks_last_frame   = 0;
+    u64 dropped_ticks      = 0;
 
     GameConfig game_config;
 
@@ -62,22 +99,71 @@ class Game {
 
     MouseKeyboardInput mouse_keyboard_input;
 
-    static const size_t NUM_PLAYERS = 2;
+    static const size_t NUM_PLAYERS = World::NUM_PLAYERS;
 
     Gamepad gamepads[NUM_PLAYERS];
-    Player players[NUM_PLAYERS];
 
-    Ball ball;
+    // What the gamepads reported this frame
+    GamepadState polled_input[NUM_PLAYERS];
+
+    // The ones the World reads. They are set to the input of every tick, so
+    // a button press registers on exactly one tick, same as in a replay. The
+    // ones after the first NUM_PLAYERS are played by the bots.
+    std::vector<Gamepad> world_gamepads;
+
+    // Extra players and balls for stress testing and party modes. While
+    // there are any, there are no snapshots, replays or loopback, those only
+    // work with a plain match.
+    static const s32 MAX_BOTS        = 126;
+    static const s32 MAX_PARTY_BALLS = 1000;
+    std::vector<Bot> bots;
+    s32 requested_bots        = 0;  // From the UI
+    s32 requested_party_balls = 0;
+
+    // ReplayCommands from the keyboard and UI, applied at the next tick
+    u32 pending_commands = 0;
+
+    World world;
+    WorldEvents world_events;
+
+    // Quick save of the simulation, to play the same situation again
+    struct {
+        WorldSnapshot world;
+        ScreenShakeSnapshot screen_shake;
+        bool valid = false;
+    } saved_state;
+
+    // The first player is local, the second one is treated as remote, see
+    // GameConfig::loopback_rtt
+    struct {
+        RollbackSession session;
+        LoopbackLink link;
+        float rtt        = 0.0f;  // Zero while not in use
+        double now       = 0.0;   // In milliseconds
+        u32 remote_ticks = 0;     // Inputs the remote player sent so far
+    } loopback;
+
+    // Replays record and play the simulation without the loopback
+    ReplayWriter replay_writer;
+    ReplayReader replay_reader;
+
+    // The simulation thread fills one while the other one is drawn
+    RenderState render_states[2];
+    u32 front_render_state  = 0;
+    bool simulation_running = false;
+    // Of the front RenderState if it's new this frame, otherwise 0
+    u64 shown_input_time = 0;
+
+    // For drawing the legs of the front RenderState, the Animators' splines
+    // belong to the simulation thread. Only the match players' legs are drawn.
+    Spline leg_splines[NUM_PLAYERS][2];
 
     Background background;
 
-    Level level;
     LevelEditor level_editor;
 
     ConfigManager config_loader;
 
-    uint score[2] = { 0, 0 };
-
 #ifdef _DEBUG
     struct {
         bool collision_happened;
@@ -87,6 +173,43 @@ class Game {
 
     enum GameMode { PLAY = 0, SPLINE_EDITOR = 1, LEVEL_EDITOR = 2 } game_mode;
 
-    void simulate_world(float delta_time);
+    // Runs on the simulation thread: simulates the frame's ticks and fills the
+    // back RenderState
+    void simulate_frame(u32 num_ticks, float delta_time, float alpha);
+    // Waits for simulate_frame(), then plays and shows what happened in it
+    void finish_simulation();
+    void write_render_state(RenderState& state, float alpha) const;
+    void render_world(const RenderState& state);
+
+    // Simulates one tick and adds what happened during it to the back
+    // RenderState
+    void tick(float delta_time);
+    void start_loopback(float rtt);
+    // Returns false if the session is waiting for remote input
+    bool tick_loopback(const GamepadState inputs[NUM_PLAYERS],
+                       float delta_time);
+    void save_state();
+    void load_state();
+    void start_recording(const char* path);
+    void start_replay(const char* path);
+    // Restarts the match with num_bots extra players
+    void spawn_bots(u32 num_bots);
+    void spawn_party_balls(u32 num_balls);
     void update_gui();
+    PresentMode present_mode() const;
+
+    // What simulate_frame() runs: the ticks, then the RenderState of every
+    // player and the ball in parallel
+    TaskGraph frame_graph;
+    struct {
+        u32 num_ticks;
+        float delta_time;
+        float alpha;
+    } frame;
+
+    // For the frame graph and World::jobs
+    std::unique_ptr<ThreadPool> job_pool;
+
+    // Last, so it stops before anything it simulates is destroyed
+    ThreadPool simulation_thread { 1, "Simulation" };
 };
\ No newline at end of file
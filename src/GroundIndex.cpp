@@ -0,0 +1,187 @@
+#pragma once
+#include "GroundIndex.h"
+#include <algorithm>
+#include <sdl/SDL_assert.h>
+
+bool GroundIndex::higher_top(const Entry& a, const Entry& b) {
+    return a.top > b.top;
+}
+
+void GroundIndex::build(const std::vector<const AABB*>& boxes) {
+    edges.clear();
+    edge_users.clear();
+    columns.clear();
+    spans.clear();
+
+    for (const auto box : boxes) {
+        spans[box] = { box->min(0), box->max(0), box->max(1) };
+        edges.push_back(box->min(0));
+        edges.push_back(box->max(0));
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    edge_users.resize(edges.size(), 0);
+    if (edges.size() > 1) { columns.resize(edges.size() - 1); }
+
+    for (const auto box : boxes) {
+        const Span& span = spans[box];
+        size_t first     = find_edge(span.min_x);
+        size_t last      = find_edge(span.max_x);
+        ++edge_users[first];
+        ++edge_users[last];
+
+        for (size_t i = first; i < last; ++i) {
+            columns[i].push_back({ box, span.top });
+        }
+    }
+
+    for (auto& column : columns) {
+        std::stable_sort(column.begin(), column.end(), higher_top);
+    }
+}
+
+void GroundIndex::insert(const AABB* box) {
+    SDL_assert(spans.find(box) == spans.end());
+
+    Span span  = { box->min(0), box->max(0), box->max(1) };
+    spans[box] = span;
+
+    add_edge(span.min_x);
+    add_edge(span.max_x);
+
+    size_t first = find_edge(span.min_x);
+    size_t last  = find_edge(span.max_x);
+    Entry entry  = { box, span.top };
+    for (size_t i = first; i < last; ++i) {
+        auto& column = columns[i];
+        column.insert(
+          std::upper_bound(column.begin(), column.end(), entry, higher_top),
+          entry);
+    }
+}
+
+void GroundIndex::remove(const AABB* box) {
+    auto it = spans.find(box);
+    SDL_assert(it != spans.end());
+    Span span = it->second;
+    spans.erase(it);
+
+    size_t first = find_edge(span.min_x);
+    size_t last  = find_edge(span.max_x);
+    for (size_t i = first; i < last; ++i) {
+        auto& column = columns[i];
+        auto entry   = std::find_if(
+          column.begin(), column.end(), [box](const Entry& e) {
+              return e.box == box;
+          });
+        SDL_assert(entry != column.end());
+        column.erase(entry);
+    }
+
+    release_edge(span.max_x);
+    release_edge(span.min_x);
+}
+
+void GroundIndex::update(const AABB* box) {
+    remove(box);
+    insert(box);
+}
+
+bool GroundIndex::contains(const AABB* box) const {
+    return spans.find(box) != spans.end();
+}
+
+const AABB* GroundIndex::find_highest(float x, float max_height) const {
+    if (columns.empty() || x < edges.front() || x > edges.back()) {
+        return nullptr;
+    }
+
+    // Column whose left edge is the last one at or before x
+    size_t column =
+      std::upper_bound(edges.begin(), edges.end(), x) - edges.begin() - 1;
+
+    const Entry* result = nullptr;
+    if (column < columns.size()) {
+        result = find_highest_in_column(column, max_height);
+    }
+
+    // Colliders ending exactly at x are only in the column to the left
+    if (edges[column] == x && column > 0) {
+        const Entry* left = find_highest_in_column(column - 1, max_height);
+        if (left && (!result || left->top > result->top)) { result = left; }
+    }
+
+    return result ? result->box : nullptr;
+}
+
+size_t GroundIndex::find_edge(float x) const {
+    auto it = std::lower_bound(edges.begin(), edges.end(), x);
+    SDL_assert(it != edges.end() && *it == x);
+    return it - edges.begin();
+}
+
+void GroundIndex::add_edge(float x) {
+    auto it      = std::lower_bound(edges.begin(), edges.end(), x);
+    size_t index = it - edges.begin();
+    if (it != edges.end() && *it == x) {
+        ++edge_users[index];
+        return;
+    }
+
+    size_t old_count = edges.size();
+    edges.insert(it, x);
+    edge_users.insert(edge_users.begin() + index, 1);
+
+    if (old_count == 0) { return; }
+
+    if (index == 0) {
+        // New leftmost edge, nothing spans the new column yet
+        columns.insert(columns.begin(), std::vector<Entry>());
+    } else if (index == old_count) {
+        columns.emplace_back();
+    } else {
+        // Split the column the edge fell into. Both halves are spanned by
+        // the same colliders.
+        std::vector<Entry> copy = columns[index - 1];
+        columns.insert(columns.begin() + index, std::move(copy));
+    }
+}
+
+void GroundIndex::release_edge(float x) {
+    size_t index = find_edge(x);
+    SDL_assert(edge_users[index] > 0);
+    if (--edge_users[index] > 0) { return; }
+
+    edges.erase(edges.begin() + index);
+    edge_users.erase(edge_users.begin() + index);
+
+    if (edges.empty()) {
+        SDL_assert(columns.empty());
+        return;
+    }
+
+    // No collider starts or ends at x anymore, so every collider that spans
+    // one of the columns next to it spans both and they can be merged by
+    // dropping one of them.
+    if (index == 0) {
+        SDL_assert(columns.front().empty());
+        columns.erase(columns.begin());
+    } else if (index == columns.size()) {
+        SDL_assert(columns.back().empty());
+        columns.pop_back();
+    } else {
+        SDL_assert(columns[index].size() == columns[index - 1].size());
+        columns.erase(columns.begin() + index);
+    }
+}
+
+const GroundIndex::Entry*
+GroundIndex::find_highest_in_column(size_t column, float max_height) const {
+    const auto& entries = columns[column];
+    auto it             = std::partition_point(
+      entries.begin(), entries.end(), [max_height](const Entry& e) {
+          return e.top >= max_height;
+      });
+    return it != entries.end() ? &*it : nullptr;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cfloat>
+#include <vector>
+#include <unordered_map>
+#include "Collider.h"
+#include "Types.h"
+
+// Index over the x extents of colliders that answers "which collider has the
+// highest top at x" without looking at all of them. The x axis is cut into
+// columns at the left and right edge of every collider and each column keeps
+// the colliders spanning it sorted by their top, highest first. Queries are a
+// binary search for the column and one for the height.
+class GroundIndex {
+  public:
+    void build(const std::vector<const AABB*>& boxes);
+
+    void insert(const AABB* box);
+    void remove(const AABB* box);
+
+    // Has to be called after box was moved or resized.
+    void update(const AABB* box);
+
+    bool contains(const AABB* box) const;
+
+    // Returns the collider with the highest top below max_height that covers
+    // x (edges included) or nullptr if there is none.
+    const AABB* find_highest(float x, float max_height = FLT_MAX) const;
+
+  private:
+    struct Entry {
+        const AABB* box;
+        float top;
+    };
+
+    // The extents a box had when it was added, so it can be found again
+    // after it was changed
+    struct Span {
+        float min_x, max_x, top;
+    };
+
+    // Sorted x positions of all collider edges and how many colliders have an
+    // edge there. columns[i] spans [edges[i], edges[i + 1]].
+    std::vector<float> edges;
+    std::vector<u32> edge_users;
+    std::vector<std::vector<Entry>> columns;
+
+    std::unordered_map<const AABB*, Span> spans;
+
+    // Sorts entries of a column by their top, highest first
+    static bool higher_top(const Entry& a, const Entry& b);
+
+    size_t find_edge(float x) const;
+    void add_edge(float x);
+    void release_edge(float x);
+
+    // Highest entry of column with a top below max_height or nullptr
+    const Entry* find_highest_in_column(size_t column, float max_height) const;
+};
@@ -0,0 +1,447 @@
+#pragma once
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "BatchRunner.h"
+#include "ConfigManager.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "World.h"
+
+// Runs matches with scripted input as fast as possible, for benchmarking,
+// balance testing and for checking that changes don't alter the outcome.
+// Equal seeds, tick counts and configs give equal checksums, no matter how
+// many threads are used.
+//
+// Usage: procAnimHeadless [--ticks N] [--seed N] [--matches N] [--threads N]
+//                         [--scaling] [--list]
+//                         [--rollback RTT] [--jitter MS] [--loss PERCENT]
+//                         [--delay TICKS] [--record FILE] [--replay FILE]
+//                         [--job-scaling] [--players N] [--player-scaling]
+//                         [--balls N] [--ball-scaling] [--trace FILE]
+//
+// --scaling runs the same batch on 1, 2, 4, ... 64 threads.
+// --job-scaling runs a single match with its players updated in parallel on
+// 1, 2, 4 and 8 job threads, after running it without any.
+// --players puts N bots into the matches of a batch or --job-scaling instead
+// of two.
+// --player-scaling runs a single match on one thread with 2, 4, ... 128 bots.
+// The time per player and tick should stay about the same.
+// --balls adds N party balls to the matches of a batch or --job-scaling.
+// --ball-scaling runs a single match on one thread with 0, 125, ... 1000
+// party balls. A tick has 16.7 ms at 60 Hz.
+// --rollback plays one match as two rollback peers over a simulated
+// connection with a round trip time of RTT milliseconds instead.
+// --record plays one scripted match and saves its inputs as a replay,
+// --replay plays one back as fast as possible. Both print the checksum, which
+// has to be the same for a match and its replay.
+// --trace turns the Profiler on and writes the last events of every thread as
+// a Chrome trace_event file when done.
+
+// Same spot the ball starts at in the game, the default camera center
+static const vec2 BALL_START_POSITION = { 1034.0f, 831.0f };
+
+static const size_t MAX_SCALING_THREADS = 64;
+static const size_t MAX_SCALING_PLAYERS = 128;
+static const size_t MAX_SCALING_BALLS   = 1000;
+
+// Writes the Profiler's events when main() returns, however it returns
+struct TraceOnExit {
+    const char* path = nullptr;
+
+    ~TraceOnExit() {
+        if (!path) { return; }
+        if (Profiler::write_chrome_trace(path)) {
+            printf("[HEADLESS] Wrote trace %s\n", path);
+        } else {
+            printf("[HEADLESS] Couldn't write trace %s\n", path);
+        }
+    }
+};
+
+static u64 combined_checksum(const BatchResult& result) {
+    u64 checksum = 0;
+    for (const auto& match : result.matches) {
+        checksum = checksum * 31 + match.checksum;
+    }
+    return checksum;
+}
+
+static void print_summary(const BatchResult& result, size_t num_threads) {
+    double ticks_per_second = result.ticks_per_second();
+
+    printf("[HEADLESS] %2zd threads: %llu ticks in %.3f s (loading %.3f s), "
+           "%.0f ticks/s, %.0f ticks/s per thread, %llu steals\n",
+           num_threads,
+           static_cast<unsigned long long>(result.total_ticks),
+           result.run_seconds,
+           result.init_seconds,
+           ticks_per_second,
+           ticks_per_second / static_cast<double>(num_threads),
+           static_cast<unsigned long long>(result.steals));
+}
+
+static void print_loopback(const LoopbackResult& result,
+                           const LoopbackLink::Settings& link_settings,
+                           u32 input_delay) {
+    printf("[HEADLESS] Rollback over %.0f ms RTT (+%.0f ms jitter, %.0f%% "
+           "loss), local input delay %u ticks, %llu ticks\n",
+           link_settings.latency * 2.0f,
+           link_settings.jitter,
+           link_settings.loss * 100.0f,
+           input_delay,
+           static_cast<unsigned long long>(result.ticks));
+
+    for (size_t i = 0; i < World::NUM_PLAYERS; ++i) {
+        const RollbackStats& stats = result.stats[i];
+        printf("[HEADLESS] Peer %zd: %llu rollbacks, %llu ticks simulated "
+               "again (max %u at once), %llu stalls, %llu/%llu checksums "
+               "matched\n",
+               i,
+               static_cast<unsigned long long>(stats.rollbacks),
+               static_cast<unsigned long long>(stats.resimulated_ticks),
+               stats.max_rollback_ticks,
+               static_cast<unsigned long long>(stats.stalls),
+               static_cast<unsigned long long>(stats.checks - stats.desyncs),
+               static_cast<unsigned long long>(stats.checks));
+    }
+
+    printf("[HEADLESS] Up to %u ticks predicted, advance %.3f ms on average, "
+           "%.3f ms max\n",
+           result.max_prediction_ticks,
+           result.average_advance_ms,
+           result.max_advance_ms);
+}
+
+static void run_job_scaling(const WorldConfig& world_config,
+                            u64 num_ticks,
+                            u32 seed,
+                            size_t num_players,
+                            size_t num_balls) {
+    using Clock = std::chrono::steady_clock;
+
+    // 0 is without a ThreadPool, everything on this thread
+    const size_t job_threads[] = { 0, 1, 2, 4, 8 };
+
+    double sequential_rate = 0.0;
+    for (size_t threads : job_threads) {
+        std::unique_ptr<ThreadPool> jobs;
+        if (threads > 0) { jobs = std::make_unique<ThreadPool>(threads); }
+
+        auto match = std::make_unique<ScriptedMatch>();
+        match->init(world_config,
+                    BALL_START_POSITION,
+                    seed,
+                    jobs.get(),
+                    num_players,
+                    num_balls);
+
+        auto start = Clock::now();
+        match->run(num_ticks);
+        double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+
+        double rate =
+          seconds > 0.0 ? static_cast<double>(num_ticks) / seconds : 0.0;
+        if (threads == 0) { sequential_rate = rate; }
+
+        printf("[HEADLESS] %zd job threads: %.0f ticks/s, speedup %.2fx, "
+               "checksum %016llx\n",
+               threads,
+               rate,
+               sequential_rate > 0.0 ? rate / sequential_rate : 0.0,
+               static_cast<unsigned long long>(match->checksum()));
+    }
+}
+
+static void run_player_scaling(const WorldConfig& world_config,
+                               u64 num_ticks,
+                               u32 seed) {
+    using Clock = std::chrono::steady_clock;
+
+    for (size_t players = World::NUM_PLAYERS; players <= MAX_SCALING_PLAYERS;
+         players *= 2) {
+        auto match = std::make_unique<ScriptedMatch>();
+        match->init(world_config, BALL_START_POSITION, seed, nullptr, players);
+
+        auto start = Clock::now();
+        match->run(num_ticks);
+        double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+
+        double ms_per_tick =
+          num_ticks > 0 ? seconds * 1000.0 / static_cast<double>(num_ticks)
+                        : 0.0;
+        printf("[HEADLESS] %3zd players: %.3f ms per tick, %.2f us per player "
+               "and tick, checksum %016llx\n",
+               players,
+               ms_per_tick,
+               ms_per_tick * 1000.0 / static_cast<double>(players),
+               static_cast<unsigned long long>(match->checksum()));
+    }
+}
+
+static void run_ball_scaling(const WorldConfig& world_config,
+                             u64 num_ticks,
+                             u32 seed) {
+    using Clock = std::chrono::steady_clock;
+
+    for (size_t balls = 0; balls <= MAX_SCALING_BALLS;
+         balls += MAX_SCALING_BALLS / 8) {
+        auto match = std::make_unique<ScriptedMatch>();
+        match->init(world_config,
+                    BALL_START_POSITION,
+                    seed,
+                    nullptr,
+                    World::NUM_PLAYERS,
+                    balls);
+
+        auto start = Clock::now();
+        match->run(num_ticks);
+        double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+
+        double ms_per_tick =
+          num_ticks > 0 ? seconds * 1000.0 / static_cast<double>(num_ticks)
+                        : 0.0;
+        printf("[HEADLESS] %4zd party balls: %.3f ms per tick, score %u:%u, "
+               "checksum %016llx\n",
+               balls,
+               ms_per_tick,
+               match->world().score[0],
+               match->world().score[1],
+               static_cast<unsigned long long>(match->checksum()));
+    }
+}
+
+static void print_matches(const BatchResult& result) {
+    uint wins[World::NUM_PLAYERS] = {};
+    u64 hits                      = 0;
+    for (const auto& match : result.matches) {
+        if (match.score[0] > match.score[1]) { ++wins[0]; }
+        if (match.score[1] > match.score[0]) { ++wins[1]; }
+        hits += match.hits;
+    }
+
+    printf("[HEADLESS] %zd matches, wins %u:%u, %llu hits, checksum %016llx\n",
+           result.matches.size(),
+           wins[0],
+           wins[1],
+           static_cast<unsigned long long>(hits),
+           static_cast<unsigned long long>(combined_checksum(result)));
+}
+
+int main(int argc, char* argv[]) {
+    u64 num_ticks      = 10000;
+    u32 seed           = 1;
+    u32 num_matches    = 0;  // Default depends on the mode
+    size_t num_threads = 1;
+    bool scaling       = false;
+    bool list          = false;
+
+    bool rollback = false;
+    LoopbackLink::Settings link_settings;
+    u32 input_delay = 0;
+
+    const char* record_path = nullptr;
+    const char* replay_path = nullptr;
+    bool job_scaling        = false;
+
+    size_t num_players  = World::NUM_PLAYERS;
+    bool player_scaling = false;
+    size_t num_balls    = 0;
+    bool ball_scaling   = false;
+
+    TraceOnExit trace;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            num_ticks = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<u32>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--matches") == 0 && i + 1 < argc) {
+            num_matches = static_cast<u32>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else if (strcmp(argv[i], "--rollback") == 0 && i + 1 < argc) {
+            rollback              = true;
+            link_settings.latency = strtof(argv[++i], nullptr) * 0.5f;
+        } else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc) {
+            link_settings.jitter = strtof(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            link_settings.loss = strtof(argv[++i], nullptr) / 100.0f;
+        } else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) {
+            input_delay = static_cast<u32>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--job-scaling") == 0) {
+            job_scaling = true;
+        } else if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) {
+            num_players = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--player-scaling") == 0) {
+            player_scaling = true;
+        } else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+            num_balls = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--ball-scaling") == 0) {
+            ball_scaling = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace.path = argv[++i];
+        } else {
+            printf("Usage: %s [--ticks N] [--seed N] [--matches N] "
+                   "[--threads N] [--scaling] [--list] [--rollback RTT] "
+                   "[--jitter MS] [--loss PERCENT] [--delay TICKS] "
+                   "[--record FILE] [--replay FILE] [--job-scaling] "
+                   "[--players N] [--player-scaling] [--balls N] "
+                   "[--ball-scaling] [--trace FILE]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    if (trace.path) {
+        Profiler::set_thread_name("Main");
+        Profiler::set_enabled(true);
+    }
+
+    if (num_threads == 0) { num_threads = 1; }
+    if (num_players < World::NUM_PLAYERS) { num_players = World::NUM_PLAYERS; }
+    if (num_matches == 0) {
+        // Enough for every thread of the biggest run to have one
+        num_matches = scaling ? static_cast<u32>(MAX_SCALING_THREADS) : 1;
+    }
+
+    WorldConfig world_config;
+    ConfigManager config_loader;
+    config_loader.init_simulation(world_config);
+    config_loader.load_config("../assets/config.ini");
+
+    printf("[HEADLESS] %u hardware threads\n",
+           std::thread::hardware_concurrency());
+
+    if (job_scaling) {
+        run_job_scaling(
+          world_config, num_ticks, seed, num_players, num_balls);
+        return 0;
+    }
+
+    if (player_scaling) {
+        run_player_scaling(world_config, num_ticks, seed);
+        return 0;
+    }
+
+    if (ball_scaling) {
+        run_ball_scaling(world_config, num_ticks, seed);
+        return 0;
+    }
+
+    if (replay_path) {
+        ReplayResult result = play_replay(replay_path);
+        if (!result.loaded) {
+            printf("[HEADLESS] Couldn't load replay %s\n", replay_path);
+            return 1;
+        }
+        printf("[HEADLESS] Replayed %llu ticks in %.3f s, %.0f ticks/s, "
+               "score %u:%u, checksum %016llx\n",
+               static_cast<unsigned long long>(result.ticks),
+               result.seconds,
+               result.ticks_per_second(),
+               result.score[0],
+               result.score[1],
+               static_cast<unsigned long long>(result.checksum));
+        return 0;
+    }
+
+    if (record_path) {
+        auto match = std::make_unique<ScriptedMatch>();
+        match->init(world_config, BALL_START_POSITION, seed);
+        if (!match->record(record_path)) {
+            printf("[HEADLESS] Couldn't create replay %s\n", record_path);
+            return 1;
+        }
+        match->run(num_ticks);
+        printf("[HEADLESS] Recorded %llu ticks of seed %u, score %u:%u, "
+               "checksum %016llx\n",
+               static_cast<unsigned long long>(match->ticks()),
+               seed,
+               match->world().score[0],
+               match->world().score[1],
+               static_cast<unsigned long long>(match->checksum()));
+        return 0;
+    }
+
+    if (rollback) {
+        if (input_delay >= RollbackSession::MAX_PREDICTION_TICKS) {
+            input_delay = RollbackSession::MAX_PREDICTION_TICKS - 1;
+        }
+        link_settings.seed    = seed;
+        LoopbackResult result = run_loopback_match(world_config,
+                                                   BALL_START_POSITION,
+                                                   link_settings,
+                                                   input_delay,
+                                                   num_ticks,
+                                                   seed);
+        print_loopback(result, link_settings, input_delay);
+        return 0;
+    }
+
+    if (!scaling) {
+        ThreadPool pool(num_threads);
+        BatchResult result = run_batch(pool,
+                                       world_config,
+                                       BALL_START_POSITION,
+                                       num_matches,
+                                       num_ticks,
+                                       seed,
+                                       num_players,
+                                       num_balls);
+
+        print_summary(result, num_threads);
+        print_matches(result);
+
+        if (list) {
+            for (const auto& match : result.matches) {
+                printf("[HEADLESS] Seed %u: score %u:%u, %llu hits, "
+                       "checksum %016llx\n",
+                       match.seed,
+                       match.score[0],
+                       match.score[1],
+                       static_cast<unsigned long long>(match.hits),
+                       static_cast<unsigned long long>(match.checksum));
+            }
+        }
+        return 0;
+    }
+
+    // Same batch on more and more threads, the checksum has to stay the same
+    double single_thread_rate = 0.0;
+    for (size_t threads = 1; threads <= MAX_SCALING_THREADS; threads *= 2) {
+        ThreadPool pool(threads);
+        BatchResult result = run_batch(pool,
+                                       world_config,
+                                       BALL_START_POSITION,
+                                       num_matches,
+                                       num_ticks,
+                                       seed,
+                                       num_players,
+                                       num_balls);
+
+        if (threads == 1) { single_thread_rate = result.ticks_per_second(); }
+
+        print_summary(result, threads);
+        printf("[HEADLESS]             speedup %.2fx, checksum %016llx\n",
+               single_thread_rate > 0.0
+                 ? result.ticks_per_second() / single_thread_rate
+                 : 0.0,
+               static_cast<unsigned long long>(combined_checksum(result)));
+    }
+
+    return 0;
+}
@@ -113,7 +113,9 @@ void Gamepad::update() {
     // Check if gamepad is still valid
     if (!sdl_ptr) { return; }
 
-    {  // Poll all the axes on this pad and parse their values into (axes[])
+    GamepadState state;
+
+    {  // Poll all the axes on this pad and parse their values into the state
         s16 raw_axis_inputs[NUM_AXES];
         for (size_t n_axis = 0; n_axis < NUM_AXES; ++n_axis) {
             raw_axis_inputs[n_axis] = SDL_GameControllerGetAxis(
@@ -121,10 +123,10 @@ void Gamepad::update() {
         }
 
         // For the triggers, normalize and set the value
-        axes[SDL_CONTROLLER_AXIS_TRIGGERLEFT] =
+        state.axes[SDL_CONTROLLER_AXIS_TRIGGERLEFT] =
           static_cast<float>(raw_axis_inputs[SDL_CONTROLLER_AXIS_TRIGGERLEFT])
           / 32767.0f;
-        axes[SDL_CONTROLLER_AXIS_TRIGGERRIGHT] =
+        state.axes[SDL_CONTROLLER_AXIS_TRIGGERRIGHT] =
           static_cast<float>(raw_axis_inputs[SDL_CONTROLLER_AXIS_TRIGGERRIGHT])
           / 32767.0f;
 
@@ -139,13 +141,13 @@ void Gamepad::update() {
               < Gamepad::STICK_DEADZONE_IN
             && std::abs(raw_axis_inputs[SDL_CONTROLLER_AXIS_LEFTY])
                  < Gamepad::STICK_DEADZONE_IN) {
-            axes[SDL_CONTROLLER_AXIS_LEFTX] = 0.0f;
-            axes[SDL_CONTROLLER_AXIS_LEFTY] = 0.0f;
+            state.axes[SDL_CONTROLLER_AXIS_LEFTX] = 0.0f;
+            state.axes[SDL_CONTROLLER_AXIS_LEFTY] = 0.0f;
         } else {
-            axes[SDL_CONTROLLER_AXIS_LEFTX] =
+            state.axes[SDL_CONTROLLER_AXIS_LEFTX] =
               static_cast<float>(raw_axis_inputs[SDL_CONTROLLER_AXIS_LEFTX])
               / MAX_STICK_VALUE;
-            axes[SDL_CONTROLLER_AXIS_LEFTY] =
+            state.axes[SDL_CONTROLLER_AXIS_LEFTY] =
               static_cast<float>(raw_axis_inputs[SDL_CONTROLLER_AXIS_LEFTY])
               / -MAX_STICK_VALUE;
         }
@@ -154,36 +156,47 @@ void Gamepad::update() {
               < Gamepad::STICK_DEADZONE_IN
             && std::abs(raw_axis_inputs[SDL_CONTROLLER_AXIS_RIGHTY])
                  < Gamepad::STICK_DEADZONE_IN) {
-            axes[SDL_CONTROLLER_AXIS_RIGHTX] = 0.0f;
-            axes[SDL_CONTROLLER_AXIS_RIGHTY] = 0.0f;
+            state.axes[SDL_CONTROLLER_AXIS_RIGHTX] = 0.0f;
+            state.axes[SDL_CONTROLLER_AXIS_RIGHTY] = 0.0f;
         } else {
-            axes[SDL_CONTROLLER_AXIS_RIGHTX] =
+            state.axes[SDL_CONTROLLER_AXIS_RIGHTX] =
               static_cast<float>(raw_axis_inputs[SDL_CONTROLLER_AXIS_RIGHTX])
               / MAX_STICK_VALUE;
-            axes[SDL_CONTROLLER_AXIS_RIGHTY] =
+            state.axes[SDL_CONTROLLER_AXIS_RIGHTY] =
               static_cast<float>(raw_axis_inputs[SDL_CONTROLLER_AXIS_RIGHTY])
               / -MAX_STICK_VALUE;
         }
     }
 
     // Poll all the buttons on this pad
+    state.buttons = 0;
     for (u32 n_button = 0; n_button < Gamepad::NUM_BUTTONS; ++n_button) {
         if (SDL_GameControllerGetButton(
               sdl_ptr, static_cast<SDL_GameControllerButton>(n_button))) {
-            if (!button(n_button)) {
-                setNthBitTo(button_down_map, n_button, 1);
-            } else {
-                setNthBitTo(button_down_map, n_button, 0);
-            }
-            setNthBitTo(button_map, n_button, 1);
-        } else if (button(n_button)) {
-            setNthBitTo(button_down_map, n_button, 0);
-            setNthBitTo(button_up_map, n_button, 1);
-            setNthBitTo(button_map, n_button, 0);
-        } else {
-            setNthBitTo(button_up_map, n_button, 0);
+            state.buttons |= BIT(n_button);
         }
     }
+
+    set_state(state);
+}
+
+void Gamepad::set_state(const GamepadState& state) {
+    for (size_t n_axis = 0; n_axis < NUM_AXES; ++n_axis) {
+        axes[n_axis] = state.axes[n_axis];
+    }
+
+    button_down_map = state.buttons & ~button_map;
+    button_up_map   = ~state.buttons & button_map;
+    button_map      = state.buttons;
+}
+
+GamepadState Gamepad::state() const {
+    GamepadState result;
+    for (size_t n_axis = 0; n_axis < NUM_AXES; ++n_axis) {
+        result.axes[n_axis] = axes[n_axis];
+    }
+    result.buttons = button_map;
+    return result;
 }
 
 glm::vec2 Gamepad::stick(StickID id) const {
@@ -45,6 +45,12 @@ class MouseKeyboardInput {
 
 enum class StickID : size_t { LEFT = 0, RIGHT = 1, TRIGGERS = 2 };
 
+// Everything a gamepad reports in one frame, after the deadzones
+struct GamepadState {
+    float axes[SDL_CONTROLLER_AXIS_MAX];
+    u32 buttons;  // One bit per SDL_GameControllerButton
+};
+
 class Gamepad {
     static constexpr s16 MAX_STICK_VALUE = 32767;
 
@@ -63,6 +69,11 @@ class Gamepad {
     void init(size_t index);
     void update();
 
+    // Feeds the gamepad a state that didn't come from SDL, e.g. from a script
+    // when running headless
+    void set_state(const GamepadState& state);
+    GamepadState state() const;
+
     glm::vec2 stick(StickID id) const;
 
     bool button(u32 n) const;
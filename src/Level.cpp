@@ -3,11 +3,15 @@
 #include "rendering/Renderer.h"
 #include "Input.h"
 #include "CollisionDetection.h"
+#include "Profiler.h"
 #include <imgui/imgui.h>
 #include <glm/gtx/matrix_transform_2d.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
 
+#ifndef HEADLESS
 void Level::render(const Renderer& renderer) const {
+    PROFILE_SCOPE("Level::render");
     renderer.textured_shader.set_texture(wall_texture);
 
     for (const auto& coll : colliders) {
@@ -30,80 +34,214 @@ void Level::render(const Renderer& renderer) const {
         }
     }
 }
+#endif
 
 const AABB* Level::find_ground_under(glm::vec2 position) const {
-    const AABB* candidate = nullptr;
-    for (const AABB& coll : colliders) {
-        if (coll.min(0) <= position.x && coll.max(0) >= position.x
-            && position.y > coll.max(1)) {
+    return ground_index.find_highest(position.x, position.y);
+}
 
-            if (!candidate || coll.max(1) > candidate->max(1)) {
-                candidate = &coll;
-            }
-        }
-    }
-    return candidate;
+glm::vec2 Level::find_highest_ground_at(float x) const {
+    const AABB* ground = ground_index.find_highest(x);
+    return glm::vec2(x, ground ? ground->max(1) : 0.0f);
 }
 
 /*
-    File format:
+    File format (version 2):
+        u32 magic ("LEVL")
+        u32 version
+        ColliderSet source
+        ColliderSet baked
+
+    ColliderSet:
         size_t num_colliders
         size_t num_goals[0]
         size_t num_goals[1]
         AABB colliders[num_colliders]
         AABB goals[num_goals[0]]
         AABB goals[num_goals[1]]
-*/
 
-void Level::load_from_file(const char* path) {
-    SDL_assert_always(path != nullptr);
-
-    opened_path = std::string(path);
+    Version 1 files have no header and contain only one unbaked ColliderSet.
+*/
 
-    colliders.clear();
+static const u32 LEVEL_FILE_MAGIC   = 0x4C56454C;  // "LEVL"
+static const u32 LEVEL_FILE_VERSION = 2;
 
-    // Read data from file
-    SDL_RWops* file = SDL_RWFromFile(path, "rb");
+struct ColliderSet {
+    std::vector<AABB> colliders;
+    std::vector<AABB> goals[Level::NUM_GOALS];
+};
 
+static void read_collider_set(SDL_RWops* file, ColliderSet& set) {
     size_t num_colliders;
     SDL_RWread(file, &num_colliders, sizeof(num_colliders), 1);
 
-    size_t num_goal_colliders[NUM_GOALS];
+    size_t num_goal_colliders[Level::NUM_GOALS];
     SDL_RWread(file, &num_goal_colliders, sizeof(num_goal_colliders), 1);
 
-    AABB* collider_data = new AABB[num_colliders];
-    SDL_RWread(file, collider_data, sizeof(*collider_data), num_colliders);
+    set.colliders.resize(num_colliders);
+    SDL_RWread(file, set.colliders.data(), sizeof(AABB), num_colliders);
 
-    AABB* goal_collider_data[NUM_GOALS];
-    goal_collider_data[0] = new AABB[num_goal_colliders[0]];
-    goal_collider_data[1] = new AABB[num_goal_colliders[1]];
+    for (size_t n_goal = 0; n_goal < Level::NUM_GOALS; ++n_goal) {
+        set.goals[n_goal].resize(num_goal_colliders[n_goal]);
+        SDL_RWread(file,
+                   set.goals[n_goal].data(),
+                   sizeof(AABB),
+                   num_goal_colliders[n_goal]);
+    }
+}
 
-    SDL_RWread(file,
-               goal_collider_data[0],
-               sizeof(*goal_collider_data[0]),
-               num_goal_colliders[0]);
-    SDL_RWread(file,
-               goal_collider_data[1],
-               sizeof(*goal_collider_data[1]),
-               num_goal_colliders[1]);
+static void write_collider_set(SDL_RWops* file, const ColliderSet& set) {
+    size_t num_colliders = set.colliders.size();
+    SDL_RWwrite(file, &num_colliders, sizeof(num_colliders), 1);
 
-    SDL_RWclose(file);
+    size_t num_goal_colliders[Level::NUM_GOALS];
+    for (size_t n_goal = 0; n_goal < Level::NUM_GOALS; ++n_goal) {
+        num_goal_colliders[n_goal] = set.goals[n_goal].size();
+    }
+    SDL_RWwrite(file, &num_goal_colliders, sizeof(num_goal_colliders), 1);
+
+    SDL_RWwrite(file, set.colliders.data(), sizeof(AABB), num_colliders);
+    for (size_t n_goal = 0; n_goal < Level::NUM_GOALS; ++n_goal) {
+        SDL_RWwrite(file,
+                    set.goals[n_goal].data(),
+                    sizeof(AABB),
+                    num_goal_colliders[n_goal]);
+    }
+}
 
-    // Create list of colliders from data
-    for (size_t i = 0; i < num_colliders; ++i) {
-        colliders.emplace_back(collider_data[i]);
+// Merges boxes into fewer, bigger boxes that cover exactly the same area.
+// A line sweeps up over the box edges. Between two edges, the boxes it
+// crosses are joined into runs as wide as possible, and a run that spans the
+// same as one right below it makes that box taller instead of starting a new
+// one. Only the boxes the line crosses are looked at, so this stays fast for
+// large levels of boxes that don't line up.
+static std::vector<AABB> merge_boxes(const std::vector<AABB>& boxes) {
+    struct Run {
+        float min_x, max_x, min_y;
+    };
+
+    std::vector<float> ys;
+    std::vector<const AABB*> by_bottom;
+    for (const auto& box : boxes) {
+        ys.push_back(box.min(1));
+        ys.push_back(box.max(1));
+        by_bottom.push_back(&box);
     }
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+    std::sort(
+      by_bottom.begin(), by_bottom.end(), [](const AABB* a, const AABB* b) {
+          return a->min(1) < b->min(1);
+      });
+
+    std::vector<AABB> result;
+    std::vector<const AABB*> crossing;
+    std::vector<std::pair<float, float>> spans;
+    std::vector<Run> open, runs;
+    size_t next_box = 0;
+
+    auto close = [&result](const Run& run, float max_y) {
+        glm::vec2 min = { run.min_x, run.min_y };
+        glm::vec2 max = { run.max_x, max_y };
+        result.push_back({ (min + max) * 0.5f, (max - min) * 0.5f });
+    };
+
+    for (float y : ys) {
+        crossing.erase(
+          std::remove_if(crossing.begin(),
+                         crossing.end(),
+                         [y](const AABB* box) { return box->max(1) <= y; }),
+          crossing.end());
+        for (; next_box < by_bottom.size() &&
+               by_bottom[next_box]->min(1) <= y;
+             ++next_box) {
+            crossing.push_back(by_bottom[next_box]);
+        }
+
+        spans.clear();
+        for (const AABB* box : crossing) {
+            spans.push_back({ box->min(0), box->max(0) });
+        }
+        std::sort(spans.begin(), spans.end());
+
+        runs.clear();
+        for (const auto& span : spans) {
+            if (!runs.empty() && span.first <= runs.back().max_x) {
+                runs.back().max_x = std::max(runs.back().max_x, span.second);
+            } else {
+                runs.push_back({ span.first, span.second, y });
+            }
+        }
+
+        // Both lists are sorted, open runs that don't go on end here
+        size_t n_open = 0;
+        for (auto& run : runs) {
+            for (; n_open < open.size() && open[n_open].min_x < run.min_x;
+                 ++n_open) {
+                close(open[n_open], y);
+            }
+            if (n_open < open.size() && open[n_open].min_x == run.min_x &&
+                open[n_open].max_x == run.max_x) {
+                run.min_y = open[n_open].min_y;
+                ++n_open;
+            }
+        }
+        for (; n_open < open.size(); ++n_open) {
+            close(open[n_open], y);
+        }
+        std::swap(open, runs);
+    }
+
+    return result;
+}
+
+void Level::load_from_file(const char* path) {
+    SDL_assert_always(path != nullptr);
+
+    opened_path = std::string(path);
+
+    // Read data from file
+    SDL_RWops* file = SDL_RWFromFile(path, "rb");
+    SDL_assert_always(file);
+
+    u32 magic = 0;
+    SDL_RWread(file, &magic, sizeof(magic), 1);
+
+    ColliderSet loaded_source, loaded_baked;
+    if (magic == LEVEL_FILE_MAGIC) {
+        u32 version;
+        SDL_RWread(file, &version, sizeof(version), 1);
+        SDL_assert_always(version == LEVEL_FILE_VERSION);
+
+        read_collider_set(file, loaded_source);
+        read_collider_set(file, loaded_baked);
+    } else {
+        // Version 1, only the unbaked colliders
+        SDL_RWseek(file, 0, RW_SEEK_SET);
+        read_collider_set(file, loaded_source);
+    }
+
+    SDL_RWclose(file);
+
+    // Create lists of colliders from data
+    const ColliderSet& active =
+      magic == LEVEL_FILE_MAGIC ? loaded_baked : loaded_source;
 
+    colliders.assign(active.colliders.begin(), active.colliders.end());
     for (size_t n_goal = 0; n_goal < NUM_GOALS; ++n_goal) {
-        for (size_t n_coll = 0; n_coll < num_goal_colliders[n_goal]; ++n_coll) {
-            goals[n_goal].colliders.emplace_back(
-              goal_collider_data[n_goal][n_coll]);
+        goals[n_goal].colliders.assign(active.goals[n_goal].begin(),
+                                       active.goals[n_goal].end());
+    }
+
+    baked = magic == LEVEL_FILE_MAGIC;
+    if (baked) {
+        source.colliders = std::move(loaded_source.colliders);
+        for (size_t n_goal = 0; n_goal < NUM_GOALS; ++n_goal) {
+            source.goals[n_goal] = std::move(loaded_source.goals[n_goal]);
         }
     }
 
-    delete[] collider_data;
-    delete[] goal_collider_data[0];
-    delete[] goal_collider_data[1];
+    rebuild_collider_indices();
 
     wall_texture.load_from_file("../assets/ground.png");
 
@@ -112,55 +250,132 @@ void Level::load_from_file(const char* path) {
 }
 
 void Level::save_to_file(const char* path) const {
-    size_t num_colliders                 = colliders.size();
-    size_t num_goal_colliders[NUM_GOALS] = { goals[0].colliders.size(),
-                                             goals[1].colliders.size() };
+    ColliderSet saved_source, saved_baked;
+    if (baked) {
+        saved_source.colliders = source.colliders;
+        saved_baked.colliders.assign(colliders.begin(), colliders.end());
+        for (size_t n_goal = 0; n_goal < NUM_GOALS; ++n_goal) {
+            saved_source.goals[n_goal] = source.goals[n_goal];
+            saved_baked.goals[n_goal].assign(goals[n_goal].colliders.begin(),
+                                             goals[n_goal].colliders.end());
+        }
+    } else {
+        saved_source.colliders.assign(colliders.begin(), colliders.end());
+        saved_baked.colliders = merge_boxes(saved_source.colliders);
+        for (size_t n_goal = 0; n_goal < NUM_GOALS; ++n_goal) {
+            saved_source.goals[n_goal].assign(goals[n_goal].colliders.begin(),
+                                              goals[n_goal].colliders.end());
+            saved_baked.goals[n_goal] =
+              merge_boxes(saved_source.goals[n_goal]);
+        }
+    }
+
+    SDL_RWops* file = SDL_RWFromFile(path, "wb");
+    SDL_assert_always(file);
+    SDL_RWwrite(file, &LEVEL_FILE_MAGIC, sizeof(LEVEL_FILE_MAGIC), 1);
+    SDL_RWwrite(file, &LEVEL_FILE_VERSION, sizeof(LEVEL_FILE_VERSION), 1);
+    write_collider_set(file, saved_source);
+    write_collider_set(file, saved_baked);
+    SDL_RWclose(file);
+}
 
-    AABB* collider_data = new AABB[num_colliders];
+void Level::bake() {
+    if (baked) { return; }
 
-    size_t i = 0;
-    for (const auto& coll : colliders) {
-        collider_data[i].center   = coll.center;
-        collider_data[i].half_ext = coll.half_ext;
-        ++i;
+    size_t num_before = colliders.size();
+    source.colliders.assign(colliders.begin(), colliders.end());
+    std::vector<AABB> merged = merge_boxes(source.colliders);
+    colliders.assign(merged.begin(), merged.end());
+    size_t num_after = colliders.size();
+
+    for (size_t n_goal = 0; n_goal < NUM_GOALS; ++n_goal) {
+        auto& goal_colliders = goals[n_goal].colliders;
+        num_before += goal_colliders.size();
+
+        source.goals[n_goal].assign(goal_colliders.begin(),
+                                    goal_colliders.end());
+        merged = merge_boxes(source.goals[n_goal]);
+        goal_colliders.assign(merged.begin(), merged.end());
+        num_after += goal_colliders.size();
     }
 
-    std::array<AABB*, NUM_GOALS> goal_collider_data;
-    goal_collider_data[0] = new AABB[num_goal_colliders[0]];
-    goal_collider_data[1] = new AABB[num_goal_colliders[1]];
+    baked = true;
+    rebuild_collider_indices();
 
-    i = 0;
-    for (const auto& coll : goals[0].colliders) {
-        goal_collider_data[0][i].center   = coll.center;
-        goal_collider_data[0][i].half_ext = coll.half_ext;
-        ++i;
+    printf_s("[LEVEL] Baked %zd colliders into %zd.\n", num_before, num_after);
+}
+
+bool Level::is_baked() const noexcept { return baked; }
+
+bool Level::unbake() {
+    if (!baked) { return false; }
+
+    colliders.assign(source.colliders.begin(), source.colliders.end());
+    for (size_t n_goal = 0; n_goal < NUM_GOALS; ++n_goal) {
+        goals[n_goal].colliders.assign(source.goals[n_goal].begin(),
+                                       source.goals[n_goal].end());
     }
 
-    i = 0;
-    for (const auto& coll : goals[1].colliders) {
-        goal_collider_data[1][i].center   = coll.center;
-        goal_collider_data[1][i].half_ext = coll.half_ext;
-        ++i;
+    baked = false;
+    rebuild_collider_indices();
+    return true;
+}
+
+AABB* Level::add_collider(const AABB& box, u32 group) {
+    AABB* result;
+    if (group == ColliderTree::LEVEL) {
+        result = &colliders.emplace_front(box);
+    } else if (group == ColliderTree::goal_group(0)) {
+        result = &goals[0].colliders.emplace_front(box);
+    } else {
+        SDL_assert(group == ColliderTree::goal_group(1));
+        result = &goals[1].colliders.emplace_front(box);
     }
 
+    collider_tree.insert(result, group);
+    if (group == ColliderTree::LEVEL) { ground_index.insert(result); }
+    return result;
+}
 
-    SDL_RWops* file = SDL_RWFromFile(path, "wb");
-    SDL_RWwrite(file, &num_colliders, sizeof(num_colliders), 1);
-    SDL_RWwrite(file, &num_goal_colliders, sizeof(num_goal_colliders), 1);
-    SDL_RWwrite(file, collider_data, sizeof(*collider_data), num_colliders);
-    SDL_RWwrite(file,
-                goal_collider_data[0],
-                sizeof(*goal_collider_data[0]),
-                num_goal_colliders[0]);
-    SDL_RWwrite(file,
-                goal_collider_data[1],
-                sizeof(*goal_collider_data[1]),
-                num_goal_colliders[1]);
-    SDL_RWclose(file);
+void Level::remove_collider(const AABB* box) {
+    collider_tree.remove(box);
+    if (ground_index.contains(box)) { ground_index.remove(box); }
+
+    // Remove by address, there might be other colliders that are equal to box
+    auto remove_from = [box](std::list<AABB>& list) {
+        list.remove_if([box](const AABB& coll) { return &coll == box; });
+    };
+    remove_from(colliders);
+    for (auto& goal : goals) {
+        remove_from(goal.colliders);
+    }
+}
+
+void Level::collider_changed(const AABB* box) {
+    collider_tree.update(box);
+    if (ground_index.contains(box)) { ground_index.update(box); }
+}
+
+AABB* Level::find_collider_at(Point p) {
+    // The tree only hands out const pointers, but all the colliders are owned
+    // by this level.
+    return const_cast<AABB*>(collider_tree.find_at(p));
+}
 
-    delete[] collider_data;
-    delete[] goal_collider_data[0];
-    delete[] goal_collider_data[1];
+void Level::rebuild_collider_indices() {
+    std::vector<ColliderTree::Entry> entries;
+    std::vector<const AABB*> ground;
+    for (const auto& coll : colliders) {
+        entries.push_back({ &coll, ColliderTree::LEVEL });
+        ground.push_back(&coll);
+    }
+    for (size_t n_goal = 0; n_goal < NUM_GOALS; ++n_goal) {
+        for (const auto& coll : goals[n_goal].colliders) {
+            entries.push_back({ &coll, ColliderTree::goal_group(n_goal) });
+        }
+    }
+    collider_tree.build(entries);
+    ground_index.build(ground);
 }
 
 static constexpr float SCROLL_SPEED = 1.0f;
@@ -171,8 +386,14 @@ void LevelEditor::init(Level* level_) {
 
 bool LevelEditor::update(const Renderer& renderer,
                          const MouseKeyboardInput& input) {
-    bool keep_open  = true;
-    auto& colliders = level->colliders;
+    bool keep_open = true;
+
+    // Edit the colliders as they were authored, the level gets baked again
+    // when the game continues
+    if (level->unbake()) {
+        selected_collider = nullptr;
+        dragging_collider = false;
+    }
 
     {  // UI
         using namespace ImGui;
@@ -187,17 +408,19 @@ bool LevelEditor::update(const Renderer& renderer,
         NewLine();
 
         if (Button("New collider")) {
-            selected_collider = &colliders.emplace_front(
-              AABB { renderer.camera_center(), new_collider_dimensions });
+            selected_collider = level->add_collider(
+              AABB { renderer.camera_center(), new_collider_dimensions },
+              ColliderTree::LEVEL);
         }
         if (Button("New goal collider")) {
-            selected_collider =
-              &level->goals[selected_team].colliders.emplace_front(
-                AABB { renderer.camera_center(), new_collider_dimensions });
+            selected_collider = level->add_collider(
+              AABB { renderer.camera_center(), new_collider_dimensions },
+              ColliderTree::goal_group(selected_team));
         }
 
         InputInt("Team", &selected_team);
-        glm::clamp(selected_team, 0, static_cast<const int>(Level::NUM_GOALS));
+        selected_team = glm::clamp(
+          selected_team, 0, static_cast<int>(Level::NUM_GOALS) - 1);
 
         DragFloat2("Dimensions",
                    value_ptr(new_collider_dimensions),
@@ -209,18 +432,19 @@ bool LevelEditor::update(const Renderer& renderer,
         NewLine();
         Text("Selected Collider");
         if (selected_collider) {
-            DragFloat2("Position",
-                       value_ptr(selected_collider->center),
-                       1.0f,
-                       0.0f,
-                       0.0f,
-                       "% 6.1f");
-            DragFloat2("Half ext.",
-                       value_ptr(selected_collider->half_ext),
-                       0.1f,
-                       0.0f,
-                       0.0f,
-                       "% 6.1f");
+            bool changed = DragFloat2("Position",
+                                      value_ptr(selected_collider->center),
+                                      1.0f,
+                                      0.0f,
+                                      0.0f,
+                                      "% 6.1f");
+            changed |= DragFloat2("Half ext.",
+                                  value_ptr(selected_collider->half_ext),
+                                  0.1f,
+                                  0.0f,
+                                  0.0f,
+                                  "% 6.1f");
+            if (changed) { level->collider_changed(selected_collider); }
 
         } else {
             Text("None");
@@ -231,28 +455,10 @@ bool LevelEditor::update(const Renderer& renderer,
 
     // Select collider
     if (input.mouse_button_down(MouseButton::LEFT)) {
-        glm::vec2 mouse_pos = input.mouse_pos_world();
-
-        for (auto& coll : colliders) {
-            if (test_point_AABB(mouse_pos, coll)) {
-                dragging_collider = true;
-                selected_collider = &coll;
-                break;
-            }
-        }
-        for (auto& coll : level->goals[0].colliders) {
-            if (test_point_AABB(mouse_pos, coll)) {
-                dragging_collider = true;
-                selected_collider = &coll;
-                break;
-            }
-        }
-        for (auto& coll : level->goals[1].colliders) {
-            if (test_point_AABB(mouse_pos, coll)) {
-                dragging_collider = true;
-                selected_collider = &coll;
-                break;
-            }
+        AABB* coll = level->find_collider_at(input.mouse_pos_world());
+        if (coll) {
+            dragging_collider = true;
+            selected_collider = coll;
         }
     }
     if (input.mouse_button_up(MouseButton::LEFT)) { dragging_collider = false; }
@@ -263,19 +469,24 @@ bool LevelEditor::update(const Renderer& renderer,
     }
 
     if (selected_collider) {
+        bool collider_changed = false;
 
-        selected_collider->half_ext += input.mouse_wheel_scroll * SCROLL_SPEED;
+        if (input.mouse_wheel_scroll != 0) {
+            selected_collider->half_ext +=
+              input.mouse_wheel_scroll * SCROLL_SPEED;
+            collider_changed = true;
+        }
 
-        if (dragging_collider) {
+        if (dragging_collider && input.mouse_move_world() != glm::vec2(0.0f)) {
             selected_collider->center += input.mouse_move_world();
+            collider_changed = true;
         }
 
+        if (collider_changed) { level->collider_changed(selected_collider); }
+
         // Remove at the end so the other operations can happen before
         if (input.key_down(SDL_SCANCODE_DELETE)) {
-            // @CLEANUP
-            colliders.remove(*selected_collider);
-            level->goals[0].colliders.remove(*selected_collider);
-            level->goals[1].colliders.remove(*selected_collider);
+            level->remove_collider(selected_collider);
 
             selected_collider = nullptr;
             dragging_collider = false;
@@ -285,6 +496,7 @@ bool LevelEditor::update(const Renderer& renderer,
     return keep_open;
 }
 
+#ifndef HEADLESS
 void LevelEditor::render(const Renderer& renderer) {
     if (selected_collider) {
         renderer.debug_shader.set_color(Color::LIGHT_BLUE);
@@ -293,6 +505,7 @@ void LevelEditor::render(const Renderer& renderer) {
         renderer.debug_shader.SQUARE_VAO.draw(GL_LINE_LOOP);
     }
 }
+#endif
 
 void LevelEditor::save_to_file(bool new_file_name) {
     if (new_file_name || level->opened_path.empty()) {
@@ -312,4 +525,8 @@ void LevelEditor::load_from_file(bool new_file_name) {
 
     SDL_assert(level);
     level->load_from_file(new_path.c_str());
+
+    // The old colliders are gone
+    selected_collider = nullptr;
+    dragging_collider = false;
 }
\ No newline at end of file
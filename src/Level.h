@@ -1,6 +1,9 @@
 #pragma once
 #include <list>
+#include <vector>
 #include "Collider.h"
+#include "ColliderTree.h"
+#include "GroundIndex.h"
 #include "rendering/Texture.h"
 
 class Renderer;
@@ -19,6 +22,14 @@ class Level {
     std::list<AABB> colliders;
     Texture wall_texture;
 
+    // Bounding volume hierarchy over colliders and all goal colliders. Use
+    // the editing functions below to change colliders so it and ground_index
+    // stay up to date.
+    ColliderTree collider_tree;
+
+    // Column index over colliders (not goals) for the ground queries below.
+    GroundIndex ground_index;
+
     struct {
         std::list<AABB> colliders;
         Texture texture;
@@ -28,18 +39,52 @@ class Level {
 
     void render(const Renderer& renderer) const;
 
+    // Replaces colliders and goal colliders with the smallest set of boxes
+    // (found greedily) that covers the same area per group, keeping the
+    // originals as source. Saved levels are loaded baked.
+    void bake();
+    bool is_baked() const noexcept;
+
+    // Returns the highest collider below position or nullptr.
     const AABB* find_ground_under(glm::vec2 position) const;
 
+    // Returns the point on top of the highest collider at x or (x, 0) if
+    // there is none.
+    glm::vec2 find_highest_ground_at(float x) const;
+
     void save_to_file(const char* path) const;
     void load_from_file(const char* path);
 
+  private:
+    // The colliders as authored in the LevelEditor while the level is baked
+    struct {
+        std::vector<AABB> colliders;
+        std::vector<AABB> goals[NUM_GOALS];
+    } source;
+    bool baked = false;
+
+    // Swaps the source colliders back in for editing. Returns false if the
+    // level wasn't baked.
+    bool unbake();
+
+    // Adds a collider to the group (see ColliderTree) and returns it.
+    AABB* add_collider(const AABB& box, u32 group);
+    void remove_collider(const AABB* box);
+
+    // Has to be called after a collider was moved or resized.
+    void collider_changed(const AABB* box);
+
+    AABB* find_collider_at(Point p);
+
+    void rebuild_collider_indices();
+
     // Let the LevelEditor access our private members so it can manipulate them.
     friend LevelEditor;
 };
 
 class LevelEditor {
     Level* level;
-    AABB* selected_collider;
+    AABB* selected_collider = nullptr;
 
     glm::vec2 new_collider_dimensions = glm::vec2(100.0f);
 
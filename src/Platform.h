@@ -0,0 +1,38 @@
+#pragma once
+
+// The code uses the bounds checked functions of the MSVC runtime. Everywhere
+// else they are mapped to their standard counterparts, so the simulation can
+// be built headless on other platforms.
+
+#ifndef _MSC_VER
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+// windows.h brings min and max as macros, some code (and the assimp headers)
+// use them unqualified
+using std::max;
+using std::min;
+
+#define printf_s printf
+#define memcpy_s(dest, dest_size, src, count) memcpy(dest, src, count)
+
+inline int sprintf_s(char* buffer, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = vsnprintf(buffer, size, format, args);
+    va_end(args);
+    return result;
+}
+
+template<size_t size>
+int sprintf_s(char (&buffer)[size], const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = vsnprintf(buffer, size, format, args);
+    va_end(args);
+    return result;
+}
+#endif
@@ -2,58 +2,168 @@
 #include "Player.h"
 #include "Game.h"
 #include "Collider.h"
+#include "Level.h"
+#include "Snapshot.h"
+#include "RenderState.h"
+#include "Profiler.h"
 #include <imgui/imgui.h>
 #include <glm/gtc/type_ptr.hpp>
 
-float Player::GROUND_HOVER_DISTANCE = 160.0f;
-float Player::JUMP_FORCE            = 30.0f;
-float Player::DOUBLE_JUMP_FORCE     = 15.0f;
-float Player::GRAVITY               = 2.0f;
-
-float Player::WALL_JUMP_FORCE           = 15.0f;
-float Player::MAX_WALL_JUMP_COYOTE_TIME = 5.0f;
-
-float Player::WALL_SLIDE_SPEED     = 5.0f;
-float Player::MAX_WALL_SLIDE_SPEED = 15.0f;
-
-float Player::WALK_ACCELERATION = 1.0f;
-float Player::MAX_WALK_VELOCITY = 10.0f;
-
-float Player::MAX_AIR_ACCELERATION = 0.5f;
-float Player::MAX_AIR_VELOCITY     = 10.0f;
-
-float Player::HIT_SPEED_MULTIPLIER        = 0.2f;
-float Player::MAX_HIT_COOLDOWN            = 30.0f;
-float Player::MAX_HIT_TRAIL_ANGLE         = PI / 2.0f;
-float Player::MAX_HIT_TRAIL_LENGTH        = 200.0f;
-float Player::HITSTUN_DURATION_MULTIPLIER = 0.8f;
-
 static const struct {
     u32 jump     = SDL_CONTROLLER_BUTTON_RIGHTSHOULDER;
     u32 jump_alt = SDL_CONTROLLER_BUTTON_A;
 } button_map;
 
+void PlayerModel::load(const char* texture_path, const char* model_path) {
+    texture.load_from_file(texture_path);
+    load_character_model_from_file(model_path, body_mesh, rigged_mesh);
+}
+
+void PlayerKinematics::reset(size_t num_players) {
+    velocities.assign(num_players, glm::vec2(0.0f));
+    states.assign(num_players, FALLING);
+    grounded.assign(num_players, 0);
+    can_double_jump.assign(num_players, 0);
+    wall_directions.assign(num_players, Direction::NONE);
+
+    hit_cooldowns.assign(num_players, 0.0f);
+    hitstun_durations.assign(num_players, 0.0f);
+    carried_bounce_times.assign(num_players, 0.0f);
+    freeze_durations.assign(num_players, 0.0f);
+    wall_jump_coyote_times.assign(num_players, 0.0f);
+}
+
 void Player::init(glm::vec3 position,
                   glm::vec3 scale_,
-                  const char* texture_path,
-                  const char* model_path,
+                  const PlayerModel& player_model,
                   const Gamepad* pad,
-                  const std::list<AABB>& colliders) {
+                  const PlayerConfig* player_config,
+                  PlayerKinematics* player_kinematics,
+                  size_t player_index,
+                  const Level& level) {
     Entity::init(position, scale_);
-    texture.load_from_file(texture_path);
-    load_character_model_from_file(model_path, body_mesh, rigged_mesh);
-    animator.init(this, rigged_mesh, colliders);
+    rigged_mesh = player_model.rigged_mesh;
+    animator.init(this, rigged_mesh, level);
+    rigged_mesh.store_pose(last_tick_pose);
     SDL_assert(pad);
     gamepad = pad;
+    SDL_assert(player_config);
+    config = player_config;
+    SDL_assert(player_kinematics
+               && player_index < player_kinematics->states.size());
+    kinematics = player_kinematics;
+    index      = player_index;
+
+    weapon_trail.init(&config->max_hit_trail_angle,
+                      &config->max_hit_trail_length);
+}
+
+void Player::begin_tick() {
+    Entity::begin_tick();
+    rigged_mesh.store_pose(last_tick_pose);
+}
+
+void Player::save(PlayerSnapshot& snapshot) const {
+    const PlayerKinematics& k = *kinematics;
+
+    snapshot.position           = position_;
+    snapshot.last_tick_position = last_tick_position_;
+    snapshot.scale              = scale;
+    snapshot.velocity           = k.velocities[index];
+
+    snapshot.state           = k.states[index];
+    snapshot.grounded        = k.grounded[index];
+    snapshot.facing_right    = facing_right;
+    snapshot.can_double_jump = k.can_double_jump[index];
+    snapshot.wall_direction  = static_cast<u32>(k.wall_directions[index]);
+
+    snapshot.hit_cooldown          = k.hit_cooldowns[index];
+    snapshot.hitstun_duration      = k.hitstun_durations[index];
+    snapshot.carried_bounce_time   = k.carried_bounce_times[index];
+    snapshot.freeze_duration       = k.freeze_durations[index];
+    snapshot.wall_jump_coyote_time = k.wall_jump_coyote_times[index];
+
+    snapshot.weapon_collider      = weapon_collider;
+    snapshot.last_weapon_collider = last_weapon_collider;
+
+    const auto& bones = rigged_mesh.bones;
+    SDL_assert(bones.size() <= PlayerSnapshot::MAX_BONES);
+    SDL_assert(last_tick_pose.size() == bones.size());
+
+    snapshot.num_bones = static_cast<u32>(bones.size());
+    size_t i           = 0;
+    for (; i < bones.size(); ++i) {
+        snapshot.pose[i]           = { bones[i].rotation, bones[i].length };
+        snapshot.last_tick_pose[i] = last_tick_pose[i];
+    }
+    for (; i < PlayerSnapshot::MAX_BONES; ++i) {
+        snapshot.pose[i]           = { 0.0f, 0.0f };
+        snapshot.last_tick_pose[i] = { 0.0f, 0.0f };
+    }
 
-    weapon_trail.init(&MAX_HIT_TRAIL_ANGLE, &MAX_HIT_TRAIL_LENGTH);
+    animator.save(snapshot.animator);
+    weapon_trail.save(snapshot.weapon_trail);
 }
 
-void Player::update(float delta_time, const std::list<AABB>& colliders) {
+void Player::restore(const PlayerSnapshot& snapshot) {
+    PlayerKinematics& k = *kinematics;
+
+    position_           = snapshot.position;
+    last_tick_position_ = snapshot.last_tick_position;
+    scale               = snapshot.scale;
+    k.velocities[index] = snapshot.velocity;
+
+    k.states[index] = static_cast<PlayerKinematics::State>(snapshot.state);
+    facing_right    = snapshot.facing_right != 0;
+
+    k.grounded[index]        = snapshot.grounded != 0;
+    k.can_double_jump[index] = snapshot.can_double_jump != 0;
+    k.wall_directions[index] =
+      static_cast<Direction>(snapshot.wall_direction);
+
+    k.hit_cooldowns[index]          = snapshot.hit_cooldown;
+    k.hitstun_durations[index]      = snapshot.hitstun_duration;
+    k.carried_bounce_times[index]   = snapshot.carried_bounce_time;
+    k.freeze_durations[index]       = snapshot.freeze_duration;
+    k.wall_jump_coyote_times[index] = snapshot.wall_jump_coyote_time;
+
+    weapon_collider      = snapshot.weapon_collider;
+    last_weapon_collider = snapshot.last_weapon_collider;
+
+    // Snapshots only fit the model they were taken from
+    auto& bones = rigged_mesh.bones;
+    SDL_assert(snapshot.num_bones == bones.size());
+    SDL_assert(last_tick_pose.size() == bones.size());
+    for (size_t i = 0; i < bones.size(); ++i) {
+        bones[i].rotation = snapshot.pose[i].rotation;
+        bones[i].length   = snapshot.pose[i].length;
+        last_tick_pose[i] = snapshot.last_tick_pose[i];
+    }
+
+    animator.restore(snapshot.animator);
+    weapon_trail.restore(snapshot.weapon_trail);
+
+    update_model_matrix();
+}
+
+void Player::update(float delta_time,
+                    const Level& level,
+                    ThreadPool* jobs) {
+    PROFILE_SCOPE("Player::update");
+    PlayerKinematics& k            = *kinematics;
+    glm::vec2& velocity            = k.velocities[index];
+    PlayerKinematics::State& state = k.states[index];
+    u8& grounded                   = k.grounded[index];
+    u8& can_double_jump            = k.can_double_jump[index];
+    const Direction wall_direction = k.wall_directions[index];
+    float& hit_cooldown            = k.hit_cooldowns[index];
+    float& hitstun_duration        = k.hitstun_durations[index];
+    float& wall_jump_coyote_time   = k.wall_jump_coyote_times[index];
+
     if (hit_cooldown > 0.0f) hit_cooldown -= delta_time;
-    if (wall_jump_cotyote_time > 0.0f) wall_jump_cotyote_time -= delta_time;
+    if (wall_jump_coyote_time > 0.0f) wall_jump_coyote_time -= delta_time;
 
-    if (state == HITSTUN) {
+    if (state == PlayerKinematics::HITSTUN) {
         hitstun_duration -= delta_time;
 
         if (hitstun_duration > 0.0f) {
@@ -61,7 +171,7 @@ void Player::update(float delta_time, const std::list<AABB>& colliders) {
             return;
         } else {
             hitstun_duration = 0.0f;
-            state            = FALLING;
+            state            = PlayerKinematics::FALLING;
             grounded         = false;
         }
     }
@@ -76,32 +186,34 @@ void Player::update(float delta_time, const std::list<AABB>& colliders) {
     }
 
     // Movement
-    if (state == STANDING || state == WALKING) {
+    if (state == PlayerKinematics::STANDING
+        || state == PlayerKinematics::WALKING) {
         SDL_assert(grounded);
-        float target_velocity_x = left_stick_input.x * MAX_WALK_VELOCITY;
+        float target_velocity_x =
+          left_stick_input.x * config->max_walk_velocity;
 
         if (velocity.x > target_velocity_x) {
-            velocity.x =
-              glm::max(target_velocity_x, velocity.x - WALK_ACCELERATION);
+            velocity.x = glm::max(target_velocity_x,
+                                  velocity.x - config->walk_acceleration);
         } else if (velocity.x < target_velocity_x) {
-            velocity.x =
-              glm::min(target_velocity_x, velocity.x + WALK_ACCELERATION);
+            velocity.x = glm::min(target_velocity_x,
+                                  velocity.x + config->walk_acceleration);
         }
 
         if (left_stick_input.x != 0.0f) {
-            state = WALKING;
+            state = PlayerKinematics::WALKING;
         } else {
-            state = STANDING;
+            state = PlayerKinematics::STANDING;
         }
 
         if (gamepad->button_down(button_map.jump)
             || gamepad->button_down(button_map.jump_alt)) {
-            velocity.y = JUMP_FORCE;
+            velocity.y = config->jump_force;
 
-            state    = FALLING;
+            state    = PlayerKinematics::FALLING;
             grounded = false;
         }
-    } else if (state == WALL_CLING) {
+    } else if (state == PlayerKinematics::WALL_CLING) {
         const bool pushing_towards_wall =
           (wall_direction == Direction::LEFT && left_stick_input.x < 0.0f)
           || (wall_direction == Direction::RIGHT && left_stick_input.x > 0.0f);
@@ -110,36 +222,39 @@ void Player::update(float delta_time, const std::list<AABB>& colliders) {
             velocity.y = 0.0f;
 
         } else if (left_stick_input.y < 0.0f) {
-            velocity.y = -WALL_SLIDE_SPEED
-                       + (left_stick_input.y
-                          * (MAX_WALL_SLIDE_SPEED - WALL_SLIDE_SPEED));
+            velocity.y =
+              -config->wall_slide_speed
+              + (left_stick_input.y
+                 * (config->max_wall_slide_speed - config->wall_slide_speed));
 
         } else {
-            velocity.y = -WALL_SLIDE_SPEED;
+            velocity.y = -config->wall_slide_speed;
         }
 
         if ((wall_direction == Direction::LEFT && left_stick_input.x > 0.2f)
             || (wall_direction == Direction::RIGHT
                 && left_stick_input.x < -0.2f)) {
-            wall_jump_cotyote_time = MAX_WALL_JUMP_COYOTE_TIME;
-            velocity.y             = 0.0f;
-            state                  = FALLING;
+            wall_jump_coyote_time = config->max_wall_jump_coyote_time;
+            velocity.y            = 0.0f;
+            state                 = PlayerKinematics::FALLING;
         }
-    } else if (state == FALLING) {
+    } else if (state == PlayerKinematics::FALLING) {
         SDL_assert(!grounded);
 
         float target_velocity_x =
-          velocity.x + left_stick_input.x * MAX_AIR_ACCELERATION;
+          velocity.x + left_stick_input.x * config->max_air_acceleration;
 
         if (left_stick_input.x > 0.0f) {
-            if (velocity.x < MAX_AIR_VELOCITY) {
-                velocity.x = glm::min(target_velocity_x, MAX_AIR_VELOCITY);
+            if (velocity.x < config->max_air_velocity) {
+                velocity.x =
+                  glm::min(target_velocity_x, config->max_air_velocity);
             } else {
                 velocity.x = glm::min(target_velocity_x, velocity.x);
             }
         } else {
-            if (velocity.x > -MAX_AIR_VELOCITY) {
-                velocity.x = glm::max(target_velocity_x, -MAX_AIR_VELOCITY);
+            if (velocity.x > -config->max_air_velocity) {
+                velocity.x =
+                  glm::max(target_velocity_x, -config->max_air_velocity);
             } else {
                 velocity.x = glm::max(target_velocity_x, velocity.x);
             }
@@ -148,8 +263,8 @@ void Player::update(float delta_time, const std::list<AABB>& colliders) {
         if (can_double_jump
             && (gamepad->button_down(button_map.jump)
                 || gamepad->button_down(button_map.jump_alt))) {
-            velocity.x = left_stick_input.x * MAX_AIR_VELOCITY;
-            velocity.y = DOUBLE_JUMP_FORCE;
+            velocity.x = left_stick_input.x * config->max_air_velocity;
+            velocity.y = config->double_jump_force;
 
             can_double_jump = false;
         }
@@ -163,17 +278,18 @@ void Player::update(float delta_time, const std::list<AABB>& colliders) {
           || (wall_direction == Direction::RIGHT && left_stick_input.x < -0.0f);
 
         if (jump_button_down && pushing_away_from_wall
-            && wall_jump_cotyote_time > 0.0f && left_stick_input.y >= 0.0f) {
+            && wall_jump_coyote_time > 0.0f && left_stick_input.y >= 0.0f) {
 
-            velocity = glm::normalize(left_stick_input) * WALL_JUMP_FORCE;
-            state    = FALLING;
+            velocity =
+              glm::normalize(left_stick_input) * config->wall_jump_force;
+            state = PlayerKinematics::FALLING;
         }
     }
 
     // Leg and weapon animation
     last_weapon_collider = weapon_collider;
     animator.update(
-      delta_time, velocity.x, gamepad->stick(StickID::RIGHT), colliders);
+      delta_time, velocity.x, gamepad->stick(StickID::RIGHT), level, jobs);
     auto weapon = animator.weapon();
     {
         glm::vec2 head_world = local_to_world_space(weapon->head());
@@ -185,6 +301,28 @@ void Player::update(float delta_time, const std::list<AABB>& colliders) {
     weapon_trail.update(weapon->tail());
 }
 
+void Player::write_render_state(PlayerRenderState& render_state,
+                                float alpha) const {
+    render_state.model        = interpolated_model_matrix(alpha);
+    render_state.facing_right = facing_right;
+
+    SDL_assert(rigged_mesh.bones.size() <= RiggedShader::NUMBER_OF_BONES);
+    rigged_mesh.interpolated_transforms(
+      last_tick_pose, alpha, render_state.bone_transforms.data());
+
+    render_state.body_collider = body_collider();
+
+    for (size_t leg = 0; leg < 2; ++leg) {
+        const vec2* points = animator.limbs[leg].spline.points();
+        for (size_t i = 0; i < Spline::NUM_POINTS; ++i) {
+            render_state.leg_spline_points[leg][i] = points[i];
+        }
+    }
+
+    render_state.num_trail_vertices =
+      weapon_trail.write_vertices(render_state.trail_vertices.data());
+}
+
 bool Player::is_facing_right() const noexcept {
     return facing_right;
 }
@@ -207,26 +345,43 @@ bool Player::display_debug_ui(size_t player_index) {
         Begin(window_name, &keep_open);
     }
 
+    PlayerKinematics& k = *kinematics;
+
     PushItemWidth(150);
     DragFloat2("position", value_ptr(position_), 1.0f, 0.0f, 0.0f, "%.2f");
-    DragFloat2("velocity", value_ptr(velocity), 1.0f, 0.0f, 0.0f, "%.2f");
+    DragFloat2("velocity",
+               value_ptr(k.velocities[index]),
+               1.0f,
+               0.0f,
+               0.0f,
+               "%.2f");
 
-    Checkbox("grounded", &grounded);
+    {
+        bool grounded = k.grounded[index] != 0;
+        if (Checkbox("grounded", &grounded)) { k.grounded[index] = grounded; }
+    }
 
     {
         const char* items[] = {
             "STANDING", "WALKING", "FALLING", "HITSTUN", "WALL_CLING"
         };
-        int current_state = static_cast<int>(state);
+        int current_state = static_cast<int>(k.states[index]);
         if (Combo("state", &current_state, items, IM_ARRAYSIZE(items))) {
-            state = static_cast<State>(current_state);
+            k.states[index] =
+              static_cast<PlayerKinematics::State>(current_state);
         }
     }
 
     Checkbox("facing_right", &facing_right);
 
-    DragFloat("hit_cooldown", &hit_cooldown, 1.0f, 0.0f, 0.0f, "%.2f");
-    DragFloat("hitstun_duration", &hitstun_duration, 1.0f, 0.0f, 0.0f, "%.2f");
+    DragFloat(
+      "hit_cooldown", &k.hit_cooldowns[index], 1.0f, 0.0f, 0.0f, "%.2f");
+    DragFloat("hitstun_duration",
+              &k.hitstun_durations[index],
+              1.0f,
+              0.0f,
+              0.0f,
+              "%.2f");
     DragFloat("max_weapon_length", &animator.max_weapon_length);
     float current_length =
       glm::length(animator.weapon()->tail() - animator.weapon()->head());
@@ -9,78 +9,130 @@
 #include "WeaponTrail.h"
 
 class Gamepad;
+class ThreadPool;
 class ConfigLoader;
 struct AABB;
-
-class Player : public Entity {
+class Level;
+class World;
+struct PlayerSnapshot;
+struct PlayerRenderState;
+
+// Configurable constants, every World has its own set
+struct PlayerConfig {
+    float ground_hover_distance = 160.0f;
+    float jump_force            = 30.0f;
+    float double_jump_force     = 15.0f;
+    float gravity               = 2.0f;
+
+    float wall_jump_force           = 15.0f;
+    float max_wall_jump_coyote_time = 5.0f;
+
+    float wall_slide_speed     = 5.0f;
+    float max_wall_slide_speed = 15.0f;
+
+    float walk_acceleration = 1.0f;
+    float max_walk_velocity = 10.0f;
+
+    float max_air_acceleration = 0.5f;
+    float max_air_velocity     = 10.0f;
+
+    float hit_speed_multiplier        = 0.2f;
+    float max_hit_cooldown            = 30.0f;
+    float max_hit_trail_angle         = PI / 2.0f;
+    float max_hit_trail_length        = 200.0f;
+    float hitstun_duration_multiplier = 0.8f;
+
+    // Like the ball's, for players bouncing off of walls in hitstun
+    s32 max_bounces_per_tick = 5;
+};
+
+// What all players look like. Loaded once per World, players only keep a copy
+// of the bones to pose them.
+struct PlayerModel {
     Texture texture;
     Mesh body_mesh;
-    RiggedMesh rigged_mesh;
-    Animator animator;
-    const Gamepad* gamepad;
+    RiggedMesh rigged_mesh;  // In bind pose
 
-    Circle body_collider_ = { glm::vec2(0.0f), 1.0f };
-
-    glm::vec2 velocity = glm::vec2(0.0f);  // In world space
-
-    bool grounded     = false;
-    bool facing_right = true;
-
-    float hit_cooldown     = 0.0f;
-    float hitstun_duration = 0.0f;
-
-    float freeze_duration = 0.0f;
-
-    bool can_double_jump         = false;
-    Direction wall_direction     = Direction::NONE;
-    float wall_jump_cotyote_time = 0.0f;
+    void load(const char* texture_path, const char* model_path);
+};
 
+// How all players of a World move, everything that changes every tick apart
+// from their meshes and animation. One array per field, indexed like
+// World::players, so the phases of World::simulate() only go through the
+// fields they need. The position stays in the Entity, the animator and
+// colliders are placed with its model matrix.
+struct PlayerKinematics {
     enum State {
         STANDING   = 0,
         WALKING    = 1,
         FALLING    = 2,
         HITSTUN    = 3,
         WALL_CLING = 4
-    } state = FALLING;
+    };
 
-    // These are in world space!
-    Segment weapon_collider, last_weapon_collider;
+    std::vector<glm::vec2> velocities;  // In world space
+    std::vector<State> states;
+    std::vector<u8> grounded;
+    std::vector<u8> can_double_jump;
+    std::vector<Direction> wall_directions;
 
-    WeaponTrail weapon_trail;
+    std::vector<float> hit_cooldowns;
+    std::vector<float> hitstun_durations;
 
-    // Connfigurable constants
-    static float GROUND_HOVER_DISTANCE;
-    static float JUMP_FORCE;
-    static float DOUBLE_JUMP_FORCE;
-    static float GRAVITY;
+    // Hitstun bounce time the last tick ran out of iterations for
+    std::vector<float> carried_bounce_times;
 
-    static float WALL_JUMP_FORCE;
-    static float MAX_WALL_JUMP_COYOTE_TIME;
+    std::vector<float> freeze_durations;
+    std::vector<float> wall_jump_coyote_times;
 
-    static float WALL_SLIDE_SPEED;
-    static float MAX_WALL_SLIDE_SPEED;
+    // Every player starts out falling and standing still
+    void reset(size_t num_players);
+};
 
-    static float WALK_ACCELERATION;
-    static float MAX_WALK_VELOCITY;
+class Player : public Entity {
+    RiggedMesh rigged_mesh;  // Vertex arrays shared with the PlayerModel
+    Animator animator;
+    const Gamepad* gamepad;
+
+    Circle body_collider_ = { glm::vec2(0.0f), 1.0f };
+
+    bool facing_right = true;
+
+    // Owned by the World, this player's fields are at index
+    PlayerKinematics* kinematics = nullptr;
+    size_t index                 = 0;
 
-    static float MAX_AIR_ACCELERATION;
-    static float MAX_AIR_VELOCITY;
+    // These are in world space!
+    Segment weapon_collider, last_weapon_collider;
+
+    WeaponTrail weapon_trail;
 
-    static float HIT_SPEED_MULTIPLIER;
-    static float MAX_HIT_COOLDOWN;
-    static float MAX_HIT_TRAIL_ANGLE;
-    static float MAX_HIT_TRAIL_LENGTH;
-    static float HITSTUN_DURATION_MULTIPLIER;
+    // Bone pose before the last simulation tick
+    std::vector<RiggedMesh::Pose> last_tick_pose;
+
+    const PlayerConfig* config;
 
   public:
     void init(glm::vec3 position,
               glm::vec3 scale_factor,
-              const char* texture_path,
-              const char* mesh_path,
+              const PlayerModel& player_model,
               const Gamepad* pad,
-              const std::list<AABB>& colliders);
+              const PlayerConfig* player_config,
+              PlayerKinematics* player_kinematics,
+              size_t player_index,
+              const Level& level);
+
+    void update(float delta_time,
+                const Level& level,
+                ThreadPool* jobs = nullptr);
+
+    // Call before every simulation tick
+    void begin_tick();
 
-    void update(float delta_time, const std::list<AABB>& colliders);
+    void save(PlayerSnapshot& snapshot) const;
+    void restore(const PlayerSnapshot& snapshot);
+    void write_render_state(PlayerRenderState& render_state,
+                            float alpha) const;
 
     bool is_facing_right() const noexcept;
 
@@ -93,5 +145,6 @@ class Player : public Entity {
     // Game access them this way seems cleaner to me then writing a bunch of
     // getters/setters that are only used in one place.
     friend Game;
+    friend World;
     friend ConfigManager;
 };
\ No newline at end of file
@@ -0,0 +1,301 @@
+#pragma once
+#include "Profiler.h"
+#include "Util.h"
+#include <algorithm>
+#include <cstring>
+#include <sdl/SDL_rwops.h>
+#include <imgui/imgui.h>
+
+// Events the owning thread may write while they are copied. Copies only go
+// this far back, so none of the copied ones get overwritten in the meantime.
+static const u64 COPY_SLACK = 4096;
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::set_enabled(bool enabled_) {
+    enabled.store(enabled_, std::memory_order_relaxed);
+}
+
+bool Profiler::is_enabled() noexcept {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+static std::string full_thread_name(const char* name, s32 index) {
+    std::string result = name;
+    if (index >= 0) { result += " " + std::to_string(index); }
+    return result;
+}
+
+void Profiler::set_thread_name(const char* name, s32 index) {
+    thread_name  = name;
+    thread_index = index;
+
+    if (thread_buffer) {
+        std::lock_guard<std::mutex> lock(instance().mutex);
+        thread_buffer->name = full_thread_name(name, index);
+    }
+}
+
+void Profiler::begin_frame() {
+    Profiler& self = instance();
+    self.frame_starts[self.num_frames % FRAME_HISTORY] = now();
+    ++self.num_frames;
+}
+
+Profiler::ThreadBuffer& Profiler::local_buffer() {
+    if (thread_buffer) { return *thread_buffer; }
+
+    auto buffer    = std::make_unique<ThreadBuffer>();
+    buffer->events = std::make_unique<ProfileEvent[]>(EVENTS_PER_THREAD);
+
+    Profiler& self = instance();
+    std::lock_guard<std::mutex> lock(self.mutex);
+    buffer->id    = static_cast<u32>(self.threads.size());
+    buffer->name  = thread_name
+                   ? full_thread_name(thread_name, thread_index)
+                   : full_thread_name("Thread", static_cast<s32>(buffer->id));
+    thread_buffer = buffer.get();
+    self.threads.push_back(std::move(buffer));
+    return *thread_buffer;
+}
+
+void Profiler::record(ThreadBuffer& buffer, const ProfileEvent& event) {
+    // Only this thread writes, the count tells readers what is done
+    u64 index                                = buffer.count.load();
+    buffer.events[index % EVENTS_PER_THREAD] = event;
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::collect(u64 from, u64 to, std::vector<ThreadEvents>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    out.resize(threads.size());
+    for (size_t t = 0; t < threads.size(); ++t) {
+        const ThreadBuffer& buffer = *threads[t];
+        ThreadEvents& copy         = out[t];
+        copy.id                    = buffer.id;
+        copy.name                  = buffer.name;
+        copy.events.clear();
+
+        const u64 kept = EVENTS_PER_THREAD - COPY_SLACK;
+        u64 count      = buffer.count.load(std::memory_order_acquire);
+        u64 first      = count > kept ? count - kept : 0;
+        for (u64 i = first; i < count; ++i) {
+            const ProfileEvent& event = buffer.events[i % EVENTS_PER_THREAD];
+            if (event.end > from && event.start < to) {
+                copy.events.push_back(event);
+            }
+        }
+
+        // The thread was too busy to copy from, better nothing than garbage
+        if (buffer.count.load(std::memory_order_acquire) - count
+            > COPY_SLACK) {
+            copy.events.clear();
+        }
+    }
+}
+
+static void append_escaped(std::string& json, const char* text) {
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') { json += '\\'; }
+        json += *text;
+    }
+}
+
+bool Profiler::write_chrome_trace(const char* path) {
+    std::vector<ThreadEvents> threads;
+    instance().collect(0, UINT64_MAX, threads);
+
+    std::string json = "{\"traceEvents\":[\n";
+    char numbers[128];
+    bool first = true;
+    for (const auto& thread : threads) {
+        if (!first) { json += ",\n"; }
+        first = false;
+
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+        json += std::to_string(thread.id);
+        json += ",\"args\":{\"name\":\"";
+        append_escaped(json, thread.name.c_str());
+        json += "\"}}";
+
+        // Chrome wants microseconds
+        for (const auto& event : thread.events) {
+            json += ",\n{\"name\":\"";
+            append_escaped(json, event.name);
+            snprintf(numbers,
+                     sizeof(numbers),
+                     "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+                     "\"dur\":%.3f}",
+                     thread.id,
+                     static_cast<double>(event.start) / 1000.0,
+                     static_cast<double>(event.end - event.start) / 1000.0);
+            json += numbers;
+        }
+    }
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    SDL_RWops* file = SDL_RWFromFile(path, "w");
+    if (!file) { return false; }
+    size_t written = SDL_RWwrite(file, json.data(), 1, json.size());
+    SDL_RWclose(file);
+    return written == json.size();
+}
+
+// Same color for the same name in every frame
+static ImU32 color_of(const char* name) {
+    u32 hash = 2166136261u;
+    for (; *name; ++name) {
+        hash = (hash ^ static_cast<u8>(*name)) * 16777619u;
+    }
+    float hue = static_cast<float>(hash % 360) / 360.0f;
+    return ImColor::HSV(hue, 0.5f, 0.75f);
+}
+
+void Profiler::display_ui_window() {
+    using namespace ImGui;
+    Profiler& self = instance();
+
+    SetNextWindowSize(ImVec2(800.0f, 400.0f), ImGuiCond_FirstUseEver);
+    Begin("Profiler");
+
+    bool recording = is_enabled();
+    if (Checkbox("Record", &recording)) { set_enabled(recording); }
+    SameLine();
+    Checkbox("Pause", &self.paused);
+    SameLine();
+    PushItemWidth(100);
+    DragFloat("Pause on frames over (ms)", &self.hitch_ms, 0.5f, 0.0f, 500.0f);
+    PopItemWidth();
+    SameLine();
+    std::string path;
+    if (Button("Export trace")
+        && get_save_path(path, L"Chrome trace", L"*.json", L"json")) {
+        if (!write_chrome_trace(path.c_str())) {
+            printf("[PROFILER] Unable to write %s\n", path.c_str());
+        }
+    }
+
+    if (!self.paused && self.num_frames >= 2) {
+        self.shown_start =
+          self.frame_starts[(self.num_frames - 2) % FRAME_HISTORY];
+        self.shown_end =
+          self.frame_starts[(self.num_frames - 1) % FRAME_HISTORY];
+        self.collect(self.shown_start, self.shown_end, self.shown);
+
+        float frame_ms =
+          static_cast<float>(self.shown_end - self.shown_start) / 1.0e6f;
+        if (self.hitch_ms > 0.0f && frame_ms > self.hitch_ms) {
+            self.paused = true;
+        }
+
+        self.totals.clear();
+        for (const auto& thread : self.shown) {
+            for (const auto& event : thread.events) {
+                auto total = std::find_if(
+                  self.totals.begin(), self.totals.end(), [&](const Total& t) {
+                      return strcmp(t.name, event.name) == 0;
+                  });
+                if (total == self.totals.end()) {
+                    self.totals.push_back({ event.name, 0, 0 });
+                    total = self.totals.end() - 1;
+                }
+                total->time += event.end - event.start;
+                ++total->calls;
+            }
+        }
+        std::sort(self.totals.begin(),
+                  self.totals.end(),
+                  [](const Total& a, const Total& b) {
+                      return a.time > b.time;
+                  });
+    }
+    if (self.shown_end <= self.shown_start) {
+        End();
+        return;
+    }
+
+    const u64 frame_duration = self.shown_end - self.shown_start;
+    Text("Frame: %.3f ms", static_cast<float>(frame_duration) / 1.0e6f);
+
+    // Timeline, a lane per thread with a row per nesting depth
+    const float ROW_HEIGHT      = 18.0f;
+    ImDrawList* draw_list       = GetWindowDrawList();
+    const float width           = GetContentRegionAvail().x;
+    const float px_per_ns       = width / static_cast<float>(frame_duration);
+    const ProfileEvent* hovered = nullptr;
+
+    for (const auto& thread : self.shown) {
+        if (thread.events.empty()) { continue; }
+
+        u32 max_depth = 0;
+        for (const auto& event : thread.events) {
+            max_depth = std::max(max_depth, event.depth);
+        }
+
+        Text("%s", thread.name.c_str());
+        ImVec2 origin = GetCursorScreenPos();
+        float height  = static_cast<float>(max_depth + 1) * ROW_HEIGHT;
+        PushID(static_cast<int>(thread.id));
+        InvisibleButton("lane", ImVec2(width, height));
+        PopID();
+        bool lane_hovered = IsItemHovered();
+        ImVec2 mouse      = GetIO().MousePos;
+
+        for (const auto& event : thread.events) {
+            u64 start = std::max(event.start, self.shown_start);
+            u64 end   = std::min(event.end, self.shown_end);
+
+            float x0 = origin.x
+                     + static_cast<float>(start - self.shown_start) * px_per_ns;
+            float x1 = origin.x
+                     + static_cast<float>(end - self.shown_start) * px_per_ns;
+            x1       = std::max(x1, x0 + 1.0f);
+            float y0 = origin.y + static_cast<float>(event.depth) * ROW_HEIGHT;
+            float y1 = y0 + ROW_HEIGHT - 1.0f;
+
+            draw_list->AddRectFilled(
+              ImVec2(x0, y0), ImVec2(x1, y1), color_of(event.name));
+            if (x1 - x0 > 30.0f) {
+                draw_list->PushClipRect(ImVec2(x0, y0), ImVec2(x1, y1), true);
+                draw_list->AddText(
+                  ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32_BLACK, event.name);
+                draw_list->PopClipRect();
+            }
+
+            if (lane_hovered && mouse.x >= x0 && mouse.x < x1
+                && mouse.y >= y0 && mouse.y < y1) {
+                hovered = &event;
+            }
+        }
+    }
+    if (hovered) {
+        SetTooltip("%s: %.3f ms",
+                   hovered->name,
+                   static_cast<float>(hovered->end - hovered->start) / 1.0e6f);
+    }
+
+    // Where the time went, nested scopes count towards their parents too
+    Separator();
+    Columns(3, "totals");
+    Text("Scope");
+    NextColumn();
+    Text("Total ms");
+    NextColumn();
+    Text("Calls");
+    NextColumn();
+    for (const auto& total : self.totals) {
+        Text("%s", total.name);
+        NextColumn();
+        Text("%.3f", static_cast<float>(total.time) / 1.0e6f);
+        NextColumn();
+        Text("%u", total.calls);
+        NextColumn();
+    }
+    Columns(1);
+
+    End();
+}
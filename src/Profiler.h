@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Types.h"
+
+// Times the scope it's put in, on any thread. The name has to be a string
+// literal, only the pointer is kept. While the Profiler is off, a scope costs
+// a single relaxed load.
+#define PROFILE_SCOPE(name)                                                    \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_CONCAT_INNER(a, b) a##b
+
+// In nanoseconds since the Profiler started
+struct ProfileEvent {
+    const char* name;
+    u64 start;
+    u64 end;
+    u32 depth;  // Of the scope it's in, 0 at the outermost one
+};
+
+// Keeps the last EVENTS_PER_THREAD timed scopes of every thread, each thread
+// in a ring buffer only it writes to. Shows them as a timeline of the last
+// frame, one row per nesting depth, and writes them as a Chrome trace_event
+// file that chrome://tracing or Perfetto can open.
+class Profiler {
+  public:
+    static const size_t EVENTS_PER_THREAD = 1 << 16;
+
+    static void set_enabled(bool enabled);
+    static bool is_enabled() noexcept;
+
+    // Shown on the thread's lane. The index is appended unless it's negative.
+    static void set_thread_name(const char* name, s32 index = -1);
+
+    // Call on the main thread where a frame starts, the panel shows the time
+    // between the last two calls
+    static void begin_frame();
+
+    // Every event still in the ring buffers. Returns false if the file can't
+    // be written.
+    static bool write_chrome_trace(const char* path);
+
+    static void display_ui_window();
+
+  private:
+    friend class ProfileScope;
+
+    struct ThreadBuffer {
+        std::unique_ptr<ProfileEvent[]> events;
+        // Events written so far, the last EVENTS_PER_THREAD are in events
+        std::atomic<u64> count = { 0 };
+        u32 depth              = 0;
+        u32 id;
+        std::string name;
+    };
+
+    // Copy of the events of one thread, for drawing and writing
+    struct ThreadEvents {
+        u32 id;
+        std::string name;
+        std::vector<ProfileEvent> events;
+    };
+
+    // Time of one name in the shown frame, over all threads
+    struct Total {
+        const char* name;
+        u64 time;
+        u32 calls;
+    };
+
+    static u64 steady_time() noexcept {
+        return static_cast<u64>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+    }
+    static u64 now() noexcept { return steady_time() - start_time; }
+
+    static inline std::atomic<bool> enabled = { false };
+    // Buffers are only made for threads that record something
+    static inline thread_local ThreadBuffer* thread_buffer = nullptr;
+    static inline thread_local const char* thread_name    = nullptr;
+    static inline thread_local s32 thread_index           = -1;
+    static inline const u64 start_time = steady_time();
+
+    std::mutex mutex;  // Guards threads and their names
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+
+    // The rest is for the main thread only
+    static const size_t FRAME_HISTORY = 128;
+    u64 frame_starts[FRAME_HISTORY];
+    u64 num_frames = 0;
+
+    bool paused     = false;
+    float hitch_ms  = 0.0f;  // Pauses on frames longer than this, 0 is off
+    u64 shown_start = 0;
+    u64 shown_end   = 0;
+    std::vector<ThreadEvents> shown;
+    std::vector<Total> totals;
+
+    static Profiler& instance();
+    static ThreadBuffer& local_buffer();
+    static void record(ThreadBuffer& buffer, const ProfileEvent& event);
+
+    // Copies the events that overlap [from, to)
+    void collect(u64 from, u64 to, std::vector<ThreadEvents>& out);
+};
+
+class ProfileScope {
+  public:
+    explicit ProfileScope(const char* name_) {
+        if (!Profiler::enabled.load(std::memory_order_relaxed)) { return; }
+        buffer = &Profiler::local_buffer();
+        name   = name_;
+        depth  = buffer->depth++;
+        start  = Profiler::now();
+    }
+    ~ProfileScope() {
+        if (!buffer) { return; }
+        --buffer->depth;
+        Profiler::record(*buffer, { name, start, Profiler::now(), depth });
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+  private:
+    Profiler::ThreadBuffer* buffer = nullptr;
+    const char* name               = nullptr;
+    u64 start                      = 0;
+    u32 depth                      = 0;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include "RenderState.h"
+
+void RenderState::clear_events() {
+    ticks      = 0;
+    delta_time = 0.0f;
+    sounds.clear();
+    hits.clear();
+    weapons_collided = false;
+}
+
+void RenderState::add_events(const WorldEvents& events,
+                             float tick_delta_time) {
+    ++ticks;
+    delta_time += tick_delta_time;
+
+    for (const Sound sound : events.sounds) {
+        sounds.push_back(sound);
+    }
+    for (const auto& hit : events.hits) {
+        hits.push_back(hit);
+    }
+
+    if (events.weapons_collided) {
+        weapons_collided       = true;
+        weapon_collision_point = events.weapon_collision_point;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <array>
+#include <vector>
+#include "Types.h"
+#include "SmallVector.h"
+#include "World.h"
+
+struct PlayerRenderState {
+    glm::mat3 model;
+    bool facing_right;
+    std::array<glm::mat3, RiggedShader::NUMBER_OF_BONES> bone_transforms;
+    Circle body_collider;
+
+    vec2 leg_spline_points[2][Spline::NUM_POINTS];
+
+    u32 num_trail_vertices;
+    std::array<TrailShader::Vertex, WeaponTrail::MAX_VERTICES> trail_vertices;
+};
+
+struct BallRenderState {
+    glm::mat3 model;  // Rotation included
+    bool grounded;
+    std::array<DebugShader::Vertex, Ball::TRAJECTORY_VERTICES> trajectory;
+};
+
+// Everything a frame draws of the World, already interpolated between the
+// last two ticks. The simulation thread fills one of these while the main
+// thread draws the one from the frame before, so drawing never reads the
+// World itself.
+struct RenderState {
+    std::vector<PlayerRenderState> players;  // As many as the World has
+    BallRenderState ball;
+    std::vector<glm::mat3> party_balls;  // Model matrices
+
+    // What happened in the ticks since the last RenderState, for the main
+    // thread to play and show
+    u32 ticks;
+    float delta_time;  // Of all those ticks together
+    // When the input of the last of them was read, see
+    // FramePacer::input_sampled()
+    u64 input_time = 0;
+    SmallVector<Sound, 16> sounds;
+    SmallVector<WorldEvents::Hit, 8> hits;
+    bool weapons_collided;
+    Point weapon_collision_point;
+
+    void clear_events();
+    void add_events(const WorldEvents& events, float tick_delta_time);
+};
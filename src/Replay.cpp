@@ -0,0 +1,325 @@
+#pragma once
+#include "Replay.h"
+#include <cstring>
+#include <sdl/SDL_assert.h>
+
+static const u32 REPLAY_FILE_MAGIC   = 0x594C5052;  // "RPLY"
+static const u32 REPLAY_FILE_VERSION = 1;
+
+// A player's fields, one bit each in the mask of changed fields
+static const u32 NUM_INPUT_AXES   = SDL_CONTROLLER_AXIS_MAX;
+static const u32 INPUT_BUTTON_BIT = NUM_INPUT_AXES;
+
+// Bit 0 of a tick's changes is for commands, the players come after it
+static const u64 COMMANDS_CHANGED = 1;
+
+static_assert(World::NUM_PLAYERS < 63, "Changes are a 64 bit mask");
+
+// Varints and the tick's masks, the axes and buttons of every player
+static const size_t MAX_TICK_SIZE =
+  3 * 10 + World::NUM_PLAYERS * (NUM_INPUT_AXES + 2) * 5;
+
+static void write_varint(std::vector<u8>& buffer, u64 value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<u8>(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<u8>(value));
+}
+
+static u32 float_bits(float f) {
+    u32 bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+/////                                   /////
+/////           ReplayWriter            /////
+/////                                   /////
+
+ReplayWriter::~ReplayWriter() {
+    close();
+}
+
+bool ReplayWriter::open(const char* path, const ReplayHeader& header) {
+    SDL_assert(!file);
+
+    file = SDL_RWFromFile(path, "wb");
+    if (!file) { return false; }
+
+    ReplayHeader written  = header;
+    written.magic         = REPLAY_FILE_MAGIC;
+    written.version       = REPLAY_FILE_VERSION;
+    written.config_size   = sizeof(WorldConfig);
+    written.snapshot_size = sizeof(WorldSnapshot);
+    SDL_RWwrite(file, &written, sizeof(written), 1);
+
+    for (auto& input : last_inputs) {
+        input = {};
+    }
+    unchanged_ticks = 0;
+    num_ticks       = 0;
+    num_bytes       = 0;
+
+    chunk.clear();
+    chunk.reserve(CHUNK_SIZE);
+
+    closing       = false;
+    writer_thread = std::thread(&ReplayWriter::write_chunks, this);
+    return true;
+}
+
+void ReplayWriter::add_tick(const GamepadState inputs[World::NUM_PLAYERS],
+                            u32 commands) {
+    SDL_assert(file);
+    ++num_ticks;
+
+    u64 changes = commands != 0 ? COMMANDS_CHANGED : 0;
+    for (size_t p = 0; p < World::NUM_PLAYERS; ++p) {
+        if (memcmp(&inputs[p], &last_inputs[p], sizeof(GamepadState)) != 0) {
+            changes |= 2ull << p;
+        }
+    }
+
+    if (changes == 0) {
+        ++unchanged_ticks;
+        return;
+    }
+
+    size_t size_before = chunk.size();
+
+    write_varint(chunk, unchanged_ticks);
+    write_varint(chunk, changes);
+    if (changes & COMMANDS_CHANGED) { write_varint(chunk, commands); }
+
+    for (size_t p = 0; p < World::NUM_PLAYERS; ++p) {
+        if (!(changes & (2ull << p))) { continue; }
+
+        const GamepadState& input = inputs[p];
+        GamepadState& last        = last_inputs[p];
+
+        // Changed values are stored as the XOR with the last one. Sticks
+        // that only move a little keep sign and exponent, so those end up
+        // short.
+        u32 axis_changes[NUM_INPUT_AXES];
+        u32 field_mask = 0;
+        for (u32 axis = 0; axis < NUM_INPUT_AXES; ++axis) {
+            axis_changes[axis] =
+              float_bits(input.axes[axis]) ^ float_bits(last.axes[axis]);
+            if (axis_changes[axis] != 0) { field_mask |= BIT(axis); }
+        }
+        u32 button_changes = input.buttons ^ last.buttons;
+        if (button_changes != 0) { field_mask |= BIT(INPUT_BUTTON_BIT); }
+
+        write_varint(chunk, field_mask);
+        for (u32 axis = 0; axis < NUM_INPUT_AXES; ++axis) {
+            if (axis_changes[axis] != 0) {
+                write_varint(chunk, axis_changes[axis]);
+            }
+        }
+        if (button_changes != 0) { write_varint(chunk, button_changes); }
+
+        last = input;
+    }
+
+    unchanged_ticks = 0;
+    num_bytes += chunk.size() - size_before;
+
+    if (chunk.size() + MAX_TICK_SIZE > CHUNK_SIZE) { submit_chunk(); }
+}
+
+void ReplayWriter::close() {
+    if (!file) { return; }
+
+    // The ticks since the last change and no changes mark the end
+    size_t size_before = chunk.size();
+    write_varint(chunk, unchanged_ticks);
+    write_varint(chunk, 0);
+    num_bytes += chunk.size() - size_before;
+    submit_chunk();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    chunks_available.notify_one();
+    writer_thread.join();
+
+    SDL_RWclose(file);
+    file = nullptr;
+}
+
+bool ReplayWriter::is_open() const noexcept {
+    return file != nullptr;
+}
+
+u64 ReplayWriter::ticks() const noexcept {
+    return num_ticks;
+}
+
+u64 ReplayWriter::size() const noexcept {
+    return num_bytes;
+}
+
+void ReplayWriter::submit_chunk() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        full_chunks.push_back(std::move(chunk));
+
+        // Written chunks are reused, so recording only allocates until the
+        // writer thread keeps up
+        if (free_chunks.empty()) {
+            chunk = std::vector<u8>();
+        } else {
+            chunk = std::move(free_chunks.back());
+            free_chunks.pop_back();
+        }
+    }
+    chunks_available.notify_one();
+
+    chunk.clear();
+    chunk.reserve(CHUNK_SIZE);
+}
+
+void ReplayWriter::write_chunks() {
+    std::vector<std::vector<u8>> writing;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (auto& written : writing) {
+                written.clear();
+                free_chunks.push_back(std::move(written));
+            }
+            writing.clear();
+
+            chunks_available.wait(
+              lock, [this] { return closing || !full_chunks.empty(); });
+            if (full_chunks.empty()) { return; }  // Closing and all written
+            writing.swap(full_chunks);
+        }
+
+        for (const auto& full : writing) {
+            SDL_RWwrite(file, full.data(), 1, full.size());
+        }
+    }
+}
+
+/////                                   /////
+/////           ReplayReader            /////
+/////                                   /////
+
+bool ReplayReader::open(const char* path) {
+    close();
+
+    SDL_RWops* file = SDL_RWFromFile(path, "rb");
+    if (!file) { return false; }
+
+    Sint64 file_size = SDL_RWsize(file);
+    if (file_size < static_cast<Sint64>(sizeof(ReplayHeader))
+        || SDL_RWread(file, &header_, sizeof(header_), 1) != 1) {
+        SDL_RWclose(file);
+        return false;
+    }
+
+    if (header_.magic != REPLAY_FILE_MAGIC
+        || header_.version != REPLAY_FILE_VERSION
+        || header_.config_size != sizeof(WorldConfig)
+        || header_.snapshot_size != sizeof(WorldSnapshot)) {
+        printf("[REPLAY] %s is not a replay of this build\n", path);
+        SDL_RWclose(file);
+        return false;
+    }
+
+    data.resize(static_cast<size_t>(file_size) - sizeof(ReplayHeader));
+    size_t read = SDL_RWread(file, data.data(), 1, data.size());
+    data.resize(read);
+    SDL_RWclose(file);
+
+    position = 0;
+    for (auto& input : inputs_) {
+        input = {};
+    }
+    num_ticks = 0;
+    open_     = true;
+
+    read_change_header();
+    return true;
+}
+
+void ReplayReader::close() {
+    data.clear();
+    open_ = false;
+}
+
+bool ReplayReader::is_open() const noexcept {
+    return open_;
+}
+
+const ReplayHeader& ReplayReader::header() const noexcept {
+    return header_;
+}
+
+bool ReplayReader::next_tick(GamepadState inputs[World::NUM_PLAYERS],
+                             u32& commands) {
+    if (!open_) { return false; }
+
+    commands = 0;
+    if (unchanged_ticks > 0) {
+        --unchanged_ticks;
+    } else if (changes == 0) {
+        return false;
+    } else {
+        u64 value;
+        if ((changes & COMMANDS_CHANGED) && read_varint(value)) {
+            commands = static_cast<u32>(value);
+        }
+
+        for (size_t p = 0; p < World::NUM_PLAYERS; ++p) {
+            if (!(changes & (2ull << p))) { continue; }
+
+            GamepadState& input = inputs_[p];
+            u64 field_mask      = 0;
+            read_varint(field_mask);
+
+            for (u32 axis = 0; axis < NUM_INPUT_AXES; ++axis) {
+                if ((field_mask & BIT(axis)) && read_varint(value)) {
+                    u32 bits = float_bits(input.axes[axis])
+                             ^ static_cast<u32>(value);
+                    memcpy(&input.axes[axis], &bits, sizeof(bits));
+                }
+            }
+            if ((field_mask & BIT(INPUT_BUTTON_BIT)) && read_varint(value)) {
+                input.buttons ^= static_cast<u32>(value);
+            }
+        }
+
+        read_change_header();
+    }
+
+    for (size_t p = 0; p < World::NUM_PLAYERS; ++p) {
+        inputs[p] = inputs_[p];
+    }
+    ++num_ticks;
+    return true;
+}
+
+u64 ReplayReader::ticks() const noexcept {
+    return num_ticks;
+}
+
+bool ReplayReader::read_varint(u64& value) {
+    value = 0;
+    for (u32 shift = 0; shift < 64 && position < data.size(); shift += 7) {
+        u8 byte = data[position++];
+        value |= static_cast<u64>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) { return true; }
+    }
+    return false;
+}
+
+void ReplayReader::read_change_header() {
+    // A file that was cut off just ends at the last complete change
+    if (!read_varint(unchanged_ticks) || !read_varint(changes)) {
+        changes = 0;
+    }
+}
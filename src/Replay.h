@@ -0,0 +1,119 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sdl/SDL_rwops.h>
+#include "Types.h"
+#include "Util.h"
+#include "Input.h"
+#include "World.h"
+#include "Snapshot.h"
+
+// Keyboard commands that change the simulation, recorded with the tick they
+// are applied at
+namespace ReplayCommand {
+constexpr u32 SAVE_STATE = BIT(0);
+constexpr u32 LOAD_STATE = BIT(1);
+};  // namespace ReplayCommand
+
+// Everything besides the inputs that is needed to play a replay back. The
+// level isn't part of it, replays only work with the level they were
+// recorded on.
+struct ReplayHeader {
+    u32 magic;
+    u32 version;
+
+    // Replays only fit the build they were recorded with
+    u32 config_size;
+    u32 snapshot_size;
+
+    float delta_time;
+    WorldConfig config;
+    WorldSnapshot start;
+
+    // What the gamepads were set to before the first tick, so the first
+    // button presses register the same way
+    GamepadState start_inputs[World::NUM_PLAYERS];
+
+    // The state a LOAD_STATE command goes back to, if it was saved before the
+    // recording started
+    u32 has_saved_state;
+    WorldSnapshot saved_state;
+};
+
+// Records the inputs of every tick into a replay file. Only the inputs that
+// changed are stored, as varints of the XOR with their last value, and ticks
+// without changes are only counted. The file is written on a thread of its
+// own, add_tick() never waits for the disk.
+class ReplayWriter {
+  public:
+    ReplayWriter() = default;
+    ~ReplayWriter();
+
+    ReplayWriter(const ReplayWriter&) = delete;
+    ReplayWriter& operator=(const ReplayWriter&) = delete;
+
+    // The header describes the state the first recorded tick starts in
+    bool open(const char* path, const ReplayHeader& header);
+    void add_tick(const GamepadState inputs[World::NUM_PLAYERS], u32 commands);
+    void close();
+
+    bool is_open() const noexcept;
+    u64 ticks() const noexcept;
+    u64 size() const noexcept;  // Bytes of input data so far
+
+  private:
+    static const size_t CHUNK_SIZE = 16 * 1024;
+
+    SDL_RWops* file = nullptr;
+
+    GamepadState last_inputs[World::NUM_PLAYERS];
+    u64 unchanged_ticks = 0;
+    u64 num_ticks       = 0;
+    u64 num_bytes       = 0;
+
+    // Filled by add_tick(), handed to the writer thread when full
+    std::vector<u8> chunk;
+
+    std::thread writer_thread;
+    std::mutex mutex;
+    std::condition_variable chunks_available;
+    std::vector<std::vector<u8>> full_chunks;
+    std::vector<std::vector<u8>> free_chunks;
+    bool closing = false;
+
+    void submit_chunk();
+    void write_chunks();
+};
+
+// Plays back a replay file, which is loaded completely on open()
+class ReplayReader {
+  public:
+    bool open(const char* path);
+    void close();
+
+    bool is_open() const noexcept;
+    const ReplayHeader& header() const noexcept;
+
+    // Inputs and commands of the next tick, false at the end of the replay
+    bool next_tick(GamepadState inputs[World::NUM_PLAYERS], u32& commands);
+    u64 ticks() const noexcept;  // Read so far
+
+  private:
+    std::vector<u8> data;
+    size_t position = 0;
+    bool open_      = false;
+
+    ReplayHeader header_;
+
+    GamepadState inputs_[World::NUM_PLAYERS];
+    u64 num_ticks = 0;
+
+    // Of the next change, 0 changes means the replay ends
+    u64 unchanged_ticks = 0;
+    u64 changes         = 0;
+
+    bool read_varint(u64& value);
+    void read_change_header();
+};
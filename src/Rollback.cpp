@@ -0,0 +1,259 @@
+#pragma once
+#include "Rollback.h"
+#include "Util.h"
+#include <cstring>
+#include <sdl/SDL_assert.h>
+
+/////                                   /////
+/////           LoopbackLink            /////
+/////                                   /////
+
+void LoopbackLink::init(const Settings& settings_) {
+    settings = settings_;
+    // xorshift gets stuck at 0
+    random_state = settings.seed | 1u;
+    in_flight[0].clear();
+    in_flight[1].clear();
+}
+
+void LoopbackLink::send(u32 from, const InputPacket& packet, double now) {
+    SDL_assert(from < 2);
+    if (random() < settings.loss) { return; }
+
+    double arrival = now + settings.latency + settings.jitter * random();
+    in_flight[1 - from].push_back({ arrival, packet });
+}
+
+bool LoopbackLink::receive(u32 to, double now, InputPacket& packet) {
+    SDL_assert(to < 2);
+    auto& packets = in_flight[to];
+
+    // Whichever arrived first
+    size_t first = packets.size();
+    for (size_t i = 0; i < packets.size(); ++i) {
+        if (packets[i].arrival <= now
+            && (first == packets.size()
+                || packets[i].arrival < packets[first].arrival)) {
+            first = i;
+        }
+    }
+    if (first == packets.size()) { return false; }
+
+    packet = packets[first].packet;
+    packets[first] = packets.back();
+    packets.pop_back();
+    return true;
+}
+
+float LoopbackLink::random() {
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return static_cast<float>(random_state >> 8) / 16777216.0f;
+}
+
+/////                                   /////
+/////          RollbackSession          /////
+/////                                   /////
+
+static_assert(World::NUM_PLAYERS == 2, "Rollback is for one remote player");
+
+void RollbackSession::init(World* world_,
+                           Gamepad* gamepads_,
+                           u32 local_player_,
+                           u32 input_delay_) {
+    SDL_assert(local_player_ < World::NUM_PLAYERS);
+    SDL_assert(input_delay_ < MAX_PREDICTION_TICKS);
+
+    world         = world_;
+    gamepads      = gamepads_;
+    local_player  = local_player_;
+    remote_player = 1 - local_player_;
+    input_delay   = input_delay_;
+
+    for (auto& player : players) {
+        player.confirmed = 0;
+    }
+    // Nobody presses anything during the first delayed ticks
+    for (u32 i = 0; i < input_delay; ++i) {
+        input(local_player, i) = {};
+        ++players[local_player].confirmed;
+    }
+
+    tick          = 0;
+    rollback_tick = NO_ROLLBACK;
+    remote_ack    = 0;
+
+    if (!snapshots) {
+        snapshots = std::make_unique<WorldSnapshot[]>(NUM_SNAPSHOTS);
+    }
+
+    next_checksum_tick        = 0;
+    next_remote_checksum_tick = 0;
+
+    stats_ = {};
+}
+
+bool RollbackSession::advance(const GamepadState& local_input,
+                              float delta_time,
+                              WorldEvents& events) {
+    if (prediction_ticks() >= MAX_PREDICTION_TICKS) {
+        ++stats_.stalls;
+        return false;
+    }
+
+    PlayerInputs& local = players[local_player];
+    SDL_assert(local.confirmed == tick + input_delay);
+    input(local_player, local.confirmed) = local_input;
+    ++local.confirmed;
+
+    if (rollback_tick != NO_ROLLBACK) {
+        u32 rollback_ticks = tick - rollback_tick;
+        SDL_assert(rollback_ticks <= MAX_PREDICTION_TICKS);
+
+        world->restore(snapshot(rollback_tick));
+        u32 last_tick = tick;
+        tick          = rollback_tick;
+        while (tick < last_tick) {
+            simulate_tick(delta_time, resimulated_events);
+        }
+        rollback_tick = NO_ROLLBACK;
+
+        ++stats_.rollbacks;
+        stats_.resimulated_ticks += rollback_ticks;
+        if (rollback_ticks > stats_.max_rollback_ticks) {
+            stats_.max_rollback_ticks = rollback_ticks;
+        }
+    }
+
+    simulate_tick(delta_time, events);
+    update_checksums();
+    return true;
+}
+
+void RollbackSession::add_remote_inputs(const InputPacket& packet) {
+    if (packet.ack_tick > remote_ack) { remote_ack = packet.ack_tick; }
+
+    PlayerInputs& remote = players[remote_player];
+    for (u32 i = 0; i < packet.num_inputs; ++i) {
+        u32 at_tick = packet.first_tick + i;
+        // Already known
+        if (at_tick < remote.confirmed) { continue; }
+        // The packets before this one got lost or are late
+        if (at_tick > remote.confirmed) { break; }
+
+        SDL_assert(at_tick + MAX_PREDICTION_TICKS < tick + INPUT_BUFFER_SIZE);
+
+        // Ticks that already ran were simulated with a prediction
+        GamepadState& slot = input(remote_player, at_tick);
+        if (at_tick < tick && at_tick < rollback_tick
+            && memcmp(&slot, &packet.inputs[i], sizeof(GamepadState)) != 0) {
+            rollback_tick = at_tick;
+        }
+
+        slot = packet.inputs[i];
+        ++remote.confirmed;
+    }
+
+    u32 checksum_tick = packet.checksum_tick;
+    if (checksum_tick != InputPacket::NO_CHECKSUM
+        && checksum_tick >= next_remote_checksum_tick
+        && checksum_tick < next_checksum_tick
+        && next_checksum_tick - checksum_tick <= NUM_CHECKSUMS) {
+        ++stats_.checks;
+        if (checksums[checksum_tick % NUM_CHECKSUMS] != packet.checksum) {
+            ++stats_.desyncs;
+        }
+        next_remote_checksum_tick = checksum_tick + 1;
+    }
+}
+
+void RollbackSession::make_packet(InputPacket& packet) const {
+    const PlayerInputs& local = players[local_player];
+
+    u32 num_inputs = local.confirmed - remote_ack;
+    // Can't happen unless the other side stops acknowledging, it stalls long
+    // before that
+    if (num_inputs > InputPacket::MAX_INPUTS) {
+        num_inputs = InputPacket::MAX_INPUTS;
+    }
+
+    packet.first_tick = remote_ack;
+    packet.num_inputs = num_inputs;
+    packet.ack_tick   = players[remote_player].confirmed;
+    for (u32 i = 0; i < num_inputs; ++i) {
+        packet.inputs[i] = input(local_player, remote_ack + i);
+    }
+
+    if (next_checksum_tick > 0) {
+        packet.checksum_tick = next_checksum_tick - 1;
+        packet.checksum = checksums[packet.checksum_tick % NUM_CHECKSUMS];
+    } else {
+        packet.checksum_tick = InputPacket::NO_CHECKSUM;
+        packet.checksum      = 0;
+    }
+}
+
+u32 RollbackSession::current_tick() const noexcept {
+    return tick;
+}
+
+u32 RollbackSession::prediction_ticks() const noexcept {
+    u32 confirmed = players[remote_player].confirmed;
+    return tick > confirmed ? tick - confirmed : 0;
+}
+
+const RollbackStats& RollbackSession::stats() const noexcept {
+    return stats_;
+}
+
+GamepadState& RollbackSession::input(u32 player, u32 at_tick) {
+    return players[player].inputs[at_tick % INPUT_BUFFER_SIZE];
+}
+
+const GamepadState& RollbackSession::input(u32 player, u32 at_tick) const {
+    return players[player].inputs[at_tick % INPUT_BUFFER_SIZE];
+}
+
+WorldSnapshot& RollbackSession::snapshot(u32 at_tick) {
+    return snapshots[at_tick % NUM_SNAPSHOTS];
+}
+
+void RollbackSession::simulate_tick(float delta_time, WorldEvents& events) {
+    world->save(snapshot(tick));
+
+    for (u32 p = 0; p < World::NUM_PLAYERS; ++p) {
+        const PlayerInputs& player = players[p];
+        if (tick >= player.confirmed) {
+            // The last known input is still held
+            input(p, tick) = player.confirmed > 0
+                             ? input(p, player.confirmed - 1)
+                             : GamepadState {};
+        }
+
+        // Going through the last tick's input first makes button presses
+        // register the same way, no matter which tick was restored
+        gamepads[p].set_state(tick > 0 ? input(p, tick - 1) : GamepadState {});
+        gamepads[p].set_state(input(p, tick));
+    }
+
+    world->begin_tick();
+    world->simulate(delta_time, events);
+    ++tick;
+}
+
+void RollbackSession::update_checksums() {
+    // Only states that every input before them is known for are final
+    u32 settled = tick - 1;
+    for (const auto& player : players) {
+        if (player.confirmed < settled) { settled = player.confirmed; }
+    }
+
+    while (next_checksum_tick <= settled) {
+        SDL_assert(next_checksum_tick + NUM_SNAPSHOTS > tick);
+        checksums[next_checksum_tick % NUM_CHECKSUMS] = add_to_checksum(
+          CHECKSUM_BASIS, &snapshot(next_checksum_tick), sizeof(WorldSnapshot));
+        ++next_checksum_tick;
+    }
+}
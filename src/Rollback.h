@@ -0,0 +1,148 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Types.h"
+#include "Input.h"
+#include "World.h"
+#include "Snapshot.h"
+
+// What goes over the network: the sender's inputs from first_tick on. Every
+// packet repeats all inputs the receiver hasn't acknowledged yet, so lost
+// packets don't have to be resent.
+struct InputPacket {
+    static const u32 MAX_INPUTS  = 32;
+    static const u32 NO_CHECKSUM = 0xFFFFFFFF;
+
+    u32 first_tick;
+    u32 num_inputs;
+
+    // The sender has all of the receiver's inputs before this tick
+    u32 ack_tick;
+
+    // Checksum of the sender's state at the start of checksum_tick, once
+    // every input before it was known. Used to detect desyncs.
+    u32 checksum_tick;
+    u64 checksum;
+
+    GamepadState inputs[MAX_INPUTS];
+};
+
+// Stand-in for a pair of UDP sockets on the same machine. Packets arrive
+// after latency plus up to jitter milliseconds and some of them get lost, so
+// they don't necessarily arrive in order either.
+class LoopbackLink {
+  public:
+    struct Settings {
+        float latency = 60.0f;  // One way, in milliseconds
+        float jitter  = 0.0f;
+        float loss    = 0.0f;  // Chance of a packet getting lost
+        u32 seed      = 1;
+    };
+
+    void init(const Settings& settings_);
+
+    // The endpoints are 0 and 1, packets sent from one arrive at the other.
+    // Times are in milliseconds.
+    void send(u32 from, const InputPacket& packet, double now);
+    bool receive(u32 to, double now, InputPacket& packet);
+
+  private:
+    struct InFlight {
+        double arrival;
+        InputPacket packet;
+    };
+    std::vector<InFlight> in_flight[2];
+
+    Settings settings;
+    u32 random_state;
+
+    float random();  // In [0, 1)
+};
+
+struct RollbackStats {
+    u64 rollbacks;
+    u64 resimulated_ticks;
+    u32 max_rollback_ticks;
+    u64 stalls;  // advance() calls that had to wait for the remote player
+
+    u64 checks;   // Checksums compared with the remote player
+    u64 desyncs;  // Checksums that didn't match
+};
+
+// GGPO style rollback for two players on two machines. Every tick is
+// simulated as soon as the local input is there, the remote player's input is
+// predicted to be the same as the last one that arrived. When a remote input
+// arrives that differs from the prediction, the World is restored to the
+// snapshot of that tick and the ticks since are simulated again, before the
+// next new tick.
+class RollbackSession {
+  public:
+    // How far the simulation may run ahead of the remote input, 200 ms at
+    // 60 ticks per second. This is also the most ticks a rollback simulates
+    // again.
+    static const u32 MAX_PREDICTION_TICKS = 12;
+
+    // World and gamepads are the ones the World was initialized with. The
+    // session sets the gamepads to each tick's input. An input_delay of 0
+    // applies the local input to the very next tick.
+    void init(World* world_,
+              Gamepad* gamepads_,
+              u32 local_player_,
+              u32 input_delay_ = 0);
+
+    // Simulates the next tick with local_input, after rolling back if remote
+    // input arrived that didn't match the prediction. Events are only the
+    // ones of the new tick, the ones from simulating ticks again are dropped.
+    // Returns false without simulating if it is too far ahead of the remote
+    // input, call again with the next local input later.
+    bool advance(const GamepadState& local_input,
+                 float delta_time,
+                 WorldEvents& events);
+
+    void add_remote_inputs(const InputPacket& packet);
+    void make_packet(InputPacket& packet) const;
+
+    u32 current_tick() const noexcept;
+    // Ticks ahead of the last remote input
+    u32 prediction_ticks() const noexcept;
+    const RollbackStats& stats() const noexcept;
+
+  private:
+    static const u32 INPUT_BUFFER_SIZE = 128;
+    static const u32 NUM_SNAPSHOTS     = MAX_PREDICTION_TICKS + 2;
+    static const u32 NUM_CHECKSUMS     = 64;
+    static const u32 NO_ROLLBACK       = 0xFFFFFFFF;
+
+    World* world;
+    Gamepad* gamepads;
+    u32 local_player, remote_player;
+    u32 input_delay;
+
+    // Inputs before confirmed are known, the ones after are the predictions
+    // they were simulated with
+    struct PlayerInputs {
+        GamepadState inputs[INPUT_BUFFER_SIZE];
+        u32 confirmed;
+    } players[World::NUM_PLAYERS];
+
+    u32 tick;
+    u32 rollback_tick;  // Earliest tick with a wrong prediction
+    u32 remote_ack;     // The remote player has our inputs before this
+
+    // State at the start of each of the last NUM_SNAPSHOTS ticks
+    std::unique_ptr<WorldSnapshot[]> snapshots;
+    WorldEvents resimulated_events;
+
+    // Checksums of the states every input was known for
+    u64 checksums[NUM_CHECKSUMS];
+    u32 next_checksum_tick;
+    u32 next_remote_checksum_tick;  // Every tick is only compared once
+
+    RollbackStats stats_;
+
+    GamepadState& input(u32 player, u32 at_tick);
+    const GamepadState& input(u32 player, u32 at_tick) const;
+    WorldSnapshot& snapshot(u32 at_tick);
+    void simulate_tick(float delta_time, WorldEvents& events);
+    void update_checksums();
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include "sdl/SDL_assert.h"
+#include "Types.h"
+#include "FrameArena.h"
+
+struct ScratchVectorStats {
+    // Number of times any ScratchVector had to go to the heap
+    static inline std::atomic<u64> heap_allocations { 0 };
+};
+
+// Growable array for trivially copyable types that lives in storage provided
+// by SmallVector below until it runs out of space. Functions that fill a
+// buffer take this base class, so callers can pick the inline capacity. Memory
+// is only ever released in the destructor, so a buffer that is kept around
+// stops allocating once it has seen its biggest use. Short-lived buffers can
+// grow into a FrameArena instead of the heap.
+template<typename T>
+class ScratchVector : public ScratchVectorStats {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "ScratchVector only supports trivially copyable types");
+
+  public:
+    ScratchVector(const ScratchVector&) = delete;
+    ScratchVector& operator=(const ScratchVector&) = delete;
+
+    void push_back(T value) {
+        if (size_ == capacity_) { grow(capacity_ * 2); }
+        data_[size_++] = value;
+    }
+
+    // New elements are left uninitialized
+    void resize(size_t new_size) {
+        if (new_size > capacity_) { grow(new_size); }
+        size_ = new_size;
+    }
+
+    void reserve(size_t min_capacity) {
+        if (min_capacity > capacity_) { grow(min_capacity); }
+    }
+
+    void clear() noexcept { size_ = 0; }
+
+    size_t size() const noexcept { return size_; }
+    size_t capacity() const noexcept { return capacity_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+    T* data() noexcept { return data_; }
+    const T* data() const noexcept { return data_; }
+
+    T& operator[](size_t i) {
+        SDL_assert(i < size_);
+        return data_[i];
+    }
+    const T& operator[](size_t i) const {
+        SDL_assert(i < size_);
+        return data_[i];
+    }
+
+    T* begin() noexcept { return data_; }
+    T* end() noexcept { return data_ + size_; }
+    const T* begin() const noexcept { return data_; }
+    const T* end() const noexcept { return data_ + size_; }
+
+  protected:
+    ScratchVector(T* inline_storage,
+                  size_t inline_capacity,
+                  FrameArena* arena = nullptr)
+        : data_(inline_storage), capacity_(inline_capacity), arena_(arena) {}
+
+    ~ScratchVector() {
+        if (on_heap) { delete[] data_; }
+    }
+
+  private:
+    T* data_;
+    size_t size_     = 0;
+    size_t capacity_ = 0;
+    bool on_heap     = false;
+    FrameArena* arena_;
+
+    void grow(size_t min_capacity) {
+        size_t new_capacity = capacity_ > 0 ? capacity_ : 1;
+        while (new_capacity < min_capacity) {
+            new_capacity *= 2;
+        }
+
+        T* new_data;
+        if (arena_) {
+            new_data = arena_->allocate<T>(new_capacity);
+        } else {
+            new_data = new T[new_capacity];
+            ++heap_allocations;
+        }
+        if (size_ > 0) { memcpy(new_data, data_, size_ * sizeof(T)); }
+        if (on_heap) { delete[] data_; }
+
+        data_     = new_data;
+        capacity_ = new_capacity;
+        on_heap   = arena_ == nullptr;
+    }
+};
+
+// ScratchVector with room for N elements inside the object itself, so it can
+// live on the stack without allocating for small sizes. With an arena, it
+// must not outlive the arena's next reset or rewind.
+template<typename T, size_t N>
+class SmallVector : public ScratchVector<T> {
+  public:
+    SmallVector() : ScratchVector<T>(inline_storage, N) {}
+    explicit SmallVector(FrameArena& arena)
+        : ScratchVector<T>(inline_storage, N, &arena) {}
+
+  private:
+    T inline_storage[N];
+};
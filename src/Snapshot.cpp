@@ -0,0 +1,126 @@
+#pragma once
+#include "Snapshot.h"
+#include <sdl/SDL_assert.h>
+
+static_assert(sizeof(WorldSnapshot) % sizeof(u32) == 0,
+              "Deltas work on whole words");
+
+// A delta is a list of runs. Every run starts with a header word that holds
+// the number of words that didn't change in the low 16 bits and the number of
+// changed words following the header in the high 16 bits.
+static const size_t MAX_RUN_WORDS = 0xFFFF;
+
+static u32 load_word(const u8* bytes) {
+    u32 word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+static void store_word(u8* bytes, u32 word) {
+    memcpy(bytes, &word, sizeof(word));
+}
+
+size_t encode_delta(const void* base,
+                    const void* data,
+                    size_t size,
+                    u8* buffer,
+                    size_t buffer_size) {
+    SDL_assert(size % sizeof(u32) == 0);
+
+    const u8* base_bytes = static_cast<const u8*>(base);
+    const u8* data_bytes = static_cast<const u8*>(data);
+    const size_t words   = size / sizeof(u32);
+
+    auto changes = [&](size_t word) {
+        return load_word(base_bytes + word * sizeof(u32))
+               ^ load_word(data_bytes + word * sizeof(u32));
+    };
+
+    size_t written = 0;
+    size_t word    = 0;
+    while (word < words) {
+        size_t unchanged = 0;
+        while (word < words && unchanged < MAX_RUN_WORDS
+               && changes(word) == 0) {
+            ++word;
+            ++unchanged;
+        }
+
+        size_t first_changed = word;
+        while (word < words && word - first_changed < MAX_RUN_WORDS
+               && changes(word) != 0) {
+            ++word;
+        }
+        size_t changed = word - first_changed;
+
+        // Trailing unchanged words don't need a run
+        if (changed == 0 && word == words) { break; }
+
+        if (written + (1 + changed) * sizeof(u32) > buffer_size) { return 0; }
+
+        store_word(buffer + written,
+                   static_cast<u32>(unchanged | changed << 16));
+        written += sizeof(u32);
+
+        for (size_t i = first_changed; i < word; ++i) {
+            store_word(buffer + written, changes(i));
+            written += sizeof(u32);
+        }
+    }
+
+    // An empty delta would look like a failure
+    if (written == 0) {
+        if (buffer_size < sizeof(u32)) { return 0; }
+        store_word(buffer, 0);
+        written = sizeof(u32);
+    }
+    return written;
+}
+
+void decode_delta(const void* base,
+                  const u8* delta,
+                  size_t delta_size,
+                  void* data,
+                  size_t size) {
+    SDL_assert(size % sizeof(u32) == 0 && delta_size % sizeof(u32) == 0);
+
+    const u8* base_bytes = static_cast<const u8*>(base);
+    u8* data_bytes       = static_cast<u8*>(data);
+
+    // Unchanged words, including the ones after the last run
+    memcpy(data_bytes, base_bytes, size);
+
+    size_t offset = 0;
+    size_t read   = 0;
+    while (read < delta_size) {
+        u32 header = load_word(delta + read);
+        read += sizeof(u32);
+
+        offset += (header & MAX_RUN_WORDS) * sizeof(u32);
+        size_t changed = header >> 16;
+
+        SDL_assert(offset + changed * sizeof(u32) <= size);
+        SDL_assert(read + changed * sizeof(u32) <= delta_size);
+        for (size_t i = 0; i < changed; ++i) {
+            u32 word = load_word(base_bytes + offset) ^ load_word(delta + read);
+            store_word(data_bytes + offset, word);
+            offset += sizeof(u32);
+            read += sizeof(u32);
+        }
+    }
+}
+
+size_t encode_snapshot_delta(const WorldSnapshot& base,
+                             const WorldSnapshot& snapshot,
+                             u8* buffer,
+                             size_t buffer_size) {
+    return encode_delta(
+      &base, &snapshot, sizeof(WorldSnapshot), buffer, buffer_size);
+}
+
+void decode_snapshot_delta(const WorldSnapshot& base,
+                           const u8* delta,
+                           size_t delta_size,
+                           WorldSnapshot& snapshot) {
+    decode_delta(&base, delta, delta_size, &snapshot, sizeof(WorldSnapshot));
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "Types.h"
+#include "World.h"
+
+// Plain copies of everything in a World that changes while it is simulated,
+// for rewinding, rollback and running parameter sweeps from the same starting
+// point. Snapshots have a fixed size and only contain 4 byte values (bools
+// and enums included), so there is no padding, saving and restoring never
+// allocates and two snapshots can be compared or diffed byte by byte.
+
+struct WeaponTrailSnapshot {
+    u32 num_vertices;
+    float trail_length;
+    // Oldest first, the unused ones are zeroed
+    TrailShader::Vertex vertices[WeaponTrail::MAX_VERTICES];
+};
+
+struct AnimatorSnapshot {
+    vec2 limb_spline_points[2][Spline::NUM_POINTS];
+    vec2 right_arm_target_position;
+    float step_distance_world;
+    float spine_rotation_target;
+    float interpolation_factor_between_splines;
+    float interpolation_factor_on_spline;
+    u32 leg_state, last_leg_state;
+    u32 idle_moving_forward;
+};
+
+struct PlayerSnapshot {
+    static const size_t MAX_BONES = 32;
+
+    vec2 position, last_tick_position, scale;
+    vec2 velocity;
+
+    u32 state;
+    u32 grounded;
+    u32 facing_right;
+    u32 can_double_jump;
+    u32 wall_direction;
+
+    float hit_cooldown;
+    float hitstun_duration;
+    float carried_bounce_time;
+    float freeze_duration;
+    float wall_jump_coyote_time;
+
+    Segment weapon_collider, last_weapon_collider;
+
+    // The unused ones are zeroed
+    u32 num_bones;
+    RiggedMesh::Pose pose[MAX_BONES];
+    RiggedMesh::Pose last_tick_pose[MAX_BONES];
+
+    AnimatorSnapshot animator;
+    WeaponTrailSnapshot weapon_trail;
+};
+
+struct BallSnapshot {
+    vec2 starting_position;  // Where it goes after a goal
+    vec2 position, last_tick_position, scale;
+    vec2 velocity;
+    float rotation, rotation_speed, last_tick_rotation;
+    u32 grounded;
+    float carried_time;
+    float freeze_duration;
+};
+
+struct WorldSnapshot {
+    PlayerSnapshot players[World::NUM_PLAYERS];
+    BallSnapshot ball;
+    u32 score[World::NUM_PLAYERS];
+};
+
+// Screen shake isn't part of the World, but a rewind should put it back as
+// well
+struct ScreenShakeSnapshot {
+    float intensity, duration, speed, noise_pos;
+};
+
+//              Delta encoding              //
+// Snapshots next to each other in time barely differ. A delta is the XOR of
+// a snapshot with an earlier one, with the runs of zero words cut out, so
+// thousands of them can be kept around. Deltas are only valid on the same
+// build and machine.
+
+// Size a delta of size bytes can grow to, in the worst case
+constexpr size_t max_delta_size(size_t size) {
+    return size + sizeof(u32) * (2 + size / sizeof(u32) / 0xFFFF);
+}
+
+static const size_t MAX_SNAPSHOT_DELTA_SIZE =
+  max_delta_size(sizeof(WorldSnapshot));
+
+// Writes the delta from base to data, both size bytes, into buffer. size has
+// to be a multiple of 4. Returns the size of the delta, or 0 if it didn't fit
+// into buffer_size.
+size_t encode_delta(const void* base,
+                    const void* data,
+                    size_t size,
+                    u8* buffer,
+                    size_t buffer_size);
+
+// Applies a delta from encode_delta() to base and writes the result to data
+void decode_delta(const void* base,
+                  const u8* delta,
+                  size_t delta_size,
+                  void* data,
+                  size_t size);
+
+size_t encode_snapshot_delta(const WorldSnapshot& base,
+                             const WorldSnapshot& snapshot,
+                             u8* buffer,
+                             size_t buffer_size);
+void decode_snapshot_delta(const WorldSnapshot& base,
+                           const u8* delta,
+                           size_t delta_size,
+                           WorldSnapshot& snapshot);
@@ -25,10 +25,7 @@ void Spline::init(const glm::vec2 points[NUM_POINTS]) {
     }
 
     // Init line render data
-    parameter_matrix = glm::mat4(glm::vec4(points_[P1], 0.0f, 1.0f),
-                                 glm::vec4(points_[P2], 0.0f, 1.0f),
-                                 glm::vec4(points_[T1], 0.0f, 1.0f),
-                                 glm::vec4(points_[T2], 0.0f, 1.0f));
+    update_parameter_matrix();
 
     if (vertices_initialized) {
         update_render_data();
@@ -63,8 +60,11 @@ void Spline::init(const glm::vec2 points[NUM_POINTS]) {
     }
 }
 
-void Spline::render(const Renderer& renderer, bool draw_points) const {
+#ifndef HEADLESS
+void Spline::render(const Renderer& renderer, bool draw_points) {
     SDL_assert(vertices_initialized);
+    if (render_data_outdated) { update_render_data(); }
+
     renderer.debug_shader.use();
     renderer.debug_shader.set_color(Color::GREEN);
 
@@ -72,6 +72,7 @@ void Spline::render(const Renderer& renderer, bool draw_points) const {
 
     if (draw_points) { point_vao.draw(GL_POINTS); }
 }
+#endif
 
 const glm::vec2& Spline::point(SplinePointName p) const {
     return points_[p];
@@ -85,7 +86,8 @@ void Spline::set_points(const glm::vec2 new_points[NUM_POINTS]) {
     for (size_t i = 0; i < NUM_POINTS; ++i) {
         points_[i] = new_points[i];
     }
-    update_render_data();
+    update_parameter_matrix();
+    render_data_outdated = true;
 }
 
 void Spline::set_point(SplinePointName name, glm::vec2 point) {
@@ -101,17 +103,15 @@ void Spline::set_point(SplinePointName name, glm::vec2 point) {
     } else {
         points_[T2] += point_delta;
     }
-    update_render_data();
+    update_parameter_matrix();
+    render_data_outdated = true;
 }
 
 void Spline::update_render_data() {
     SDL_assert(vertices_initialized);
 
     // Line
-    parameter_matrix = glm::mat4(glm::vec4(points_[P1], 0.0f, 1.0f),
-                                 glm::vec4(points_[P2], 0.0f, 1.0f),
-                                 glm::vec4(points_[T1], 0.0f, 1.0f),
-                                 glm::vec4(points_[T2], 0.0f, 1.0f));
+    update_parameter_matrix();
 
     for (size_t i = 0; i < RENDER_STEPS; ++i) {
         float t = static_cast<float>(i) / static_cast<float>(RENDER_STEPS - 1);
@@ -126,6 +126,14 @@ void Spline::update_render_data() {
     point_shader_vertices[1] = points_[P2];
 
     point_vao.update_vertex_data(point_shader_vertices);
+    render_data_outdated = false;
+}
+
+void Spline::update_parameter_matrix() {
+    parameter_matrix = glm::mat4(glm::vec4(points_[P1], 0.0f, 1.0f),
+                                 glm::vec4(points_[P2], 0.0f, 1.0f),
+                                 glm::vec4(points_[T1], 0.0f, 1.0f),
+                                 glm::vec4(points_[T2], 0.0f, 1.0f));
 }
 
 glm::vec2 Spline::get_point_on_spline(float t) const {
@@ -562,6 +570,7 @@ bool SplineEditor::update_gui() {
     return keep_open;
 }
 
+#ifndef HEADLESS
 void SplineEditor::render(const Renderer& renderer, bool spline_edit_mode) {
     renderer.debug_shader.use();
     glLineWidth(1.0f);
@@ -630,4 +639,5 @@ void SplineEditor::render(const Renderer& renderer, bool spline_edit_mode) {
             tangents_vao.draw(GL_POINTS);
         }
     }
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -19,7 +19,10 @@ class Spline {
     // The values of T1 and T2 are the coordinates relative to P1 and P2,
     // respectively.
     void init(const glm::vec2 points[NUM_POINTS] = nullptr);
-    void render(const Renderer& renderer, bool draw_points = false) const;
+
+    // Uploads the points first if they changed. Changing the points doesn't
+    // touch the GPU, so the simulation can do it on any thread.
+    void render(const Renderer& renderer, bool draw_points = false);
 
     const glm::vec2& point(SplinePointName p) const;
     const glm::vec2* points() const;
@@ -47,6 +50,9 @@ class Spline {
     std::array<DebugShader::Vertex, 2> point_shader_vertices;
 
     bool vertices_initialized = false;
+    bool render_data_outdated = false;
+
+    void update_parameter_matrix();
 
     // SplineEditor has to access the points and VertexArrays in order to
     // dislpay and modify them.
@@ -0,0 +1,78 @@
+#pragma once
+#include "TaskGraph.h"
+#include <sdl/SDL_assert.h>
+
+/////                                   /////
+/////             TaskGroup             /////
+/////                                   /////
+
+void TaskGroup::submit(ThreadPool* pool, ThreadPool::Task task) {
+    if (!pool) {
+        task();
+        return;
+    }
+
+    ++unfinished;
+    pool->submit([this, task = std::move(task)]() {
+        task();
+        --unfinished;
+    });
+}
+
+void TaskGroup::wait(ThreadPool* pool) {
+    while (unfinished > 0) {
+        if (!pool || !pool->run_pending_task()) { std::this_thread::yield(); }
+    }
+}
+
+/////                                   /////
+/////             TaskGraph             /////
+/////                                   /////
+
+TaskGraph::TaskId TaskGraph::add(ThreadPool::Task task,
+                                 std::initializer_list<TaskId> dependencies) {
+    TaskId id = nodes.size();
+    nodes.push_back({ std::move(task), {}, 0 });
+
+    for (TaskId dependency : dependencies) {
+        SDL_assert(dependency < id);
+        nodes[dependency].dependents.push_back(id);
+        ++nodes[id].num_dependencies;
+    }
+    return id;
+}
+
+void TaskGraph::clear() {
+    nodes.clear();
+}
+
+size_t TaskGraph::size() const noexcept {
+    return nodes.size();
+}
+
+void TaskGraph::run(ThreadPool* pool) {
+    if (remaining_capacity < nodes.size()) {
+        remaining          = std::make_unique<std::atomic<u32>[]>(nodes.size());
+        remaining_capacity = nodes.size();
+    }
+    for (TaskId id = 0; id < nodes.size(); ++id) {
+        remaining[id] = nodes[id].num_dependencies;
+    }
+
+    for (TaskId id = 0; id < nodes.size(); ++id) {
+        if (nodes[id].num_dependencies == 0) { start(pool, id); }
+    }
+    group.wait(pool);
+}
+
+void TaskGraph::start(ThreadPool* pool, TaskId id) {
+    group.submit(pool, [this, pool, id]() {
+        const Node& node = nodes[id];
+        node.task();
+
+        // The last dependency to finish starts the dependent
+        for (TaskId dependent : node.dependents) {
+            if (--remaining[dependent] == 0) { start(pool, dependent); }
+        }
+    });
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+#include "ThreadPool.h"
+#include "Types.h"
+
+// Tasks that can be waited for on their own, no matter what else runs on the
+// pool. Waiting runs other queued tasks in the meantime, so it works from
+// inside a task as well. Without a pool, tasks run right away on the calling
+// thread.
+class TaskGroup {
+  public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void submit(ThreadPool* pool, ThreadPool::Task task);
+    void wait(ThreadPool* pool);
+
+  private:
+    std::atomic<u32> unfinished = { 0 };
+};
+
+// Calls body(i) for every i in [0, count), in tasks of at least grain_size
+// indices. The calling thread runs the first one. Bodies must only change
+// what belongs to their own index, then the result is the same no matter how
+// many threads there are. Side effects that have an order, like events and
+// score, have to happen after parallel_for() returns.
+template<typename Body>
+void parallel_for(ThreadPool* pool,
+                  size_t count,
+                  size_t grain_size,
+                  const Body& body) {
+    if (grain_size == 0) { grain_size = 1; }
+    if (!pool || count <= grain_size) {
+        for (size_t i = 0; i < count; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    // No more tasks than threads to run them, the caller being one of them
+    size_t num_tasks = (count + grain_size - 1) / grain_size;
+    if (num_tasks > pool->num_threads() + 1) {
+        num_tasks = pool->num_threads() + 1;
+    }
+
+    TaskGroup group;
+    for (size_t task = 1; task < num_tasks; ++task) {
+        size_t begin = count * task / num_tasks;
+        size_t end   = count * (task + 1) / num_tasks;
+        group.submit(pool, [&body, begin, end]() {
+            for (size_t i = begin; i < end; ++i) {
+                body(i);
+            }
+        });
+    }
+
+    for (size_t i = 0, end = count / num_tasks; i < end; ++i) {
+        body(i);
+    }
+    group.wait(pool);
+}
+
+// Tasks with dependencies between them, run in one go. A task starts once
+// every task it depends on is done, tasks without dependencies between them
+// run in parallel. The graph can be run as often as needed, for per-frame work
+// it's built once and run every frame.
+class TaskGraph {
+  public:
+    typedef size_t TaskId;
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // Dependencies have to be added before the tasks that depend on them
+    TaskId add(ThreadPool::Task task,
+               std::initializer_list<TaskId> dependencies = {});
+    void clear();
+    size_t size() const noexcept;
+
+    // Returns when every task is done
+    void run(ThreadPool* pool);
+
+  private:
+    struct Node {
+        ThreadPool::Task task;
+        std::vector<TaskId> dependents;
+        u32 num_dependencies;
+    };
+    std::vector<Node> nodes;
+
+    // Dependencies of each node that aren't done yet during run()
+    std::unique_ptr<std::atomic<u32>[]> remaining;
+    size_t remaining_capacity = 0;
+
+    TaskGroup group;
+
+    void start(ThreadPool* pool, TaskId id);
+};
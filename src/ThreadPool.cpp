@@ -0,0 +1,129 @@
+#pragma once
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <sdl/SDL_assert.h>
+
+ThreadPool::ThreadPool(size_t num_threads, const char* name_) : name(name_) {
+    SDL_assert(num_threads > 0);
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    work_available.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    size_t index = current_pool == this
+                   ? current_index
+                   : next_queue.fetch_add(1) % queues.size();
+
+    // Counted before the task is in a queue, so the count never drops below
+    // zero. Done under the sleep mutex, so a worker that is just about to go
+    // to sleep can't miss it.
+    ++unfinished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++queued;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    work_available.notify_one();
+}
+
+void ThreadPool::wait() {
+    SDL_assert(current_pool != this);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    all_done.wait(lock, [this] { return unfinished == 0; });
+}
+
+bool ThreadPool::run_pending_task() {
+    // Threads from outside start with the first queue
+    size_t index = current_pool == this ? current_index : 0;
+
+    Task task;
+    if (!take(index, task)) { return false; }
+    task();
+
+    if (--unfinished == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        all_done.notify_all();
+    }
+    return true;
+}
+
+size_t ThreadPool::num_threads() const noexcept {
+    return workers.size();
+}
+
+u64 ThreadPool::num_steals() const noexcept {
+    return steals;
+}
+
+void ThreadPool::run(size_t index) {
+    current_pool  = this;
+    current_index = index;
+    Profiler::set_thread_name(name, static_cast<s32>(index));
+
+    Task task;
+    while (true) {
+        if (take(index, task)) {
+            task();
+            task = nullptr;
+
+            if (--unfinished == 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                all_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        work_available.wait(lock, [this] { return quit || queued > 0; });
+        if (quit) { return; }
+    }
+}
+
+bool ThreadPool::take(size_t index, Task& task) {
+    {  // Own queue first, newest task
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --queued;
+            return true;
+        }
+    }
+
+    // Steal the oldest task of someone else
+    for (size_t n = 1; n < queues.size(); ++n) {
+        Queue& other = *queues[(index + n) % queues.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            --queued;
+            ++steals;
+            return true;
+        }
+    }
+    return false;
+}
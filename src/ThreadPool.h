@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Types.h"
+
+// Runs tasks on a fixed number of worker threads. Every worker has its own
+// queue and works off its back. A worker that runs out of tasks steals from
+// the front of the other queues, so uneven tasks still keep all threads busy.
+class ThreadPool {
+  public:
+    typedef std::function<void()> Task;
+
+    // The workers show up in the Profiler as "name index"
+    explicit ThreadPool(size_t num_threads, const char* name = "Worker");
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Can be called from any thread. Tasks submitted from inside a task go to
+    // the queue of the worker running it.
+    void submit(Task task);
+
+    // Blocks until every task submitted so far, and every task those
+    // submitted, has finished. Don't call from inside a task.
+    void wait();
+
+    // Runs one queued task on the calling thread, if there is one. For
+    // threads that wait on some of the tasks and can help in the meantime,
+    // also from inside a task.
+    bool run_pending_task();
+
+    size_t num_threads() const noexcept;
+
+    // Number of tasks that were taken from another worker's queue
+    u64 num_steals() const noexcept;
+
+  private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    const char* name;
+
+    // Guards sleeping and waking up, the queues have their own mutexes
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    bool quit = false;
+
+    std::atomic<u64> queued     = { 0 };  // Waiting in one of the queues
+    std::atomic<u64> unfinished = { 0 };  // Submitted, but not done yet
+    std::atomic<u64> steals     = { 0 };
+    std::atomic<size_t> next_queue = { 0 };
+
+    // Set on the worker threads, so tasks submitted from them stay local
+    static inline thread_local ThreadPool* current_pool = nullptr;
+    static inline thread_local size_t current_index     = 0;
+
+    void run(size_t index);
+    bool take(size_t index, Task& task);
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
-#include <gl/glew.h>
+#include <GL/glew.h>
+#include "Platform.h"
 #include <glm/vec2.hpp>
 
 // Some typedefs, makes using integer types of specific sizes more readable and
@@ -6,17 +6,34 @@
 #include "Audio.cpp"
 #include "Background.cpp"
 #include "Ball.cpp"
+#include "BallPool.cpp"
+#include "Bot.cpp"
 #include "Collider.cpp"
+#include "ColliderTree.cpp"
 #include "CollisionDetection.cpp"
+#include "CollisionVerifier.cpp"
 #include "ConfigManager.cpp"
+#include "Counters.cpp"
+#include "DynamicBroadphase.cpp"
 #include "Entity.cpp"
+#include "FrameArena.cpp"
+#include "FramePacer.cpp"
 #include "Game.cpp"
+#include "GroundIndex.cpp"
 #include "Input.cpp"
 #include "Level.cpp"
 #include "Player.cpp"
+#include "Profiler.cpp"
+#include "RenderState.cpp"
+#include "Replay.cpp"
+#include "Rollback.cpp"
+#include "Snapshot.cpp"
 #include "Spline.cpp"
+#include "TaskGraph.cpp"
+#include "ThreadPool.cpp"
 #include "Util.cpp"
 #include "WeaponTrail.cpp"
+#include "World.cpp"
 #include "rendering/Color.cpp"
 #include "rendering/Mesh.cpp"
 #include "rendering/Renderer.cpp"
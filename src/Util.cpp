@@ -1,12 +1,25 @@
 #pragma once
+#include "Util.h"
+#ifdef _WIN32
 #include <shobjidl.h>
 #include <codecvt>
-#include "Util.h"
+#endif
 
 float length_squared(glm::vec2 v) {
     return v.x * v.x + v.y * v.y;
 }
 
+u64 add_to_checksum(u64 checksum, const void* data, size_t size) {
+    const u64 prime = 1099511628211ull;
+    const u8* bytes = static_cast<const u8*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        checksum ^= bytes[i];
+        checksum *= prime;
+    }
+    return checksum;
+}
+
+#ifdef _WIN32
 bool get_save_path(std::string& out_path,
                    cwstrptr_t filter_name,
                    cwstrptr_t filter_pattern,
@@ -110,4 +123,14 @@ bool get_load_path(std::string& out_path,
 
     CoUninitialize();
     return true;
-}
\ No newline at end of file
+}
+#else
+// No file dialogs outside of Windows, callers treat this like a cancelled one
+bool get_save_path(std::string&, cwstrptr_t, cwstrptr_t, cwstrptr_t) {
+    return false;
+}
+
+bool get_load_path(std::string&, cwstrptr_t, cwstrptr_t) {
+    return false;
+}
+#endif
\ No newline at end of file
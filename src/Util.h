@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include "Types.h"
 
 constexpr float PI = 3.14159265358979323846f;
 
@@ -16,6 +17,10 @@ T lerp(T a, T b, float t) {
 
 float length_squared(glm::vec2 v);
 
+// FNV-1a, for comparing simulation states
+static const u64 CHECKSUM_BASIS = 14695981039346656037ull;
+u64 add_to_checksum(u64 checksum, const void* data, size_t size);
+
 typedef const wchar_t* cwstrptr_t;
 bool get_save_path(std::string& path,
                    cwstrptr_t filter_name       = nullptr,
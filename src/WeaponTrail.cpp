@@ -1,5 +1,6 @@
 #pragma once
 #include "WeaponTrail.h"
+#include "Snapshot.h"
 #include "Util.h"
 #include <glm/gtx/vector_angle.hpp>
 
@@ -9,33 +10,24 @@ void WeaponTrail::init(const float* max_angle_between_segments_,
     max_trail_length           = max_trail_length_;
     min_new_segment_length     = *max_trail_length / MAX_VERTICES;
 
-    trail_length = 0.0f;
+    trail_length   = 0.0f;
+    first_position = 0;
+    num_positions  = 0;
 
     // update() expects there to be at least two elements in weapon_positions,
     // so add dummys here to start out with
-    weapon_positions.push_back({ vec2(0.0f), 0.0f });
-    weapon_positions.push_back({ vec2(0.0f), 0.0f });
+    push_back({ vec2(0.0f), 0.0f });
+    push_back({ vec2(0.0f), 0.0f });
 
     vao.init(nullptr, MAX_VERTICES, GL_DYNAMIC_DRAW);
 }
 
 void WeaponTrail::update(vec2 new_position) {
-    SDL_assert(weapon_positions.size() >= 2);
+    SDL_assert(num_positions >= 2);
 
-    if (weapon_positions.size() == 1) {
-        trail_length = glm::length(new_position - weapon_positions.front().pos);
-
-        SDL_assert(trail_length < *max_trail_length);
-        weapon_positions.push_back(
-          { new_position, trail_length / *max_trail_length });
-        return;
-    }
-
-    auto iterator      = weapon_positions.rbegin();
-    vec2 last_position = iterator->pos;
-    ++iterator;
-    vec2 last_segment = last_position - iterator->pos;
-    vec2 new_segment  = new_position - last_position;
+    vec2 last_position = position(num_positions - 1).pos;
+    vec2 last_segment  = last_position - position(num_positions - 2).pos;
+    vec2 new_segment   = new_position - last_position;
 
     float angle = glm::abs(glm::angle(new_segment, last_segment));
     if (angle > PI * 2.0f) { angle -= PI * 2.0f; }
@@ -50,37 +42,93 @@ void WeaponTrail::update(vec2 new_position) {
 
     SDL_assert(*max_angle_between_segments <= PI * 2.0f);
     if (new_segment_length == 0.0f || angle > *max_angle_between_segments) {
-        weapon_positions.clear();
-        weapon_positions.push_back({ last_position, 0.0f });
+        first_position = 0;
+        num_positions  = 0;
+        push_back({ last_position, 0.0f });
         trail_length = 0.0f;
     }
 
     trail_length += new_segment_length;
-    weapon_positions.push_back(
-      { new_position, trail_length / *max_trail_length });
+    push_back({ new_position, trail_length / *max_trail_length });
 
     SDL_assert(*max_trail_length > 0.0f);
     while (trail_length > *max_trail_length) {
         // Remove positions until the length is short enough again
-        auto it        = weapon_positions.begin();
-        vec2 first_pos = it->pos;
-        ++it;
-        vec2 segment = first_pos - it->pos;
-        weapon_positions.pop_front();
+        SDL_assert(num_positions >= 2);
+        vec2 segment = position(0).pos - position(1).pos;
+        pop_front();
 
         trail_length -= glm::length(segment);
     }
 }
 
-void WeaponTrail::render() {
-    std::vector<TrailShader::Vertex> ordered_vertices;
-    ordered_vertices.reserve(weapon_positions.size());
+u32 WeaponTrail::write_vertices(TrailShader::Vertex* vertices) const {
+    for (size_t i = 0; i < num_positions; ++i) {
+        vertices[i] = position(i);
+    }
+    return static_cast<u32>(num_positions);
+}
+
+#ifndef HEADLESS
+void WeaponTrail::render(const TrailShader::Vertex* vertices,
+                         u32 num_vertices) {
+    vao.update_vertex_data(vertices, num_vertices);
 
-    for (const auto& pos : weapon_positions) {
-        ordered_vertices.push_back(pos);
+    vao.draw(GL_LINE_STRIP, num_vertices);
+}
+#endif
+
+void WeaponTrail::save(WeaponTrailSnapshot& snapshot) const {
+    snapshot.num_vertices = static_cast<u32>(num_positions);
+    snapshot.trail_length = trail_length;
+
+    size_t i = 0;
+    for (; i < num_positions; ++i) {
+        snapshot.vertices[i] = position(i);
     }
+    // Unused entries are zeroed, so they don't show up in deltas
+    for (; i < MAX_VERTICES; ++i) {
+        snapshot.vertices[i] = { vec2(0.0f), 0.0f };
+    }
+}
+
+void WeaponTrail::restore(const WeaponTrailSnapshot& snapshot) {
+    SDL_assert(snapshot.num_vertices <= MAX_VERTICES);
 
-    vao.update_vertex_data(ordered_vertices);
+    first_position = 0;
+    num_positions  = snapshot.num_vertices;
+    trail_length   = snapshot.trail_length;
 
-    vao.draw(GL_LINE_STRIP, static_cast<GLuint>(ordered_vertices.size()));
-}
\ No newline at end of file
+    for (size_t i = 0; i < num_positions; ++i) {
+        weapon_positions[i] = snapshot.vertices[i];
+    }
+}
+
+TrailShader::Vertex& WeaponTrail::position(size_t index) {
+    SDL_assert(index < num_positions);
+    return weapon_positions[(first_position + index) % MAX_VERTICES];
+}
+
+const TrailShader::Vertex& WeaponTrail::position(size_t index) const {
+    SDL_assert(index < num_positions);
+    return weapon_positions[(first_position + index) % MAX_VERTICES];
+}
+
+void WeaponTrail::push_back(const TrailShader::Vertex& vertex) {
+    if (num_positions == MAX_VERTICES) {
+        // Only happens when max_trail_length was raised after init(), the
+        // oldest position makes room
+        trail_length -= glm::length(position(1).pos - position(0).pos);
+        pop_front();
+    }
+
+    weapon_positions[(first_position + num_positions) % MAX_VERTICES] =
+      vertex;
+    ++num_positions;
+}
+
+void WeaponTrail::pop_front() {
+    SDL_assert(num_positions > 0);
+    first_position = (first_position + 1) % MAX_VERTICES;
+    --num_positions;
+}
@@ -1,23 +1,44 @@
 #pragma once
 #include "rendering/Renderer.h"
 #include "Types.h"
-#include <list>
+#include <array>
+
+struct WeaponTrailSnapshot;
 
 class WeaponTrail {
+  public:
     static const size_t MAX_VERTICES = 400;
 
-    std::list<TrailShader::Vertex> weapon_positions;
+  private:
+    // Ring buffer of the last positions, so the trail never allocates.
+    // Position i (oldest first) is at (first_position + i) % MAX_VERTICES.
+    std::array<TrailShader::Vertex, MAX_VERTICES> weapon_positions;
+    size_t first_position = 0;
+    size_t num_positions  = 0;
+
     VertexArray<TrailShader::Vertex> vao;
 
     const float* max_angle_between_segments;
     const float* max_trail_length;
     float min_new_segment_length;
 
+    TrailShader::Vertex& position(size_t index);
+    const TrailShader::Vertex& position(size_t index) const;
+    void push_back(const TrailShader::Vertex& vertex);
+    void pop_front();
+
   public:
     float trail_length;
 
     void init(const float* max_angle_between_segments_,
               const float* max_trail_length_);
     void update(vec2 new_position);
-    void render();
-};
\ No newline at end of file
+
+    // Copies the positions oldest first into vertices, which needs room for
+    // MAX_VERTICES, and returns how many there are
+    u32 write_vertices(TrailShader::Vertex* vertices) const;
+    void render(const TrailShader::Vertex* vertices, u32 num_vertices);
+
+    void save(WeaponTrailSnapshot& snapshot) const;
+    void restore(const WeaponTrailSnapshot& snapshot);
+};
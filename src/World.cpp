@@ -0,0 +1,539 @@
+#pragma once
+#include "World.h"
+#include "CollisionDetection.h"
+#include "Snapshot.h"
+#include "Profiler.h"
+
+void WorldEvents::clear() {
+    sounds.clear();
+    hits.clear();
+    weapons_collided = false;
+}
+
+void World::init(const Gamepad* gamepads,
+                 vec2 ball_position,
+                 size_t num_players) {
+    // Level
+    level.load_from_file("../assets/default.level");
+
+    player_model.load("../assets/playerTexture.png", "../assets/guy.fbx");
+
+    // Ball
+    ball.init(ball_position, "../assets/ball.png", &config.ball);
+    ball_start_position = ball_position;
+    party_balls.init("../assets/ball.png", &config.ball);
+
+    spawn_players(gamepads, num_players);
+}
+
+void World::spawn_players(const Gamepad* gamepads, size_t num_players) {
+    SDL_assert(num_players >= NUM_PLAYERS);
+
+    players.clear();
+    players.resize(num_players);
+    player_kinematics.reset(num_players);
+
+    // The extra players are lined up on both sides of the first two, close
+    // together so even a lot of them stay above the ground
+    const glm::vec3 start_position = { 960.0f, 271.0f, 0.0f };
+    for (size_t i = 0; i < num_players; ++i) {
+        glm::vec3 position = start_position;
+        if (i < NUM_PLAYERS) {
+            position.x += 50.0f * static_cast<float>(i);
+        } else {
+            float offset = 25.0f * static_cast<float>(i / 2);
+            position.x += i % 2 == 0 ? -offset : offset + 50.0f;
+        }
+
+        players[i].init(position,
+                        glm::vec3(100.0f, 100.0f, 1.0f),
+                        player_model,
+                        &gamepads[i],
+                        &config.player,
+                        &player_kinematics,
+                        i,
+                        level);
+    }
+
+    ball.reset();
+    score[0] = 0;
+    score[1] = 0;
+
+    add_proxies();
+
+    auto& moves = player_moves;
+    moves.active.resize(num_players);
+    moves.new_positions.resize(num_players);
+    moves.new_velocities.resize(num_players);
+    moves.bounces.resize(num_players);
+    moves.bounce_results.resize(num_players);
+    moves.bouncing.resize(num_players);
+    moves.moves.resize(num_players);
+    moves.first_collisions.resize(num_players);
+    moves.moving.resize(num_players);
+    moves.remaining_moves.resize(num_players);
+    moves.second_collisions.resize(num_players);
+    moves.remaining.resize(num_players);
+}
+
+void World::spawn_party_balls(size_t count) {
+    party_balls.clear();
+
+    // Rows of balls above the match ball, every other one moving sideways so
+    // they start bumping into each other right away
+    const size_t COLUMNS = 12;
+    const float spacing  = config.ball.radius * 2.5f;
+    for (size_t i = 0; i < count; ++i) {
+        float column = static_cast<float>(i % COLUMNS);
+        float row    = static_cast<float>(i / COLUMNS + 1);
+        vec2 position =
+          ball_start_position
+          + vec2((column - (COLUMNS - 1) * 0.5f) * spacing, row * spacing);
+        vec2 velocity = vec2(i % 2 == 0 ? 3.0f : -3.0f, 0.0f);
+        party_balls.spawn(position, velocity);
+    }
+
+    add_proxies();
+}
+
+bool World::is_match() const noexcept {
+    return players.size() == NUM_PLAYERS && party_balls.size() == 0;
+}
+
+void World::add_proxies() {
+    dynamic_broadphase.clear();
+
+    const size_t num_players = players.size();
+    weapon_proxies.resize(num_players);
+    for (u32 i = 0; i < num_players; ++i) {
+        weapon_proxies[i] =
+          dynamic_broadphase.add(DynamicBroadphase::WEAPON,
+                                 DynamicBroadphase::WEAPON
+                                   | DynamicBroadphase::BALL
+                                   | DynamicBroadphase::PARTY_BALL,
+                                 i,
+                                 i);
+    }
+    ball_proxy = dynamic_broadphase.add(
+      DynamicBroadphase::BALL, DynamicBroadphase::WEAPON, 0);
+
+    party_ball_proxies.resize(party_balls.size());
+    for (u32 i = 0; i < party_balls.size(); ++i) {
+        party_ball_proxies[i] = dynamic_broadphase.add(
+          DynamicBroadphase::PARTY_BALL,
+          DynamicBroadphase::WEAPON | DynamicBroadphase::PARTY_BALL,
+          i);
+    }
+}
+
+void World::begin_tick() {
+    for (auto& player : players) {
+        player.begin_tick();
+    }
+    ball.begin_tick();
+    party_balls.begin_tick();
+}
+
+void World::simulate(float delta_time, WorldEvents& events) {
+    PROFILE_SCOPE("World::simulate");
+    events.clear();
+
+    const size_t num_players = players.size();
+
+    // The phases below only go through the kinematics they need, instead of
+    // whole players
+    auto& velocities       = player_kinematics.velocities;
+    auto& states           = player_kinematics.states;
+    auto& grounded         = player_kinematics.grounded;
+    auto& freeze_durations = player_kinematics.freeze_durations;
+    auto& carried_times    = player_kinematics.carried_bounce_times;
+
+    // Players are simulated in phases so the collision queries of all of
+    // them can go to the level in batches.
+    auto& active = player_moves.active;
+    for (size_t i = 0; i < num_players; ++i) {
+        active[i] = freeze_durations[i] <= 0.0f;
+        if (!active[i]) { freeze_durations[i] -= delta_time; }
+    }
+
+    // update() only changes the player itself, everything between players
+    // happens in the phases after this
+    parallel_for(jobs, num_players, 1, [&](size_t i) {
+        if (active[i]) { players[i].update(delta_time, level, jobs); }
+    });
+
+    //              Resolve collisions              //
+    auto& new_player_positions  = player_moves.new_positions;
+    auto& new_player_velocities = player_moves.new_velocities;
+
+    // Body collisions with level. Players in hitstun bounce off of it,
+    // everybody else slides along it.
+    auto& bounces          = player_moves.bounces;
+    auto& moves            = player_moves.moves;
+    auto& bouncing_players = player_moves.bouncing;
+    auto& moving_players   = player_moves.moving;
+    size_t num_bouncing = 0, num_moving = 0;
+
+    for (size_t i = 0; i < num_players; ++i) {
+        if (!active[i]) continue;
+        new_player_velocities[i] = velocities[i];
+
+        if (states[i] == PlayerKinematics::HITSTUN) {
+            bounces[num_bouncing] = { players[i].body_collider(),
+                                      velocities[i],
+                                      delta_time + carried_times[i],
+                                      1.0f };
+            bouncing_players[num_bouncing++] = i;
+        } else {
+            carried_times[i] = 0.0f;
+
+            moves[num_moving] = { players[i].body_collider(),
+                                  velocities[i] * delta_time };
+            moving_players[num_moving++] = i;
+        }
+    }
+
+    {
+        auto& results = player_moves.bounce_results;
+        get_ballistic_move_results(
+          bounces.data(),
+          num_bouncing,
+          level.collider_tree,
+          results.data(),
+          static_cast<size_t>(glm::max(config.player.max_bounces_per_tick, 1)));
+
+        for (size_t n = 0; n < num_bouncing; ++n) {
+            size_t i                 = bouncing_players[n];
+            new_player_positions[i]  = results[n].new_position;
+            new_player_velocities[i] = results[n].new_velocity;
+            carried_times[i] = glm::min(results[n].remaining_time, delta_time);
+
+            if (results[n].last_hit_diretcion != Direction::NONE) {
+                events.sounds.push_back(Sound::WALL_BOUNCE);
+            }
+        }
+    }
+
+    {
+        auto& first_collisions = player_moves.first_collisions;
+        find_first_collisions_moving_circles(moves.data(),
+                                             num_moving,
+                                             level.collider_tree,
+                                             first_collisions.data());
+
+        // Players that hit something keep moving along it with the rest of
+        // their move
+        auto& remaining_moves  = player_moves.remaining_moves;
+        auto& remaining_movers = player_moves.remaining;
+        size_t num_remaining   = 0;
+
+        for (size_t n = 0; n < num_moving; ++n) {
+            size_t i                      = moving_players[n];
+            vec2 player_move              = moves[n].move;
+            CollisionData first_collision = first_collisions[n];
+
+            if (first_collision.direction == Direction::NONE) {
+                new_player_positions[i] = players[i].position() + player_move;
+                continue;
+            }
+
+            vec2 remaining_player_move;
+            if (first_collision.direction == Direction::DOWN
+                || first_collision.direction == Direction::UP) {
+
+                new_player_velocities[i].y = 0.0f;
+
+                remaining_player_move =
+                  vec2(player_move.x * (1.0f - first_collision.t), 0.0f);
+
+            } else {
+                SDL_assert(first_collision.direction == Direction::LEFT
+                           || first_collision.direction == Direction::RIGHT);
+                new_player_velocities[i].x = 0.0f;
+
+                remaining_player_move =
+                  vec2(0.0f, player_move.y - (1.0f - first_collision.t));
+
+                if (!grounded[i]) {
+                    player_kinematics.wall_directions[i] =
+                      first_collision.direction;
+                    states[i]       = PlayerKinematics::WALL_CLING;
+                    velocities[i].y = 0.0f;
+                }
+            }
+
+            Circle body_collider = players[i].body_collider();
+            body_collider.center = first_collision.position;
+
+            remaining_moves[num_remaining]    = { body_collider,
+                                               remaining_player_move };
+            remaining_movers[num_remaining++] = n;
+        }
+
+        auto& second_collisions = player_moves.second_collisions;
+        find_first_collisions_moving_circles(remaining_moves.data(),
+                                             num_remaining,
+                                             level.collider_tree,
+                                             second_collisions.data());
+
+        for (size_t r = 0; r < num_remaining; ++r) {
+            size_t n                              = remaining_movers[r];
+            size_t i                              = moving_players[n];
+            const CollisionData& first_collision  = first_collisions[n];
+            const CollisionData& second_collision = second_collisions[r];
+
+            SDL_assert(second_collision.direction
+                       != first_collision.direction);
+
+            if (second_collision.direction != Direction::NONE) {
+                // The player hit a corner, can't move any further
+                new_player_velocities[i] = vec2(0.0f);
+            } else if (second_collision.direction == Direction::LEFT
+                       || second_collision.direction == Direction::RIGHT) {
+                if (!grounded[i]) {
+                    player_kinematics.wall_directions[i] =
+                      second_collision.direction;
+                    states[i] = PlayerKinematics::WALL_CLING;
+                    SDL_assert(velocities[i].y == 0.0f);
+                }
+            }
+
+            new_player_positions[i] = second_collision.position;
+        }
+    }
+
+    for (size_t i = 0; i < num_players; ++i) {
+        if (!active[i]) continue;
+        Point new_player_position = new_player_positions[i];
+        vec2 new_player_velocity  = new_player_velocities[i];
+
+        if (states[i] != PlayerKinematics::HITSTUN
+            && states[i] != PlayerKinematics::WALL_CLING) {
+            // Keep player above ground, check grounded status
+            auto ground_under_player =
+              level.find_ground_under(new_player_position);
+            if (!ground_under_player
+                || new_player_position.y - ground_under_player->max(1)
+                     > config.player.ground_hover_distance
+                         + 2.0f /* small tolerance */) {
+
+                grounded[i] = false;
+                states[i]   = PlayerKinematics::FALLING;
+
+            } else {
+                new_player_velocity.y = std::max(new_player_velocity.y, 0.0f);
+                new_player_position.y =
+                  ground_under_player->max(1)
+                  + config.player.ground_hover_distance;
+
+                grounded[i]                          = true;
+                player_kinematics.can_double_jump[i] = true;
+                if (states[i] == PlayerKinematics::FALLING) {
+                    states[i] = PlayerKinematics::STANDING;
+                }
+            }
+        }
+
+        if (!grounded[i] && states[i] != PlayerKinematics::WALL_CLING) {
+            new_player_velocity.y -= config.player.gravity;
+        }
+
+        velocities[i]        = new_player_velocity;
+        players[i].position_ = new_player_position;
+    }  // End for each player
+
+    // Collisions between players, weapons and the ball
+    for (size_t i = 0; i < num_players; ++i) {
+        dynamic_broadphase.set_bounds(weapon_proxies[i],
+                                      players[i].weapon_collider);
+    }
+    dynamic_broadphase.set_bounds(ball_proxy, ball.collider());
+    for (size_t i = 0; i < party_balls.size(); ++i) {
+        dynamic_broadphase.set_bounds(party_ball_proxies[i],
+                                      party_balls.collider(i));
+    }
+
+    auto& pairs = broadphase_pairs;
+    pairs.clear();
+    dynamic_broadphase.find_pairs(pairs);
+
+    // Pairs are sorted by proxy id, so weapons are handled in player order
+    for (const auto& pair : pairs) {
+        const auto& a = dynamic_broadphase.proxy(pair.a);
+        const auto& b = dynamic_broadphase.proxy(pair.b);
+
+        if (a.group == DynamicBroadphase::PARTY_BALL) {
+            // Party ball vs. party ball
+            party_balls.collide(a.index, b.index);
+        } else if (b.group == DynamicBroadphase::PARTY_BALL) {
+            // Weapon vs. party ball, no cooldown and the player isn't frozen
+            const auto& player    = players[a.index];
+            const Segment& weapon = player.weapon_collider;
+
+            float t;
+            if (glm::length(weapon.line()) > player.body_collider().radius
+                && intersect_segment_circle(
+                  weapon, party_balls.collider(b.index), &t)) {
+                vec2 hit_direction = glm::normalize(
+                  player.weapon_collider.b - player.last_weapon_collider.b);
+
+                const float& trail_length = player.weapon_trail.trail_length;
+
+                vec2 hit_velocity = hit_direction * trail_length
+                                  * config.player.hit_speed_multiplier * t;
+
+                party_balls.hit(b.index,
+                                hit_velocity,
+                                config.hit_freeze_duration * trail_length);
+            }
+        } else if (b.group == DynamicBroadphase::WEAPON) {
+            // Weapon vs. weapon
+            const Segment& weapon_a = players[a.index].weapon_collider;
+            const Segment& weapon_b = players[b.index].weapon_collider;
+            if (weapon_a.line() == glm::vec2(0.0f)
+                && weapon_b.line() == glm::vec2(0.0f)) {
+                continue;
+            }
+
+            float t;
+            Point collision_pos;
+            if (intersect_segment_segment(
+                  weapon_a, weapon_b, &t, &collision_pos)) {
+                events.weapons_collided       = true;
+                events.weapon_collision_point = collision_pos;
+            }
+        } else {
+            // Weapon vs. ball
+            auto& player          = players[a.index];
+            const Segment& weapon = player.weapon_collider;
+
+            float t;
+            if (player_kinematics.hit_cooldowns[a.index] <= 0.0f
+                && glm::length(weapon.line()) > player.body_collider().radius
+                && intersect_segment_circle(weapon, ball.collider(), &t)) {
+
+                // The ball was hit
+                vec2 hit_direction = glm::normalize(
+                  player.weapon_collider.b - player.last_weapon_collider.b);
+
+                const float& trail_length = player.weapon_trail.trail_length;
+
+                vec2 hit_velocity = hit_direction * trail_length
+                                  * config.player.hit_speed_multiplier * t;
+
+                ball.set_velocity(hit_velocity);
+
+                player_kinematics.hit_cooldowns[a.index] =
+                  config.player.max_hit_cooldown;
+
+                const float freeze_duration =
+                  config.hit_freeze_duration * trail_length;
+
+                freeze_durations[a.index] = freeze_duration;
+                ball.freeze_duration      = freeze_duration;
+
+                events.hits.push_back(
+                  { a.index, trail_length, freeze_duration });
+                events.sounds.push_back(Sound::HIT_2);
+            }
+        }
+    }
+
+    // Ball vs. goal
+    {
+        const Circle ball_collider = ball.collider();
+        const AABB ball_bounds     = { ball_collider.center,
+                                   Vector(ball_collider.radius) };
+
+        SmallVector<const AABB*, 16> goal_colliders;
+        bool goal_hit = false;
+        for (uint i = 0; i < 2; ++i) {
+            goal_colliders.clear();
+            level.collider_tree.find_candidates(
+              ball_bounds, goal_colliders, ColliderTree::goal_group(i));
+
+            for (const auto coll : goal_colliders) {
+                if (test_circle_AABB(ball_collider, *coll)) {
+                    ball.reset();
+                    score[i] += 1;
+                    goal_hit = true;
+                    break;
+                }
+            }
+            if (goal_hit) break;
+        }
+    }
+
+    // Party balls vs. goal, one level traversal per goal and batch of balls.
+    // A crowd in front of a goal finds more candidates than fit inline, those
+    // go to the arena instead of the heap.
+    {
+        FrameArena::Scope scratch(FrameArena::local());
+        SmallVector<ColliderTree::Candidate, 16> goal_colliders(
+          FrameArena::local());
+
+        for (uint i = 0; i < 2; ++i) {
+            const size_t BATCH_SIZE = ColliderTree::MAX_BATCH_SIZE;
+            for (size_t first = 0; first < party_balls.size();
+                 first += BATCH_SIZE) {
+                size_t count =
+                  std::min(BATCH_SIZE, party_balls.size() - first);
+
+                AABB ball_bounds[BATCH_SIZE];
+                for (size_t n = 0; n < count; ++n) {
+                    const Circle ball_collider =
+                      party_balls.collider(first + n);
+                    ball_bounds[n] = { ball_collider.center,
+                                       Vector(ball_collider.radius) };
+                }
+
+                goal_colliders.clear();
+                level.collider_tree.find_candidates(
+                  ball_bounds,
+                  count,
+                  goal_colliders,
+                  ColliderTree::goal_group(i));
+
+                for (const auto& candidate : goal_colliders) {
+                    size_t n = first + candidate.area;
+                    if (test_circle_AABB(party_balls.collider(n),
+                                         *candidate.box)) {
+                        party_balls.reset(n);
+                        score[i] += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    ball.update(delta_time, level.collider_tree, events);
+    party_balls.update(delta_time, level.collider_tree, events);
+
+    ballistic_move_stats = BallisticMoveStats::take();
+}
+
+void World::save(WorldSnapshot& snapshot) const {
+    SDL_assert(is_match());
+    for (size_t i = 0; i < NUM_PLAYERS; ++i) {
+        players[i].save(snapshot.players[i]);
+        snapshot.score[i] = score[i];
+    }
+    ball.save(snapshot.ball);
+}
+
+void World::restore(const WorldSnapshot& snapshot) {
+    SDL_assert(is_match());
+    for (size_t i = 0; i < NUM_PLAYERS; ++i) {
+        players[i].restore(snapshot.players[i]);
+        score[i] = snapshot.score[i];
+    }
+    ball.restore(snapshot.ball);
+}
+
+const DynamicBroadphase& World::broadphase() const noexcept {
+    return dynamic_broadphase;
+}
+
+const BallisticMoveStats& World::last_tick_move_stats() const noexcept {
+    return ballistic_move_stats;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <vector>
+#include "Types.h"
+#include "Player.h"
+#include "Ball.h"
+#include "BallPool.h"
+#include "Level.h"
+#include "Audio.h"
+#include "Input.h"
+#include "CollisionDetection.h"
+#include "DynamicBroadphase.h"
+#include "SmallVector.h"
+#include "TaskGraph.h"
+
+struct WorldSnapshot;
+
+// Everything that happened during a tick that is up to the presentation, like
+// sounds and screen shake. The simulation itself never touches audio or the
+// renderer, so it can run without either.
+struct WorldEvents {
+    struct Hit {
+        u32 player;
+        float strength;  // Length of the weapon trail
+        float duration;  // How long player and ball are frozen
+    };
+
+    SmallVector<Sound, 8> sounds;
+    SmallVector<Hit, 4> hits;
+
+    bool weapons_collided = false;
+    Point weapon_collision_point;
+
+    void clear();
+};
+
+// Configurable constants of a World and everything in it
+struct WorldConfig {
+    PlayerConfig player;
+    BallConfig ball;
+
+    // Per unit of weapon trail length
+    float hit_freeze_duration = 30.0f;
+};
+
+// The simulated part of the game: players, ball, level and score. Doesn't
+// need a window, GL context or audio device. Worlds share no state, so any
+// number of them can run on different threads.
+class World {
+  public:
+    // Players of a match, one per goal. Snapshots, replays and rollback only
+    // work with exactly these, any players after them are extras like bots in
+    // stress tests.
+    static const size_t NUM_PLAYERS = 2;
+
+    // Players and ball keep pointing into this, so a World must not be moved
+    // after init()
+    WorldConfig config;
+
+    // Loaded once, players only copy the bones
+    PlayerModel player_model;
+
+    // Sized by spawn_players() only, players are pointed into as well. How
+    // they move is in player_kinematics.
+    std::vector<Player> players;
+    Ball ball;
+    Level level;
+
+    // Extra balls for party modes, they score like the match ball
+    BallPool party_balls;
+
+    uint score[2] = { 0, 0 };
+
+    // Optional, players and their limbs are updated in parallel on it. The
+    // outcome is the same with or without.
+    ThreadPool* jobs = nullptr;
+
+    World() = default;
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+
+    // gamepads needs one Gamepad per player
+    void init(const Gamepad* gamepads,
+              vec2 ball_position,
+              size_t num_players = NUM_PLAYERS);
+
+    // Replaces all players with new ones and restarts the match, without
+    // loading the level and models again
+    void spawn_players(const Gamepad* gamepads, size_t num_players);
+
+    // Replaces the party balls with count new ones, dropped from above the
+    // match ball's starting position
+    void spawn_party_balls(size_t count);
+
+    // Only the NUM_PLAYERS players and the match ball. Snapshots, replays and
+    // rollback need a plain match.
+    bool is_match() const noexcept;
+
+    // Call before every tick, remembers the state to interpolate from
+    void begin_tick();
+    void simulate(float delta_time, WorldEvents& events);
+
+    // Copies everything that changes during simulate() from/to snapshot, the
+    // config and level aren't part of it. Only for plain matches.
+    void save(WorldSnapshot& snapshot) const;
+    void restore(const WorldSnapshot& snapshot);
+
+    const DynamicBroadphase& broadphase() const noexcept;
+    const BallisticMoveStats& last_tick_move_stats() const noexcept;
+
+  private:
+    DynamicBroadphase dynamic_broadphase;
+    std::vector<u32> weapon_proxies;
+    u32 ball_proxy;
+    std::vector<u32> party_ball_proxies;
+    SmallVector<DynamicBroadphase::Pair, 32> broadphase_pairs;
+
+    vec2 ball_start_position;
+
+    // Velocity, state and timers of the players, indexed like players. Reset
+    // by spawn_players(), every player points into it.
+    PlayerKinematics player_kinematics;
+
+    // What the collision phases of simulate() work on, one array per field so
+    // every phase only touches the data it needs. Sized by spawn_players(),
+    // ticks don't allocate.
+    struct {
+        std::vector<u8> active;  // Not frozen
+        std::vector<Point> new_positions;
+        std::vector<vec2> new_velocities;
+
+        // Players in hitstun bounce off the level, everybody else slides
+        std::vector<BallisticMove> bounces;
+        std::vector<BallisticMoveResult> bounce_results;
+        std::vector<size_t> bouncing;
+
+        std::vector<SweptCircle> moves;
+        std::vector<CollisionData> first_collisions;
+        std::vector<size_t> moving;
+
+        std::vector<SweptCircle> remaining_moves;
+        std::vector<CollisionData> second_collisions;
+        std::vector<size_t> remaining;
+    } player_moves;
+
+    BallisticMoveStats ballistic_move_stats = {};
+
+    // Proxies of everything that is there, in player, ball, party ball order
+    void add_proxies();
+};
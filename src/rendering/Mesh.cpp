@@ -4,6 +4,7 @@
 #include <assimp/postprocess.h>
 #include "Mesh.h"
 #include "../Util.h"
+#include "../Counters.h"
 
 const std::string& Bone::name() const noexcept {
     return name_;
@@ -19,20 +20,21 @@ const glm::mat3& Bone::inverse_bind_pose_transform() const {
 }
 
 glm::mat3 Bone::transform() const {
+    Counters::add(Counter::BONE_TRANSFORMS);
+    glm::mat3 this_transform = local_transform(rotation, length);
+
+    // Recurse until there's no parent
+    if (parent_) { return parent_->transform() * this_transform; }
+    return this_transform;
+}
+
+glm::mat3 Bone::local_transform(float pose_rotation, float pose_length) const {
     glm::mat3 scale = glm::scale(
       glm::mat3(1.0f),
-      glm::vec2(length / original_length, length / original_length));
-
-    if (parent_) {
-        // Recurse until there's no parent
-        glm::mat3 this_transform = bind_pose_transform_
-                                   * glm::rotate(glm::mat3(1.0f), rotation)
-                                   * scale * inverse_bind_pose_transform_;
-        return parent_->transform() * this_transform;
-    }
+      glm::vec2(pose_length / original_length, pose_length / original_length));
 
-    return bind_pose_transform_ * glm::rotate(glm::mat3(1.0f), rotation) * scale
-           * inverse_bind_pose_transform_;
+    return bind_pose_transform_ * glm::rotate(glm::mat3(1.0f), pose_rotation)
+           * scale * inverse_bind_pose_transform_;
 }
 
 glm::vec2 Bone::head() const {
@@ -46,6 +48,24 @@ glm::vec2 Bone::tail_bind_pose() const noexcept {
     return bind_pose_transform_ * glm::vec3(tail_, 1.0f);
 }
 
+RiggedMesh::RiggedMesh(const RiggedMesh& other) {
+    *this = other;
+}
+
+RiggedMesh& RiggedMesh::operator=(const RiggedMesh& other) {
+    vao       = other.vao;
+    bones_vao = other.bones_vao;
+    bones     = other.bones;
+
+    // The parents have to point into the copied bones
+    for (auto& bone : bones) {
+        if (bone.parent_) {
+            bone.parent_ = &bones[bone.parent_ - other.bones.data()];
+        }
+    }
+    return *this;
+}
+
 Bone* RiggedMesh::find_bone(const char* str) {
     for (uint i = 0; i < bones.size(); ++i) {
         if (bones[i].name().compare(str) == 0) { return &bones[i]; }
@@ -54,6 +74,37 @@ Bone* RiggedMesh::find_bone(const char* str) {
     return nullptr;
 }
 
+void RiggedMesh::store_pose(std::vector<Pose>& pose) const {
+    pose.resize(bones.size());
+    for (size_t i = 0; i < bones.size(); ++i) {
+        pose[i] = { bones[i].rotation, bones[i].length };
+    }
+}
+
+void RiggedMesh::interpolated_transforms(const std::vector<Pose>& from,
+                                         float alpha,
+                                         glm::mat3* transforms) const {
+    SDL_assert(from.size() == bones.size());
+    for (size_t i = 0; i < bones.size(); ++i) {
+        transforms[i] = interpolated_transform(i, from, alpha);
+    }
+}
+
+glm::mat3 RiggedMesh::interpolated_transform(size_t bone,
+                                             const std::vector<Pose>& from,
+                                             float alpha) const {
+    const Bone& b = bones[bone];
+    glm::mat3 this_transform =
+      b.local_transform(glm::mix(from[bone].rotation, b.rotation, alpha),
+                        glm::mix(from[bone].length, b.length, alpha));
+
+    if (b.parent()) {
+        size_t parent = b.parent() - bones.data();
+        return interpolated_transform(parent, from, alpha) * this_transform;
+    }
+    return this_transform;
+}
+
 void load_character_model_from_file(const char* path,
                                     Mesh& body_mesh,
                                     RiggedMesh& rigged_mesh) {
@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 #include "../Types.h"
 #include "Shaders.h"
 
@@ -24,6 +25,10 @@ class Bone {
     // extension, all parents of the bone) to a vector in mesh space.
     glm::mat3 transform() const;
 
+    // Transformation of this bone alone (without its parents) in the given
+    // pose
+    glm::mat3 local_transform(float pose_rotation, float pose_length) const;
+
     // Current position of the bone's head (affacted by parent bones) in mesh
     // space.
     glm::vec2 head() const;
@@ -47,6 +52,7 @@ class Bone {
     friend void load_character_model_from_file(const char* path,
                                                Mesh& body_mesh,
                                                RiggedMesh& rigged_mesh);
+    friend RiggedMesh;
 };
 
 struct Mesh {
@@ -59,5 +65,27 @@ struct RiggedMesh {
 
     std::vector<Bone> bones;
 
+    // Copies share the vertex arrays, but have bones of their own that can be
+    // posed independently
+    RiggedMesh() = default;
+    RiggedMesh(const RiggedMesh& other);
+    RiggedMesh& operator=(const RiggedMesh& other);
+
+    struct Pose {
+        float rotation, length;
+    };
+
     Bone* find_bone(const char* name);
+
+    void store_pose(std::vector<Pose>& pose) const;
+
+    // Bone transforms for the pose at alpha between from and the current pose
+    void interpolated_transforms(const std::vector<Pose>& from,
+                                 float alpha,
+                                 glm::mat3* transforms) const;
+
+  private:
+    glm::mat3 interpolated_transform(size_t bone,
+                                     const std::vector<Pose>& from,
+                                     float alpha) const;
 };
@@ -3,8 +3,10 @@
 #include "../Player.h"
 #include "../Background.h"
 #include "../Level.h"
+#include "../Snapshot.h"
 #include <glm/gtx/matrix_transform_2d.hpp>
 
+#ifndef HEADLESS
 void Renderer::init() {
     debug_shader =
       DebugShader("../src/shaders/debug.vert", "../src/shaders/debug.frag");
@@ -53,6 +55,7 @@ void Renderer::update(float delta_time) {
     bone_shader.set_camera(&cam);
     trail_shader.set_camera(&cam);
 }
+#endif
 
 void Renderer::shake_screen(float intensity, float duration, float speed) {
     screen_shake.intensity = intensity;
@@ -60,6 +63,20 @@ void Renderer::shake_screen(float intensity, float duration, float speed) {
     screen_shake.speed     = speed;
 }
 
+void Renderer::save_screen_shake(ScreenShakeSnapshot& snapshot) const {
+    snapshot.intensity = screen_shake.intensity;
+    snapshot.duration  = screen_shake.duration;
+    snapshot.speed     = screen_shake.speed;
+    snapshot.noise_pos = screen_shake.noise_pos;
+}
+
+void Renderer::restore_screen_shake(const ScreenShakeSnapshot& snapshot) {
+    screen_shake.intensity = snapshot.intensity;
+    screen_shake.duration  = snapshot.duration;
+    screen_shake.speed     = snapshot.speed;
+    screen_shake.noise_pos = snapshot.noise_pos;
+}
+
 glm::vec2 Renderer::window_size() const noexcept {
     return window_size_;
 }
@@ -5,6 +5,7 @@
 #include <PerlinNoise.hpp>
 
 class Game;
+struct ScreenShakeSnapshot;
 
 class Renderer {
     glm::vec2 window_size_   = { 1920.0f, 1080.0f };
@@ -34,6 +35,9 @@ class Renderer {
     void update(float delta_time);
     void shake_screen(float intensity, float duration, float speed);
 
+    void save_screen_shake(ScreenShakeSnapshot& snapshot) const;
+    void restore_screen_shake(const ScreenShakeSnapshot& snapshot);
+
     glm::vec2 window_size() const noexcept;
     glm::vec2 camera_position() const noexcept;
     glm::vec2 camera_center() const noexcept;
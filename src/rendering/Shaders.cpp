@@ -3,6 +3,7 @@
 #include <sstream>
 #include "Shaders.h"
 #include "../Util.h"
+#include "../Counters.h"
 
 static bool check_compile_errors(GLuint object, bool program) {
     GLint success;
@@ -87,6 +88,7 @@ Shader::Shader(const char* vert_path, const char* frag_path) {
 }
 
 void Shader::use() const {
+    Counters::add(Counter::PROGRAM_BINDS);
     glUseProgram(id);
 };
 
@@ -163,6 +165,7 @@ TexturedShader::TexturedShader(const char* vert_path, const char* frag_path) :
 }
 
 void TexturedShader::set_texture(const Texture& texture) const {
+    Counters::add(Counter::TEXTURE_BINDS);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, texture.id);
 }
@@ -174,6 +177,7 @@ RiggedShader::RiggedShader(const char* vert_path, const char* frag_path) :
 }
 
 void RiggedShader::set_texture(const Texture& texture) const {
+    Counters::add(Counter::TEXTURE_BINDS);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, texture.id);
 }
@@ -1,5 +1,5 @@
 #pragma once
-#include <gl/glew.h>
+#include <GL/glew.h>
 #include "Color.h"
 #include "Texture.h"
 #include "VertexArray.h"
@@ -128,10 +128,12 @@ class TrailShader : public ShaderDetail::Shader {
     };
 };
 
+#ifndef HEADLESS
 //                                                              //
 //          Template specifications for VertexArray<>           //
 //                                                              //
 
+template<>
 void VertexArray<DebugShader::Vertex>::init(const GLuint* indices,
                                             GLuint num_indices,
                                             const DebugShader::Vertex* vertices,
@@ -173,6 +175,7 @@ void VertexArray<DebugShader::Vertex>::init(const GLuint* indices,
     glEnableVertexAttribArray(0);
 }
 
+template<>
 void VertexArray<DebugShader::Vertex>::init(const DebugShader::Vertex* vertices,
                                             GLuint num_vertices,
                                             GLenum usage) {
@@ -208,6 +211,7 @@ void VertexArray<DebugShader::Vertex>::init(const DebugShader::Vertex* vertices,
     glEnableVertexAttribArray(0);
 }
 
+template<>
 void VertexArray<TexturedShader::Vertex>::init(
   const GLuint* indices,
   GLuint num_indices,
@@ -257,6 +261,7 @@ void VertexArray<TexturedShader::Vertex>::init(
       reinterpret_cast<void*>(offsetof(TexturedShader::Vertex, uv_coord)));
     glEnableVertexAttribArray(1);
 }
+template<>
 void VertexArray<TexturedShader::Vertex>::init(
   const TexturedShader::Vertex* vertices, GLuint num_vertices, GLenum usage) {
 #ifdef SHADER_DEBUG
@@ -299,6 +304,7 @@ void VertexArray<TexturedShader::Vertex>::init(
     glEnableVertexAttribArray(1);
 }
 
+template<>
 void VertexArray<RiggedShader::Vertex>::init(
   const GLuint* indices,
   GLuint num_indices,
@@ -365,6 +371,7 @@ void VertexArray<RiggedShader::Vertex>::init(
       reinterpret_cast<void*>(offsetof(RiggedShader::Vertex, bone_weights)));
     glEnableVertexAttribArray(3);
 }
+template<>
 void VertexArray<RiggedShader::Vertex>::init(
   const RiggedShader::Vertex* vertices, GLuint num_vertices, GLenum usage) {
 #ifdef SHADER_DEBUG
@@ -424,6 +431,7 @@ void VertexArray<RiggedShader::Vertex>::init(
     glEnableVertexAttribArray(3);
 }
 
+template<>
 void VertexArray<BoneShader::Vertex>::init(const GLuint* indices,
                                            GLuint num_indices,
                                            const BoneShader::Vertex* vertices,
@@ -463,6 +471,7 @@ void VertexArray<BoneShader::Vertex>::init(const GLuint* indices,
                           reinterpret_cast<void*>(0));
     glEnableVertexAttribArray(0);
 }
+template<>
 void VertexArray<BoneShader::Vertex>::init(const BoneShader::Vertex* vertices,
                                            GLuint num_vertices,
                                            GLenum usage) {
@@ -497,6 +506,7 @@ void VertexArray<BoneShader::Vertex>::init(const BoneShader::Vertex* vertices,
     glEnableVertexAttribArray(0);
 }
 
+template<>
 void VertexArray<TrailShader::Vertex>::init(const GLuint* indices,
                                             GLuint num_indices,
                                             const TrailShader::Vertex* vertices,
@@ -546,6 +556,7 @@ void VertexArray<TrailShader::Vertex>::init(const GLuint* indices,
       reinterpret_cast<void*>(offsetof(TrailShader::Vertex, strength)));
     glEnableVertexAttribArray(1);
 }
+template<>
 void VertexArray<TrailShader::Vertex>::init(const TrailShader::Vertex* vertices,
                                             GLuint num_vertices,
                                             GLenum usage) {
@@ -588,4 +599,5 @@ void VertexArray<TrailShader::Vertex>::init(const TrailShader::Vertex* vertices,
       sizeof(TrailShader::Vertex),
       reinterpret_cast<void*>(offsetof(TrailShader::Vertex, strength)));
     glEnableVertexAttribArray(1);
-}
\ No newline at end of file
+}
+#endif
@@ -1,7 +1,17 @@
 #pragma once
 #include "Texture.h"
+
+#ifdef HEADLESS
+// Nothing in the simulation looks at textures
+void Texture::load_from_file(const char*) {
+    id         = 0;
+    w          = 0;
+    h          = 0;
+    dimensions = vec2(0.0f);
+}
+#else
 #include <sdl/SDL_image.h>
-#include <gl/glew.h>
+#include <GL/glew.h>
 
 void Texture::load_from_file(const char* path) {
     SDL_Surface* img = IMG_Load(path);
@@ -33,4 +43,5 @@ void Texture::load_from_file(const char* path) {
 
     // Unbind texture
     glBindTexture(GL_TEXTURE_2D, 0);
-}
\ No newline at end of file
+}
+#endif
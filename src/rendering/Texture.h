@@ -1,6 +1,6 @@
 #pragma once
 #include <glm/glm.hpp>
-#include "Types.h"
+#include "../Types.h"
 
 struct Texture {
     GLuint id;
@@ -1,7 +1,31 @@
 #pragma once
+#include <array>
 #include <vector>
 #include <sdl/SDL_assert.h>
+#include "../Types.h"
+#include "../Counters.h"
 
+#ifdef HEADLESS
+// There is no GPU to upload to when running headless, the vertex data stays
+// wherever the caller keeps it.
+template<typename vertex_t>
+class VertexArray {
+  public:
+    void init(const GLuint*, GLuint, const vertex_t*, GLuint, GLenum) {}
+    void init(const vertex_t*, GLuint, GLenum) {}
+
+    void update_vertex_data(const vertex_t*, size_t) {}
+
+    template<typename Allocator>
+    void update_vertex_data(const std::vector<vertex_t, Allocator>&) {}
+
+    template<size_t array_size>
+    void update_vertex_data(const std::array<vertex_t, array_size>&) {}
+
+    void draw(GLenum, GLuint) const {}
+    void draw(GLenum) const {}
+};
+#else
 // Manages an array of vertices of type vertex_t in GPU memory.
 template<typename vertex_t>
 class VertexArray {
@@ -38,30 +62,31 @@ class VertexArray {
         SDL_TriggerBreakpoint();
     }
 
-    void update_vertex_data(const std::vector<vertex_t> data) {
-        SDL_assert(usage_ == GL_DYNAMIC_DRAW && data.size() <= num_vertices_);
+    // Overwrites the first num_vertices vertices
+    void update_vertex_data(const vertex_t* vertices, size_t num_vertices) {
+        SDL_assert(usage_ == GL_DYNAMIC_DRAW && num_vertices <= num_vertices_);
 #ifdef SHADER_DEBUG
-        vertex_data = data;
+        vertex_data.assign(vertices, vertices + num_vertices);
 #endif
 
+        Counters::add(Counter::UPLOADED_BYTES, sizeof(vertex_t) * num_vertices);
         glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
         glBufferSubData(
-          GL_ARRAY_BUFFER, 0, sizeof(vertex_t) * data.size(), data.data());
+          GL_ARRAY_BUFFER, 0, sizeof(vertex_t) * num_vertices, vertices);
     }
 
-    template<size_t array_size>
-    void update_vertex_data(const std::array<vertex_t, array_size> data) {
-        SDL_assert(usage_ == GL_DYNAMIC_DRAW && data.size() <= num_vertices_);
-#ifdef SHADER_DEBUG
-        vertex_data = std::vector<vertex_t>(data.begin(), data.end());
-#endif
+    template<typename Allocator>
+    void update_vertex_data(const std::vector<vertex_t, Allocator>& data) {
+        update_vertex_data(data.data(), data.size());
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
-        glBufferSubData(
-          GL_ARRAY_BUFFER, 0, sizeof(vertex_t) * data.size(), data.data());
+    template<size_t array_size>
+    void update_vertex_data(const std::array<vertex_t, array_size>& data) {
+        update_vertex_data(data.data(), data.size());
     }
 
     void draw(GLenum mode, GLuint num_elements) const {
+        Counters::add(Counter::DRAW_CALLS);
         glBindVertexArray(vao_id);
         if (ebo_id == static_cast<GLuint>(-1)) {
             SDL_assert(num_indices_ == static_cast<GLuint>(-1));
@@ -74,6 +99,7 @@ class VertexArray {
     }
 
     void draw(GLenum mode) const {
+        Counters::add(Counter::DRAW_CALLS);
         glBindVertexArray(vao_id);
         if (ebo_id == static_cast<GLuint>(-1)) {
             SDL_assert(num_indices_ == static_cast<GLuint>(-1));
@@ -90,3 +116,4 @@ class VertexArray {
     //                    (const void*)indices);
     // }
 };
+#endif